@@ -1,33 +1,280 @@
 #include "CanvasScene.h"
-#include <QGraphicsPixmapItem>
-#include <QGraphicsPathItem>
+#include "TiledImageItem.h"
+#include "FeatureDetector.h"
+#include "ImageExporter.h"
+#include "ImageLoader.h"
+#include "PreviewItem.h"
+#include "GeometryBatch.h"
+#include "ProjectFile.h"
+#include "MeasureGraphicsItem.h"
+#include "MeasureOverlayItem.h"
+#include "PerfHud.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QGraphicsView>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QTimer>
+#include <QUndoStack>
 #include <QPainter>
+#include <algorithm>
 #include <cmath>
 #include <QDebug>
 
-// Helper for Euclidean distance
-double dist(QPointF p1, QPointF p2) {
-    return std::sqrt(std::pow(p1.x() - p2.x(), 2) + std::pow(p1.y() - p2.y(), 2));
+using Geometry::circumcircle;
+using Geometry::distanceToArc;
+using Geometry::distanceToSegment;
+
+// Converts a length in screen pixels of the view that sent the event to scene units
+static double sceneTolerance(const QGraphicsSceneMouseEvent* event, double pixels) {
+    if (QWidget* viewport = event->widget()) {
+        if (auto* view = qobject_cast<QGraphicsView*>(viewport->parentWidget())) {
+            const double scale = std::sqrt(std::abs(view->transform().determinant()));
+            if (scale > 0) return pixels / scale;
+        }
+    }
+    return pixels;
+}
+
+// Search radius of the edge snap in screen pixels
+static const double SnapPixels = 8;
+// Half size of the grab handles of a measurement's points, screen pixels
+static const double HandlePixels = 5;
+// Measurements of an opened project given scene items per event loop pass
+static const int ProjectChunk = 2000;
+
+// Points of a measurement that can be dragged: the foot of a distance
+// follows its line, only the measured point is free
+static int handleCount(const MeasureRecord& record, quint32 parentId) {
+    return record.type == MeasureRecord::Distance && parentId ? 1 : record.pointCount;
 }
 
+static QString measurementName(int type) {
+    switch (type) {
+    case MeasureRecord::Line: return "直线";
+    case MeasureRecord::Arc: return "圆弧";
+    case MeasureRecord::Distance: return "点线距离";
+    case MeasureRecord::Angle: return "角度";
+    default: return "拟合圆弧";
+    }
+}
+
+// A new measurement; it is always the last one when undone
+class CanvasScene::AddCommand : public QUndoCommand {
+public:
+    AddCommand(CanvasScene* scene, MeasureItem measure)
+        : QUndoCommand("添加" + measurementName(measure.record.type)), scene(scene), measure(std::move(measure)) {
+        if (this->measure.record.dirty) solveMeasurement(this->measure);
+        // Fixed now, so that measurements depending on it find it again after undo and redo
+        this->measure.id = scene->nextId++;
+    }
+    void redo() override { scene->addMeasurement(measure); }
+    void undo() override { scene->takeMeasurement(scene->measureItems.size() - 1); }
+
+private:
+    CanvasScene* scene;
+    MeasureItem measure;
+};
+
+class CanvasScene::RemoveCommand : public QUndoCommand {
+public:
+    RemoveCommand(CanvasScene* scene, int index)
+        : QUndoCommand("删除" + measurementName(scene->measureItems[index].record.type)), scene(scene), index(index) {}
+    void redo() override { measure = scene->takeMeasurement(index); }
+    void undo() override { scene->insertMeasurement(index, measure); }
+
+private:
+    CanvasScene* scene;
+    int index;
+    MeasureItem measure; // held while removed
+};
+
+class CanvasScene::MoveCommand : public QUndoCommand {
+public:
+    // applied: the measurement already has the new points, as for every step
+    // of a drag. Such steps of one measurement merge into a single move.
+    MoveCommand(CanvasScene* scene, int index, const QPointF* before, const QPointF* after, bool applied)
+        : QUndoCommand("移动" + measurementName(scene->measureItems[index].record.type)), scene(scene), index(index),
+          count(scene->measureItems[index].record.pointCount), applied(applied), dragStep(applied) {
+        for (int i = 0; i < count; ++i) {
+            this->before[i] = before[i];
+            this->after[i] = after[i];
+        }
+    }
+    void redo() override {
+        if (applied) {
+            applied = false;
+            return;
+        }
+        scene->setMeasurementPoints(index, after);
+    }
+    void undo() override { scene->setMeasurementPoints(index, before); }
+    int id() override { return dragStep ? DragMergeId : -1; }
+    bool mergeWith(const QUndoCommand* other) override {
+        // Steps of another drag start where this one ended
+        const auto* step = static_cast<const MoveCommand*>(other);
+        if (step->index != index || !std::equal(before, before + count, step->before)) return false;
+        bool moved = false;
+        for (int i = 0; i < count; ++i) {
+            after[i] = step->after[i];
+            moved = moved || after[i] != before[i];
+        }
+        // Dragged back to where it started: nothing left to undo
+        setObsolete(!moved);
+        return true;
+    }
+
+private:
+    static constexpr int DragMergeId = 1;
+
+    CanvasScene* scene;
+    int index;
+    int count;
+    bool applied;
+    bool dragStep;
+    QPointF before[3];
+    QPointF after[3];
+};
+
+// Relabels every measurement, which a scale change does anyway
+class CanvasScene::ScaleCommand : public QUndoCommand {
+public:
+    ScaleCommand(CanvasScene* scene, double before, double after)
+        : QUndoCommand("设置比例尺"), scene(scene), before(before), after(after) {}
+    void redo() override { scene->setScaleRatio(after); }
+    void undo() override { scene->setScaleRatio(before); }
+
+private:
+    CanvasScene* scene;
+    double before;
+    double after;
+};
+
+// Keeps the cleared list itself; the scene items are made again on undo
+class CanvasScene::ClearCommand : public QUndoCommand {
+public:
+    ClearCommand(CanvasScene* scene) : QUndoCommand("清除所有"), scene(scene) {}
+    void redo() override { measures = scene->takeMeasurements(); }
+    void undo() override {
+        scene->restoreMeasurements(measures);
+        measures.clear();
+    }
+
+private:
+    CanvasScene* scene;
+    QList<MeasureItem> measures;
+};
+
 CanvasScene::CanvasScene(QObject* parent)
-    : QGraphicsScene(parent), currentMode(ToolMode::None), scaleRatio(1.0), tempLine(nullptr), tempArc(nullptr), selectedLineForDist(nullptr) {
+    : QGraphicsScene(parent), currentMode(ToolMode::None), scaleRatio(1.0), loadStartNs(-1), imageItem(nullptr), snapToEdges(false), cacheImage(false), snapRadius(SnapPixels), previewPending(false), selectedLineForDist(-1), dragIndex(-1), dragHandle(0), dragStepping(false), handleRadius(HandlePixels), tracing(false), nextId(1), batched(false), pendingNext(0), pendingFirstId(1) {
+    preview = new PreviewItem();
+    addItem(preview);
+    overlay = new MeasureOverlayItem();
+    addItem(overlay);
+    history = new QUndoStack(this);
+    // An undo in the middle of a drag takes back the drag so far, or removes
+    // what is dragged; the drag ends there. The drag's own steps do not count.
+    connect(history, &QUndoStack::indexChanged, this, [this]() {
+        if (dragIndex >= 0 && !dragStepping) {
+            dragIndex = -1;
+            preview->clear();
+        }
+    });
+
+    previewTimer = new QTimer(this);
+    previewTimer->setSingleShot(true);
+    previewTimer->setTimerType(Qt::PreciseTimer);
+    QScreen* screen = QGuiApplication::primaryScreen();
+    previewTimer->setInterval(qMax(1, qRound(1000.0 / (screen ? screen->refreshRate() : 60.0))));
+    connect(previewTimer, &QTimer::timeout, this, [this]() {
+        if (previewPending) {
+            previewPending = false;
+            updatePreview(pendingPreviewPos);
+            previewTimer->start();
+        }
+    });
+
+    projectTimer = new QTimer(this);
+    projectTimer->setSingleShot(true);
+    connect(projectTimer, &QTimer::timeout, this, [this]() { createPendingMeasurements(ProjectChunk); });
+
+    imageLoader = new ImageLoader(this);
+    connect(imageLoader, &ImageLoader::previewReady, this, [this](std::shared_ptr<ImageSource> preview, const QSize& fullSize) {
+        // Only stand in until the full image arrives
+        if (!currentImage) {
+            setImage(preview, fullSize);
+        }
+    });
+    connect(imageLoader, &ImageLoader::imageReady, this, [this](std::shared_ptr<ImageSource> source, const QString& path) {
+        currentImage = source;
+        setImage(source, source->size());
+        emit messageChanged("图片已加载: " + path);
+        emit imageLoaded(path);
+    });
+    connect(this, &CanvasScene::imageLoaded, this, [this]() {
+        if (loadStartNs >= 0) {
+            PerfHud::record(PerfHud::ImageLoad, PerfHud::now() - loadStartNs);
+            loadStartNs = -1;
+        }
+    });
+    connect(imageLoader, &ImageLoader::loadFailed, this, [this](const QString& path, const QString& error) {
+        emit messageChanged(QString("无法加载图片 %1: %2").arg(path, error));
+    });
+
+    imageExporter = new ImageExporter(this);
+    connect(imageExporter, &ImageExporter::progressChanged, this, &CanvasScene::exportProgress);
+    connect(imageExporter, &ImageExporter::finished, this, [this](const QString& path) {
+        emit messageChanged("标注图已导出: " + path);
+        emit exportFinished(true);
+    });
+    connect(imageExporter, &ImageExporter::failed, this, [this](const QString& path, const QString& error) {
+        emit messageChanged(QString("无法导出 %1: %2").arg(path, error));
+        emit exportFinished(false);
+    });
+
+    featureDetector = new FeatureDetector(this);
+    connect(featureDetector, &FeatureDetector::progressChanged, this, &CanvasScene::detectionProgress);
+    connect(featureDetector, &FeatureDetector::finished, this, [this](const QVector<FeatureDetector::Feature>& features) {
+        if (features.isEmpty()) {
+            // Nothing to undo, so no step in the history
+            emit messageChanged("自动识别完成: 未找到直线或圆弧");
+            emit detectionFinished(true);
+            return;
+        }
+        // Project measurements joining later would drop the step from the history
+        finishPendingProject();
+        int lines = 0;
+        history->beginMacro(QString("自动识别 %1 个特征").arg(features.size()));
+        for (const auto& feature : features) {
+            history->push(new AddCommand(this, makeMeasurement(feature.type, feature.points, feature.type == MeasureRecord::Line ? 2 : 3)));
+            lines += feature.type == MeasureRecord::Line;
+        }
+        history->endMacro();
+        emit messageChanged(QString("自动识别完成: %1 条直线, %2 个圆弧").arg(lines).arg(features.size() - lines));
+        emit detectionFinished(true);
+    });
+    connect(featureDetector, &FeatureDetector::failed, this, [this](const QString& error) {
+        emit messageChanged("自动识别失败: " + error);
+        emit detectionFinished(false);
+    });
 }
 
 void CanvasScene::setMode(ToolMode mode) {
+    if (dragIndex >= 0) {
+        // The drag so far is in the history already, like a released one
+        dragIndex = -1;
+    }
     currentMode = mode;
     currentPoints.clear();
-    if (tempLine) {
-        removeItem(tempLine);
-        delete tempLine;
-        tempLine = nullptr;
-    }
-    if (tempArc) {
-        removeItem(tempArc);
-        delete tempArc;
-        tempArc = nullptr;
+    preview->clear();
+    previewPending = false;
+    if (selectedLineForDist >= 0) {
+        setMeasurementHighlighted(selectedLineForDist, false);
+        selectedLineForDist = -1;
     }
-    selectedLineForDist = nullptr;
+    tracing = false;
+    fitX.clear();
+    fitY.clear();
     // Reset selection
     foreach(QGraphicsItem* item, items()) {
         item->setSelected(false);
@@ -41,58 +288,270 @@ void CanvasScene::setScaleRatio(double pxPerMm) {
     }
 }
 
+void CanvasScene::solveMeasurement(MeasureItem& item) {
+    MeasureRecord& r = item.record;
+    if (r.type == MeasureRecord::Arc) { // Radius
+        double radiusPx = 0;
+        circumcircle(r.points[0], r.points[1], r.points[2], r.center, radiusPx);
+        r.valuePx = radiusPx;
+    } else if (r.type == MeasureRecord::Angle) {
+        r.valuePx = Geometry::angleDegrees(r.points[0], r.points[1], r.points[2]);
+    } else if (r.type == MeasureRecord::FittedArc) {
+        QVector<double> xs(item.trace.size()), ys(item.trace.size());
+        for (int i = 0; i < item.trace.size(); ++i) {
+            xs[i] = item.trace[i].x();
+            ys[i] = item.trace[i].y();
+        }
+        GeometryBatch::CircleFit fit;
+        GeometryBatch::fitCircle(xs.constData(), ys.constData(), xs.size(), fit);
+        r.center = QPointF(fit.cx, fit.cy);
+        r.valuePx = fit.radius;
+        r.residualPx = fit.rms;
+    } else { // Line, Distance (point 0 is target point, point 1 is projection point)
+        r.valuePx = Geometry::distance(r.points[0], r.points[1]);
+    }
+    r.dirty = false;
+}
+
+QString CanvasScene::labelText(const MeasureRecord& record) const {
+    const double mmPerPx = 1.0 / scaleRatio;
+    switch (record.type) {
+    case MeasureRecord::Line: return QString::number(record.valuePx * mmPerPx, 'f', 2) + " mm";
+    case MeasureRecord::Arc: return QString("半径: %1 mm").arg(record.valuePx * mmPerPx, 0, 'f', 2);
+    case MeasureRecord::Distance: return QString("距离: %1 mm").arg(record.valuePx * mmPerPx, 0, 'f', 2);
+    case MeasureRecord::FittedArc:
+        return QString("半径: %1 mm (残差 %2 mm)").arg(record.valuePx * mmPerPx, 0, 'f', 2)
+                                                 .arg(record.residualPx * mmPerPx, 0, 'f', 3);
+    default: return QString("%1°").arg(record.valuePx, 0, 'f', 1);
+    }
+}
+
 void CanvasScene::updateMeasurements() {
-    for (const auto& item : measureItems) {
-        if (item.type == 0) { // Line
-            double lengthPx = dist(item.points[0], item.points[1]);
-            double lengthMm = toMm(lengthPx);
-            item.textItem->setText(QString::number(lengthMm, 'f', 2) + " mm");
-        } else if (item.type == 1) { // Arc (Radius)
-             // Re-calculate radius from 3 points
-             QPointF p1 = item.points[0];
-             QPointF p2 = item.points[1];
-             QPointF p3 = item.points[2];
-             
-             double x1 = p1.x(), y1 = p1.y();
-             double x2 = p2.x(), y2 = p2.y();
-             double x3 = p3.x(), y3 = p3.y();
-             double D = 2 * (x1 * (y2 - y3) + x2 * (y3 - y1) + x3 * (y1 - y2));
-             if (std::abs(D) > 1e-5) {
-                 double center_x = ((x1*x1 + y1*y1) * (y2 - y3) + (x2*x2 + y2*y2) * (y3 - y1) + (x3*x3 + y3*y3) * (y1 - y2)) / D;
-                 double center_y = ((x1*x1 + y1*y1) * (x3 - x2) + (x2*x2 + y2*y2) * (x1 - x3) + (x3*x3 + y3*y3) * (x2 - x1)) / D;
-                 QPointF center(center_x, center_y);
-                 double radiusPx = dist(center, p1);
-                 double radiusMm = toMm(radiusPx);
-                 item.textItem->setText(QString("半径: %1 mm").arg(radiusMm, 0, 'f', 2));
-             }
-        } else if (item.type == 2) { // Distance
-             // Point 0 is target point, Point 1 is projection point
-             double distPx = dist(item.points[0], item.points[1]);
-             double distMm = toMm(distPx);
-             item.textItem->setText(QString("距离: %1 mm").arg(distMm, 0, 'f', 2));
+    ScopedTimer timer(PerfHud::Measurements);
+    // Geometry is only re-solved for items whose points changed; a new scale is
+    // a single multiply per label. Labels whose text did not change (angles, or
+    // values that round the same) are left alone so they are not re-laid out.
+    // The remaining setLabel() calls only queue updates, the scene repaints once
+    // for all of them when control returns to the event loop.
+    for (auto& item : measureItems) {
+        if (item.record.dirty) {
+            solveMeasurement(item);
+            if (item.graphicsItem) item.graphicsItem->setRecord(item.record);
         }
+        if (item.graphicsItem) item.graphicsItem->setLabel(labelText(item.record));
+    }
+    if (batched) {
+        rebuildOverlay();
     }
 }
 
-void CanvasScene::loadImage(const QString& path) {
+void CanvasScene::setImageCaching(bool enabled) {
+    cacheImage = enabled;
+    if (imageItem) {
+        imageItem->setCacheMode(enabled ? QGraphicsItem::DeviceCoordinateCache : QGraphicsItem::NoCache);
+    }
+}
+
+void CanvasScene::setEnhancement(const EnhanceSettings& settings) {
+    enhanceSettings = settings;
+    if (imageItem) {
+        imageItem->setEnhancement(settings);
+    }
+}
+
+void CanvasScene::setBatchedRendering(bool enabled) {
+    if (enabled == batched) return;
+    if (selectedLineForDist >= 0) setMeasurementHighlighted(selectedLineForDist, false);
+    batched = enabled;
+    for (auto& item : measureItems) {
+        if (batched) {
+            removeItem(item.graphicsItem);
+            delete item.graphicsItem;
+            item.graphicsItem = nullptr;
+        } else {
+            createGraphicsItem(item);
+        }
+    }
+    rebuildOverlay();
+    if (selectedLineForDist >= 0) setMeasurementHighlighted(selectedLineForDist, true);
+}
+
+void CanvasScene::rebuildOverlay() {
+    overlay->clear();
+    if (!batched) return;
+    for (int i = 0; i < measureItems.size(); ++i) {
+        overlay->insert(i, measureItems[i].record, labelText(measureItems[i].record));
+    }
+}
+
+void CanvasScene::setMeasurementHighlighted(int index, bool highlighted) {
+    const MeasureItem& item = measureItems[index];
+    if (item.graphicsItem) {
+        item.graphicsItem->setHighlighted(highlighted);
+    } else {
+        overlay->setHighlightedLine(highlighted ? QLineF(item.record.points[0], item.record.points[1]) : QLineF());
+    }
+}
+
+void CanvasScene::resetForImage() {
+    // clear() deletes every item, keep the preview and the overlay alive across it
+    setMode(ToolMode::None);
+    // Features of the old image must not land on the new one
+    cancelDetection();
+    removeItem(preview);
+    removeItem(overlay);
     clear();
+    addItem(preview);
+    addItem(overlay);
+    overlay->clear();
     measureItems.clear();
-    QPixmap pixmap(path);
-    if (!pixmap.isNull()) {
-        addPixmap(pixmap);
-        setSceneRect(pixmap.rect());
+    measureIndex.clear();
+    idIndex.clear();
+    dependents.clear();
+    dragIndex = -1;
+    history->clear();
+    imageItem = nullptr;
+    edgeSnapper.reset();
+    currentImage.reset();
+    imagePath.clear();
+    rawFormat = RawImageFormat();
+    pendingProject.reset();
+    projectTimer->stop();
+    imageLoader->cancel();
+    emit imageCleared();
+}
+
+void CanvasScene::loadImage(const QString& path) {
+    resetForImage();
+    imagePath = path;
+    loadStartNs = PerfHud::isEnabled() ? PerfHud::now() : -1;
+
+    // Uncompressed BMPs are mapped instead of decoded, that is instant at any size
+    if (path.endsWith(".bmp", Qt::CaseInsensitive)) {
+        QString error;
+        if (auto mapped = MappedImageSource::openBmp(path, TiledImageItem::TileSize, &error)) {
+            currentImage = mapped;
+            setImage(mapped, mapped->size());
+            emit modeChanged(ToolMode::None);
+            emit messageChanged("图片已加载: " + path);
+            emit imageLoaded(path);
+            return;
+        }
     }
-    setMode(ToolMode::None);
+
+    // Decoding runs on the thread pool, the scene stays usable meanwhile
+    imageLoader->load(path);
+    emit modeChanged(ToolMode::None);
+    emit messageChanged("正在加载图片: " + path);
+}
+
+void CanvasScene::loadRawImage(const QString& path, const RawImageFormat& format) {
+    resetForImage();
+    imagePath = path;
+    rawFormat = format;
+    loadStartNs = PerfHud::isEnabled() ? PerfHud::now() : -1;
+
+    QString error;
+    auto mapped = MappedImageSource::openRaw(path, format, TiledImageItem::TileSize, &error);
     emit modeChanged(ToolMode::None);
+    if (!mapped) {
+        emit messageChanged(QString("无法加载图片 %1: %2").arg(path, error));
+        return;
+    }
+    currentImage = mapped;
+    setImage(mapped, mapped->size());
+    emit messageChanged("图片已加载: " + path);
+    emit imageLoaded(path);
 }
 
-double CanvasScene::toMm(double pixels) const {
-    return pixels / scaleRatio;
+void CanvasScene::setImage(std::shared_ptr<ImageSource> source, const QSize& sceneSize) {
+    if (imageItem) {
+        removeItem(imageItem);
+        delete imageItem;
+    }
+    imageItem = new TiledImageItem(source);
+    // A preview is smaller than the real image, stretch it over the final scene rect
+    if (source->size() != sceneSize) {
+        imageItem->setTransform(QTransform::fromScale(double(sceneSize.width()) / source->size().width(),
+                                                      double(sceneSize.height()) / source->size().height()));
+    }
+    imageItem->setZValue(-1);
+    imageItem->setCacheMode(cacheImage ? QGraphicsItem::DeviceCoordinateCache : QGraphicsItem::NoCache);
+    imageItem->setEnhancement(enhanceSettings);
+    addItem(imageItem);
+    // A downscaled preview standing in for the image is not worth snapping to
+    edgeSnapper.reset(source->size() == sceneSize ? new EdgeSnapper(source) : nullptr);
+    setSceneRect(QRectF(QPointF(0, 0), QSizeF(sceneSize)));
+}
+
+void CanvasScene::indexMeasurement(int index) {
+    const MeasureRecord& r = measureItems[index].record;
+    QRectF bounds;
+    if (r.type == MeasureRecord::Arc && r.valuePx > 0) {
+        bounds = QRectF(r.center.x() - r.valuePx, r.center.y() - r.valuePx, 2 * r.valuePx, 2 * r.valuePx);
+    } else if (r.type == MeasureRecord::FittedArc) {
+        // Traced points can sit off the circle by the residual
+        const double extent = r.valuePx + 3 * r.residualPx;
+        bounds = QRectF(r.center.x() - extent, r.center.y() - extent, 2 * extent, 2 * extent);
+    } else {
+        QPolygonF polygon;
+        for (int i = 0; i < r.pointCount; ++i) {
+            polygon.append(r.points[i]);
+        }
+        bounds = polygon.boundingRect();
+    }
+    measureIndex.insert(index, bounds);
+}
+
+int CanvasScene::nearestMeasurement(const QPointF& pos, double tolerance, int typeFilter) const {
+    int best = -1;
+    double bestDist = tolerance;
+    QRectF area(pos.x() - tolerance, pos.y() - tolerance, 2 * tolerance, 2 * tolerance);
+    measureIndex.query(area, [&](int index) {
+        const MeasureRecord& r = measureItems[index].record;
+        if (typeFilter >= 0 && r.type != typeFilter) return;
+        double d;
+        if (r.type == MeasureRecord::FittedArc) {
+            // The fitted circle only; the traced points are too many to test one by one
+            d = std::abs(Geometry::distance(pos, r.center) - r.valuePx);
+        } else {
+            if (r.type == MeasureRecord::Arc) {
+                d = distanceToArc(pos, r.points[0], r.points[1], r.points[2]);
+            } else if (r.type == MeasureRecord::Angle) {
+                d = qMin(distanceToSegment(pos, r.points[1], r.points[0]),
+                         distanceToSegment(pos, r.points[1], r.points[2]));
+            } else {
+                d = distanceToSegment(pos, r.points[0], r.points[1]);
+            }
+            for (int i = 0; i < r.pointCount; ++i) {
+                d = qMin(d, Geometry::distance(pos, r.points[i]));
+            }
+        }
+        if (d <= bestDist) {
+            bestDist = d;
+            best = index;
+        }
+    });
+    return best;
 }
 
+QPointF CanvasScene::snapPoint(const QPointF& pos) {
+    QPointF snapped;
+    if (snapToEdges && edgeSnapper && edgeSnapper->snap(pos, snapRadius, snapped)) {
+        return snapped;
+    }
+    return pos;
+}
 
 void CanvasScene::mousePressEvent(QGraphicsSceneMouseEvent* event) {
     QPointF pos = event->scenePos();
+    snapRadius = sceneTolerance(event, SnapPixels);
+    handleRadius = sceneTolerance(event, HandlePixels);
+    // Picking the line for a distance uses the raw cursor, every placed point snaps
+    if (currentMode == ToolMode::Line || currentMode == ToolMode::Arc || currentMode == ToolMode::Angle
+        || currentMode == ToolMode::ArcFit || (currentMode == ToolMode::Distance && selectedLineForDist >= 0)) {
+        pos = snapPoint(pos);
+    }
 
     if (currentMode == ToolMode::Line) {
         currentPoints.append(pos);
@@ -101,7 +560,7 @@ void CanvasScene::mousePressEvent(QGraphicsSceneMouseEvent* event) {
         } else if (currentPoints.size() == 2) {
             finishLine(currentPoints[0], currentPoints[1]);
             currentPoints.clear();
-            if (tempLine) { removeItem(tempLine); delete tempLine; tempLine = nullptr; }
+            preview->clear();
             emit messageChanged("直线绘制完成。");
             setMode(ToolMode::None);
             emit modeChanged(ToolMode::None);
@@ -116,7 +575,7 @@ void CanvasScene::mousePressEvent(QGraphicsSceneMouseEvent* event) {
         } else if (currentPoints.size() == 3) {
             finishArc(currentPoints[0], currentPoints[1], currentPoints[2]);
             currentPoints.clear();
-            if (tempArc) { removeItem(tempArc); delete tempArc; tempArc = nullptr; }
+            preview->clear();
             emit messageChanged("圆弧绘制完成。");
             setMode(ToolMode::None);
             emit modeChanged(ToolMode::None);
@@ -131,540 +590,679 @@ void CanvasScene::mousePressEvent(QGraphicsSceneMouseEvent* event) {
         } else if (currentPoints.size() == 3) {
             finishAngle(currentPoints[0], currentPoints[1], currentPoints[2]);
             currentPoints.clear();
-            if (tempLine) { removeItem(tempLine); delete tempLine; tempLine = nullptr; }
+            preview->clear();
             emit messageChanged("角度测量完成。");
             setMode(ToolMode::None);
             emit modeChanged(ToolMode::None);
         }
     }
     else if (currentMode == ToolMode::Distance) {
-        if (!selectedLineForDist) {
-            // Try to select a line with 5px tolerance
-            QRectF selectionRect(pos.x() - 5, pos.y() - 5, 10, 10);
-            QList<QGraphicsItem*> itemsInRect = items(selectionRect);
-            
-            QGraphicsLineItem* lineItem = nullptr;
-            for (QGraphicsItem* item : itemsInRect) {
-                lineItem = dynamic_cast<QGraphicsLineItem*>(item);
-                if (lineItem) break;
-            }
+        if (selectedLineForDist < 0) {
+            // Try to select a line with 5 screen pixel tolerance
+            int picked = nearestMeasurement(pos, sceneTolerance(event, 5), MeasureRecord::Line);
 
-            if (lineItem) {
-                selectedLineForDist = lineItem;
-                // Highlight it?
-                QPen pen = lineItem->pen();
-                pen.setColor(Qt::magenta);
-                pen.setWidth(pen.width() + 2);
-                lineItem->setPen(pen);
+            if (picked >= 0) {
+                selectedLineForDist = picked;
+                setMeasurementHighlighted(picked, true);
                 emit messageChanged("直线已选中。点击一个点以测量距离。");
             } else {
                 emit messageChanged("请点击一条已存在的直线。");
             }
         } else {
             finishDistance(selectedLineForDist, pos);
-            // Reset selection visual
-            QPen pen = selectedLineForDist->pen();
-            pen.setColor(Qt::red); // Assuming default was red
-            pen.setWidth(2);
-            selectedLineForDist->setPen(pen);
-            
-            selectedLineForDist = nullptr;
             emit messageChanged("距离测量完成。");
             setMode(ToolMode::None);
             emit modeChanged(ToolMode::None);
         }
     }
+    else if (currentMode == ToolMode::Delete) {
+        const int picked = nearestMeasurement(pos, sceneTolerance(event, 5));
+        if (picked >= 0) {
+            removeMeasurement(picked);
+            emit messageChanged("测量已删除 (可撤销)。");
+            setMode(ToolMode::None);
+            emit modeChanged(ToolMode::None);
+        } else {
+            emit messageChanged("请点击要删除的测量。");
+        }
+    }
+    else if (currentMode == ToolMode::ArcFit) {
+        // The contour is traced with the button held down, see mouseMoveEvent()
+        tracing = true;
+        fitX = {pos.x()};
+        fitY = {pos.y()};
+        emit messageChanged("沿轮廓拖动鼠标, 松开完成拟合");
+    }
+    else if (currentMode == ToolMode::None && event->button() == Qt::LeftButton && pickHandle(pos, dragIndex, dragHandle)) {
+        const MeasureRecord& r = measureItems[dragIndex].record;
+        for (int i = 0; i < r.pointCount; ++i) {
+            dragStart[i] = r.points[i];
+        }
+        // Drag steps go into the history, which a later project chunk would drop
+        finishPendingProject();
+        emit messageChanged("拖动以移动测量点");
+    }
     else {
         QGraphicsScene::mousePressEvent(event);
     }
 }
 
 void CanvasScene::mouseMoveEvent(QGraphicsSceneMouseEvent* event) {
-    updatePreview(event->scenePos());
+    // First move after a quiet frame is shown right away, the rest of the
+    // frame only remembers the latest position for the timer to apply
+    pendingPreviewPos = event->scenePos();
+    snapRadius = sceneTolerance(event, SnapPixels);
+    handleRadius = sceneTolerance(event, HandlePixels);
+    if (tracing) {
+        // Every move is kept, but no closer than one screen pixel to the previous point
+        const QPointF p = snapPoint(pendingPreviewPos);
+        const QPointF last(fitX.last(), fitY.last());
+        if (Geometry::distance(last, p) >= sceneTolerance(event, 1)) {
+            fitX.append(p.x());
+            fitY.append(p.y());
+        }
+    }
+    if (!previewTimer->isActive()) {
+        previewPending = false;
+        updatePreview(pendingPreviewPos);
+        previewTimer->start();
+    } else {
+        previewPending = true;
+    }
     QGraphicsScene::mouseMoveEvent(event);
 }
 
-// Helper to create arc path
-static QPainterPath createArcPath(const QPointF& p1, const QPointF& p2, const QPointF& p3) {
-    double x1 = p1.x(), y1 = p1.y();
-    double x2 = p2.x(), y2 = p2.y();
-    double x3 = p3.x(), y3 = p3.y();
+void CanvasScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* event) {
+    if (tracing) {
+        tracing = false;
+        finishArcFit();
+        preview->clear();
+        setMode(ToolMode::None);
+        emit modeChanged(ToolMode::None);
+        return;
+    }
+    if (dragIndex >= 0) {
+        // The last move may still be waiting for the next frame
+        updatePreview(event->scenePos());
+        const MeasureRecord& r = measureItems[dragIndex].record;
+        bool moved = false;
+        for (int i = 0; i < r.pointCount; ++i) {
+            moved = moved || r.points[i] != dragStart[i];
+        }
+        dragIndex = -1;
+        preview->clear();
+        if (moved) {
+            emit messageChanged(measurementName(r.type) + "已移动: " + labelText(r));
+        }
+        return;
+    }
+    QGraphicsScene::mouseReleaseEvent(event);
+}
 
-    double D = 2 * (x1 * (y2 - y3) + x2 * (y3 - y1) + x3 * (y1 - y2));
-    QPainterPath path;
-    if (std::abs(D) < 1e-5) {
-        // Collinear, just draw lines
-        path.moveTo(p1);
-        path.lineTo(p2);
-        path.lineTo(p3);
-        return path;
+void CanvasScene::updatePreview(const QPointF& pos) {
+    ScopedTimer timer(PerfHud::Preview);
+    if (currentMode == ToolMode::ArcFit) {
+        // Refit the whole trace every frame, the fit is a few vectorised passes over it
+        GeometryBatch::CircleFit fit;
+        if (tracing && GeometryBatch::fitCircle(fitX.constData(), fitY.constData(), fitX.size(), fit)) {
+            preview->setCircle(QPointF(fit.cx, fit.cy), fit.radius);
+            emit messageChanged(QString("半径: %1 mm, 残差: %2 mm (%3 个点)")
+                                .arg(fit.radius / scaleRatio, 0, 'f', 2)
+                                .arg(fit.rms / scaleRatio, 0, 'f', 3)
+                                .arg(fitX.size()));
+        } else {
+            preview->clear();
+        }
+        return;
     }
 
-    double center_x = ((x1*x1 + y1*y1) * (y2 - y3) + (x2*x2 + y2*y2) * (y3 - y1) + (x3*x3 + y3*y3) * (y1 - y2)) / D;
-    double center_y = ((x1*x1 + y1*y1) * (x3 - x2) + (x2*x2 + y2*y2) * (x1 - x3) + (x3*x3 + y3*y3) * (x2 - x1)) / D;
-    QPointF center(center_x, center_y);
-    double radius = std::sqrt(std::pow(center_x - x1, 2) + std::pow(center_y - y1, 2));
+    if (dragIndex >= 0) {
+        // Only the dragged measurement and what depends on it are solved again
+        QPointF pts[3];
+        dragPoints(snapPoint(pos), pts);
+        const MeasureRecord& r = measureItems[dragIndex].record;
+        bool changed = false;
+        for (int i = 0; i < r.pointCount; ++i) {
+            changed = changed || pts[i] != r.points[i];
+        }
+        if (changed) {
+            // Every step is in the history at once, merged into one move, so
+            // an undo in the middle of the drag finds the drag there
+            setMeasurementPoints(dragIndex, pts);
+            dragStepping = true;
+            history->push(new MoveCommand(this, dragIndex, dragStart, r.points, true));
+            dragStepping = false;
+        }
+        preview->setHandles(r.points, handleCount(r, measureItems[dragIndex].parentId), handleRadius);
+        emit messageChanged(labelText(r));
+        return;
+    }
+    if (currentMode == ToolMode::None) {
+        // Handles of the measurement under the cursor show what can be grabbed
+        int index, handle;
+        if (pickHandle(pos, index, handle)) {
+            const MeasureRecord& r = measureItems[index].record;
+            preview->setHandles(r.points, handleCount(r, measureItems[index].parentId), handleRadius);
+        } else {
+            preview->clear();
+        }
+        return;
+    }
 
-    double startAngle = std::atan2(-(y1 - center_y), x1 - center_x) * 180.0 / PI;
-    double midAngle = std::atan2(-(y2 - center_y), x2 - center_x) * 180.0 / PI;
-    double endAngle = std::atan2(-(y3 - center_y), x3 - center_x) * 180.0 / PI;
+    const int n = currentPoints.size();
+    if (n == 0 || n >= PreviewItem::MaxPoints
+        || (currentMode != ToolMode::Line && currentMode != ToolMode::Arc && currentMode != ToolMode::Angle)) {
+        preview->clear();
+        return;
+    }
 
-    // Normalize angles to 0-360 for easier calculation logic, but arcTo uses degrees
-    // Qt arcTo: startAngle, sweepLength. 
-    // We need to determine sweep direction.
-    
-    // Using cross product to determine orientation of p1->p2->p3
-    double cross = (x2 - x1) * (y3 - y1) - (y2 - y1) * (x3 - x1);
-    bool ccw = cross > 0; // If cross > 0, p3 is to the left of p1->p2
+    // Fixed-size copy of the clicked points plus the cursor, no allocation
+    QPointF pts[PreviewItem::MaxPoints];
+    for (int i = 0; i < n; ++i) {
+        pts[i] = currentPoints.at(i);
+    }
+    pts[n] = snapPoint(pos);
 
-    // Actually, we need the arc from p1 to p3 passing through p2.
-    // Calculate angular difference
-    
-    double sweep = 0;
-    
-    // Adjust angles to be positive 0-360? No, atan2 returns -180 to 180.
-    // Let's just work with diffs.
-    
-    // Check if we go CW or CCW to hit p2 between p1 and p3
-    // Simple approach: check if p2 angle is in the sweep interval
-    
-    // Let's just try sweep = end - start. 
-    // Then normalize to (-360, 360).
-    // Then check if mid is in between.
-    
-    // Robust way:
-    // Calculate angle1, angle2, angle3 in [0, 360)
-    if (startAngle < 0) startAngle += 360;
-    if (midAngle < 0) midAngle += 360;
-    if (endAngle < 0) endAngle += 360;
-
-    // Case 1: CCW sweep
-    double sweepCCW = endAngle - startAngle;
-    if (sweepCCW < 0) sweepCCW += 360;
-    
-    // Check if mid is in this range
-    bool midInCCW = false;
-    if (startAngle < endAngle) {
-        midInCCW = (midAngle > startAngle && midAngle < endAngle);
-    } else { // wrap around
-        midInCCW = (midAngle > startAngle || midAngle < endAngle);
+    if (currentMode == ToolMode::Arc && n == 2) {
+        preview->setArc(pts[0], pts[1], pts[2]);
+    } else {
+        // Line and the first arc leg: a segment; Angle: both legs
+        preview->setPolyline(pts, n + 1);
     }
-    
-    if (midInCCW) {
-        // CCW is correct
-        // Qt arcTo sweep is positive for CCW (wait, Qt documentation says positive is counter-clockwise? 
-        // QPainterPath::arcTo: "Positive values for the sweep length mean the arc is drawn counter-clockwise.")
-        // Yes.
-        // But QGraphicsScene Y is down. So visual CCW might be different.
-        // In standard math (Y up), +angle is CCW. In Qt (Y down), +angle is CW visually (clockwise on screen).
-        // atan2(y, x) with Y down:
-        // y+ is down. 
-        // (1, 1) -> 45 deg. Visually bottom-right.
-        // (1, -1) -> -45 deg. Visually top-right.
-        // So +angle moves from X axis towards Y axis (CW visually).
-        // arcTo positive sweep: "counter-clockwise". This usually means decreasing angle in Y-down system?
-        // Actually Qt docs say: "0 degrees is at the 3 o'clock position... positive values mean counter-clockwise."
-        // In Y-down: 3 o'clock is X+. 12 o'clock is Y-.
-        // Rotation from X+(3) to Y-(12) is -90 degrees.
-        // So "Counter-Clockwise" in Qt logic means moving towards negative Y.
-        
-        // Let's stick to the calculated values. atan2 accounts for Y direction.
-        // If we use standard logic:
-        // sweep = end - start.
-        // We just need to handle the "pass through p2" constraint.
-        
-        // Let's re-eval.
-        // We determined midInCCW based on 0-360 logic.
-        // If midInCCW is true, we want to sweep CCW (positive direction in standard circle, negative visually in Y-down? No, just "increasing angle" logic works if consistent).
-        // Wait, atan2 with Y-down:
-        // (1,0) = 0. (0,1) = 90. (-1,0) = 180. (0,-1) = -90.
-        // 0 -> 90 is moving Down (CW visually).
-        // So increasing angle is CW visually.
-        // Qt arcTo "positive sweep means counter-clockwise".
-        // This implies Qt's "counter-clockwise" is decreasing angle (0 -> -90 -> -180).
-        
-        // So if we want to go from Start to End increasing the angle (0 -> 90), that is CW visually.
-        // Qt calls this Negative sweep?
-        // Let's verify: "Positive values for sweep length mean the arc is drawn counter-clockwise."
-        // 0 to 90 (3 o'clock to 6 o'clock) is Clockwise.
-        // So sweep should be negative?
-        // Let's rely on just using `startAngle` and `sweep` where `sweep` makes us hit `mid`.
-        
-        // Let's calculate both sweeps:
-        double sweep1 = endAngle - startAngle; // Direct
-        if (sweep1 > 180) sweep1 -= 360;
-        else if (sweep1 < -180) sweep1 += 360;
-        
-        // This gives shortest path. But we must pass through mid.
-        // Check if mid is on this shortest path.
-        double diffMidStart = midAngle - startAngle;
-        if (diffMidStart > 180) diffMidStart -= 360;
-        else if (diffMidStart < -180) diffMidStart += 360;
-        
-        // If signs match and abs(diffMidStart) < abs(sweep1), then mid is on the way.
-        // Or complex logic.
-        
-        // Simpler:
-        // Calculate sweep for (Start -> Mid) and (Mid -> End).
-        // Then add them up? No.
-        
-        // Let's go back to 0-360 logic.
-        // We have start, mid, end in [0, 360).
-        // CW path: Start -> ... -> End (increasing? No, Y-down increasing is CW).
-        // CCW path: Start -> ... -> End (decreasing).
-        
-        // Path 1 (Increasing / "CW" in Y-down):
-        double distCW = endAngle - startAngle;
-        if (distCW < 0) distCW += 360;
-        // Check if mid is in this interval
-        double midRel = midAngle - startAngle;
-        if (midRel < 0) midRel += 360;
-        bool midInCW = (midRel < distCW);
-        
-        double finalSweep = 0;
-        if (midInCW) {
-             // We want the CW path.
-             // In Qt arcTo: "positive is CCW". So CW is negative.
-             // But wait, in Y-down, increasing angle (0->90) is CW.
-             // Does Qt consider 0->90 as positive sweep or negative?
-             // Usually angles match. start 0, sweep 90 -> ends at 90.
-             // If 90 is at 6 o'clock, then 0->90 is CW.
-             // If Qt calls "positive sweep" as CCW, then for Y-down, positive sweep must decrease angle? (0 -> -90).
-             // This is confusing. Let's assume:
-             // path.arcTo(rect, start, sweep).
-             // If I want to go from startAngle to endAngle via midAngle.
-             
-             // Let's just try constructing it as start->sweep.
-             // If we decided CW (increasing angle) is the correct way:
-             // Sweep should be -distCW (if Qt logic holds) OR +distCW (if angle logic holds).
-             // Let's use -distCW because "positive is CCW".
-             finalSweep = -distCW;
-        } else {
-             // We want the CCW path (decreasing angle).
-             // Distance is 360 - distCW.
-             double distCCW = 360 - distCW;
-             finalSweep = distCCW;
-        }
-        
-        // Override logic: In Qt QGraphicsScene (Y down):
-        // Positive angle = Clockwise direction on screen.
-        // QPainterPath::arcTo documentation: "Positive values for the sweep length mean the arc is drawn counter-clockwise."
-        // This implies positive sweep goes against the increasing angle? i.e. decreases angle.
-        // So if we want to go 0 -> 90 (CW), we need sweep = -90.
-        // If we want to go 0 -> -90 (CCW), we need sweep = 90.
-        
-        
-        // Note: arcTo expects startAngle in degrees. And standard Qt coord system for arcTo is Y-up? 
-        // No, QPainterPath operates in logical coordinates.
-        // But: "The angles are specified in degrees. 0 degrees is at the 3 o'clock position... positive values mean counter-clockwise."
-        // This definition (Positive=CCW) is consistent with standard math (Y-up).
-        // In Y-down, 0 is 3 o'clock. 90 is 6 o'clock.
-        // Counter-clockwise from 3 o'clock (0) goes to 12 o'clock (-90? No, Y is negative there).
-        // So in Y-down, CCW is moving towards negative Y (negative angles).
-        // So 0 -> -90 is CCW.
-        // So if we want to draw 0 to -90, sweep is +90.
-        // If we want to draw 0 to 90 (CW), sweep is -90.
-        
-        // My calculation of startAngle uses atan2(y, x).
-        // With Y-down, (0,1) is 90.
-        // So startAngle is correct in Y-down "degrees".
-        // If I want to draw from startAngle to endAngle.
-        // If midInCW (increasing angle path):
-        // We go from start -> end by INCREASING angle (e.g. 10 -> 20).
-        // This is CW visual.
-        // Qt requires negative sweep for CW.
-        // Sweep = -(end - start).
-        // But we normalized distCW to be positive (0 to 360).
-        // So finalSweep = -distCW.
-        
-        // Wait, arcTo takes startAngle. Does it take "screen angle" or "math angle"?
-        // It takes degrees.
-        // If I say arcTo(..., 45, ...), it starts at 45 deg.
-        // In Y-down, 45 deg is 4:30 position (bottom-right).
-        // If I use my atan2 result (which gives 45 for bottom-right), it matches.
-        // So startAngle is correct.
-        
-        // However, QPainterPath::arcTo treats the angle argument as...
-        // "startAngle: The start angle of the arc."
-        // "sweepLength: The sweep length of the arc."
-        // Crucially: "Angles are specified in degrees... positive values mean counter-clockwise."
-        
-        // So if I want to sweep from 10 to 20 (CW visual, increasing Y-down angle):
-        // Start: 10.
-        // Sweep: -10. (Because +10 would go 10 -> 0).
-        
-        // So:
-        // 1. Calculate start, mid, end in Y-down degrees (atan2).
-        // 2. Determine if sequence start->mid->end is Increasing Angle (CW) or Decreasing Angle (CCW).
-        //    (Handling 360 wrap).
-        // 3. If Increasing (CW): Sweep is negative of the angular distance.
-        // 4. If Decreasing (CCW): Sweep is positive of the angular distance.
-        
-        // Re-check midInCW logic:
-        // distCW = end - start (normalized to 0..360).
-        // midRel = mid - start (normalized to 0..360).
-        // midInCW = (midRel < distCW).
-        
-        // If midInCW is true, we are moving in "Increasing Angle" direction.
-        // Which is CW visually.
-        // So Sweep should be -distCW.
-        
-        // If midInCW is false, we are moving in "Decreasing Angle" direction.
-        // We need to go the other way.
-        // Distance is (360 - distCW).
-        // Sweep should be +(360 - distCW).
-        
-        if (midInCW) {
-            finalSweep = -distCW;
-        } else {
-            finalSweep = (360 - distCW);
+}
+
+CanvasScene::MeasureItem CanvasScene::makeMeasurement(int type, const QPointF* points, int count) {
+    MeasureItem measure;
+    measure.record.type = quint8(type);
+    if (type == MeasureRecord::FittedArc) {
+        measure.trace = QVector<QPointF>(points, points + count);
+        // What gets drawn: the traced span from the first point past the middle one to the last
+        measure.record.points[0] = points[0];
+        measure.record.points[1] = points[count / 2];
+        measure.record.points[2] = points[count - 1];
+        measure.record.pointCount = 3;
+    } else {
+        measure.record.pointCount = quint8(qMin(count, 3));
+        for (int i = 0; i < measure.record.pointCount; ++i) {
+            measure.record.points[i] = points[i];
         }
-        
-        path.moveTo(p1);
-        path.arcTo(center_x - radius, center_y - radius, radius*2, radius*2, startAngle, finalSweep);
     }
-    
-    return path;
-}
-
-// Robust arc path that explicitly passes through p1 -> p2 -> p3
-static QPainterPath createArcPathThroughMid(const QPointF& p1, const QPointF& p2, const QPointF& p3) {
-    double x1 = p1.x(), y1 = p1.y();
-    double x2 = p2.x(), y2 = p2.y();
-    double x3 = p3.x(), y3 = p3.y();
-
-    double D = 2 * (x1 * (y2 - y3) + x2 * (y3 - y1) + x3 * (y1 - y2));
-    QPainterPath path;
-    if (std::abs(D) < 1e-5) {
-        path.moveTo(p1);
-        path.lineTo(p2);
-        path.lineTo(p3);
-        return path;
-    }
-
-    double cx = ((x1*x1 + y1*y1) * (y2 - y3) + (x2*x2 + y2*y2) * (y3 - y1) + (x3*x3 + y3*y3) * (y1 - y2)) / D;
-    double cy = ((x1*x1 + y1*y1) * (x3 - x2) + (x2*x2 + y2*y2) * (x1 - x3) + (x3*x3 + y3*y3) * (x2 - x1)) / D;
-    double r = std::sqrt((cx - x1)*(cx - x1) + (cy - y1)*(cy - y1));
-
-    auto angleQt = [&](double x, double y){ return std::atan2(-(y - cy), (x - cx)) * 180.0 / PI; };
-    auto norm360 = [&](double a){ while (a < 0) a += 360; while (a >= 360) a -= 360; return a; };
-    auto ccwDelta = [&](double aFrom, double aTo){ double d = aTo - aFrom; if (d < 0) d += 360; return d; };
-
-    double a1 = norm360(angleQt(x1, y1));
-    double a2 = norm360(angleQt(x2, y2));
-    double a3 = norm360(angleQt(x3, y3));
-
-    double ccwTotal = ccwDelta(a1, a3);
-    double ccwMid = ccwDelta(a1, a2);
-    bool midInCCW = ccwMid <= ccwTotal + 1e-9;
-
-    QRectF rect(cx - r, cy - r, r*2, r*2);
-    QPainterPath out;
-    out.arcMoveTo(rect, a1);
-    if (midInCCW) {
-        out.arcTo(rect, a1, ccwMid);
-        out.arcTo(rect, a2, ccwDelta(a2, a3));
+    return measure;
+}
+
+void CanvasScene::addMeasurement(MeasureItem measure) {
+    if (measure.record.dirty) {
+        solveMeasurement(measure);
+    }
+    if (measure.id == 0) {
+        measure.id = nextId++;
+    }
+    measureItems.append(measure);
+    attachMeasurement(measureItems.size() - 1);
+}
+
+void CanvasScene::attachMeasurement(int index) {
+    MeasureItem& item = measureItems[index];
+    if (batched) {
+        overlay->insert(index, item.record, labelText(item.record));
     } else {
-        double cw1 = ccwDelta(a2, a1);
-        double cw2 = ccwDelta(a3, a2);
-        out.arcTo(rect, a1, -cw1);
-        out.arcTo(rect, a2, -cw2);
+        createGraphicsItem(item);
     }
-    return out;
+    indexMeasurement(index);
+    idIndex.insert(item.id, index);
+    if (item.parentId) dependents[item.parentId].append(item.id);
 }
 
-void CanvasScene::updatePreview(const QPointF& pos) {
-    if (currentMode == ToolMode::Line && currentPoints.size() == 1) {
-        if (!tempLine) {
-            tempLine = addLine(QLineF(currentPoints[0], pos), QPen(Qt::DashLine));
-        } else {
-            tempLine->setLine(QLineF(currentPoints[0], pos));
+void CanvasScene::detachMeasurement(int index) {
+    MeasureItem& item = measureItems[index];
+    if (item.graphicsItem) {
+        removeItem(item.graphicsItem);
+        delete item.graphicsItem;
+        item.graphicsItem = nullptr;
+    }
+    overlay->remove(index);
+    measureIndex.remove(index);
+    idIndex.remove(item.id);
+    if (item.parentId) {
+        auto it = dependents.find(item.parentId);
+        if (it != dependents.end()) {
+            it->removeOne(item.id);
+            if (it->isEmpty()) dependents.erase(it);
         }
-    } else if (currentMode == ToolMode::Arc) {
-        if (currentPoints.size() == 1) {
-            // Preview straight line to second point
-             if (!tempArc) {
-                // Using path for flexibility
-                QPainterPath path;
-                path.moveTo(currentPoints[0]);
-                path.lineTo(pos);
-                tempArc = addPath(path, QPen(Qt::DashLine));
-            } else {
-                QPainterPath path;
-                path.moveTo(currentPoints[0]);
-                path.lineTo(pos);
-                tempArc->setPath(path);
-            }
-        } else if (currentPoints.size() == 2) {
-             if (!tempArc) {
-                 tempArc = addPath(QPainterPath(), QPen(Qt::DashLine));
-             }
-             
-             QPainterPath path = createArcPathThroughMid(currentPoints[0], currentPoints[1], pos);
-             tempArc->setPath(path);
-        }
-    } else if (currentMode == ToolMode::Angle) {
-        if (currentPoints.size() == 1) {
-             if (!tempLine) {
-                tempLine = addLine(QLineF(currentPoints[0], pos), QPen(Qt::DashLine));
-            } else {
-                tempLine->setLine(QLineF(currentPoints[0], pos));
-            }
-        } else if (currentPoints.size() == 2) {
-            // Show both lines: p1->p2 and p2->pos
-            QPainterPath path;
-            path.moveTo(currentPoints[0]);
-            path.lineTo(currentPoints[1]);
-            path.lineTo(pos);
-            
-            // We need a path item for this, not line item.
-            // Reuse tempLine? No, tempLine is QGraphicsLineItem.
-            // We need to swap it or use a new item.
-            // Simpler: use tempArc (which is QGraphicsPathItem) for Angle mode too?
-            // Or just change tempLine to be QGraphicsPathItem generally?
-            // Let's just add a new tempPath for Angle if needed, or cast.
-            // Easier: Delete tempLine and create tempArc (PathItem) if it's null.
-            
-            if (tempLine) {
-                removeItem(tempLine);
-                delete tempLine;
-                tempLine = nullptr;
-            }
-            
-            if (!tempArc) {
-                 tempArc = addPath(path, QPen(Qt::DashLine));
-            } else {
-                 tempArc->setPath(path);
+    }
+}
+
+CanvasScene::MeasureItem CanvasScene::takeMeasurement(int index) {
+    if (selectedLineForDist == index) {
+        setMeasurementHighlighted(index, false);
+        selectedLineForDist = -1;
+    }
+    detachMeasurement(index);
+    MeasureItem taken = measureItems[index];
+
+    // The last one moves into the gap and keeps its scene item; only its
+    // index entries change
+    const int last = measureItems.size() - 1;
+    if (index != last) {
+        overlay->remove(last);
+        measureIndex.remove(last);
+        measureItems[index] = measureItems[last];
+        if (batched) overlay->insert(index, measureItems[index].record, labelText(measureItems[index].record));
+        indexMeasurement(index);
+        idIndex.insert(measureItems[index].id, index);
+        if (selectedLineForDist == last) selectedLineForDist = index;
+    }
+    measureItems.removeLast();
+    return taken;
+}
+
+void CanvasScene::insertMeasurement(int index, MeasureItem measure) {
+    // Exactly undoes takeMeasurement(index): the one that took the slot goes back to the end
+    measureItems.append(measure);
+    const int last = measureItems.size() - 1;
+    if (index != last) {
+        overlay->remove(index);
+        measureIndex.remove(index);
+        measureItems.swapItemsAt(index, last);
+        if (batched) overlay->insert(last, measureItems[last].record, labelText(measureItems[last].record));
+        indexMeasurement(last);
+        idIndex.insert(measureItems[last].id, last);
+        if (selectedLineForDist == index) selectedLineForDist = last;
+    }
+    attachMeasurement(index);
+}
+
+void CanvasScene::setMeasurementPoints(int index, const QPointF* points) {
+    MeasureItem& item = measureItems[index];
+    MeasureRecord& r = item.record;
+    if (r.type == MeasureRecord::FittedArc) {
+        // Refitting would give the same circle, moved
+        const QPointF offset = points[0] - r.points[0];
+        for (QPointF& p : item.trace) p += offset;
+        r.center += offset;
+        for (int i = 0; i < r.pointCount; ++i) r.points[i] += offset;
+    } else {
+        for (int i = 0; i < r.pointCount; ++i) r.points[i] = points[i];
+        r.dirty = true;
+    }
+    refreshMeasurement(index);
+
+    // Only what was measured from this one follows it
+    auto it = dependents.constFind(item.id);
+    if (it == dependents.constEnd()) return;
+    for (quint32 id : it.value()) {
+        const int dependent = idIndex.value(id, -1);
+        if (dependent >= 0) {
+            measureItems[dependent].record.dirty = true;
+            refreshMeasurement(dependent);
+        }
+    }
+}
+
+void CanvasScene::refreshMeasurement(int index) {
+    MeasureItem& item = measureItems[index];
+    MeasureRecord& r = item.record;
+    if (item.parentId) {
+        const int line = idIndex.value(item.parentId, -1);
+        if (line >= 0) {
+            const MeasureRecord& l = measureItems[line].record;
+            r.points[1] = Geometry::projectOntoLine(l.points[0], l.points[1], r.points[0]);
+        }
+    }
+    if (r.dirty) {
+        solveMeasurement(item);
+    }
+
+    if (item.graphicsItem) {
+        item.graphicsItem->setRecord(r);
+        item.graphicsItem->setLabel(labelText(r));
+    } else if (batched) {
+        overlay->remove(index);
+        overlay->insert(index, r, labelText(r));
+    }
+    indexMeasurement(index);
+    if (selectedLineForDist == index) setMeasurementHighlighted(index, true);
+}
+
+QList<CanvasScene::MeasureItem> CanvasScene::takeMeasurements() {
+    if (selectedLineForDist >= 0) {
+        setMeasurementHighlighted(selectedLineForDist, false);
+        selectedLineForDist = -1;
+    }
+    QList<MeasureItem> taken;
+    taken.swap(measureItems);
+    for (auto& item : taken) {
+        if (!item.graphicsItem) continue;
+        removeItem(item.graphicsItem);
+        delete item.graphicsItem;
+        item.graphicsItem = nullptr;
+    }
+    overlay->clear();
+    measureIndex.clear();
+    idIndex.clear();
+    dependents.clear();
+    return taken;
+}
+
+void CanvasScene::restoreMeasurements(const QList<MeasureItem>& items) {
+    measureItems = items;
+    for (int i = 0; i < measureItems.size(); ++i) {
+        attachMeasurement(i);
+    }
+}
+
+bool CanvasScene::pickHandle(const QPointF& pos, int& index, int& handle) const {
+    double best = handleRadius;
+    index = -1;
+    const QRectF area(pos.x() - handleRadius, pos.y() - handleRadius, 2 * handleRadius, 2 * handleRadius);
+    measureIndex.query(area, [&](int i) {
+        const MeasureRecord& r = measureItems[i].record;
+        const int handles = handleCount(r, measureItems[i].parentId);
+        for (int h = 0; h < handles; ++h) {
+            const double d = Geometry::distance(pos, r.points[h]);
+            if (d <= best) {
+                best = d;
+                index = i;
+                handle = h;
             }
         }
+    });
+    return index >= 0;
+}
+
+void CanvasScene::dragPoints(const QPointF& pos, QPointF* points) const {
+    const MeasureRecord& r = measureItems[dragIndex].record;
+    for (int i = 0; i < r.pointCount; ++i) {
+        points[i] = dragStart[i];
+    }
+    if (r.type == MeasureRecord::FittedArc) {
+        // The traced contour only moves as a whole
+        const QPointF offset = pos - dragStart[dragHandle];
+        for (int i = 0; i < r.pointCount; ++i) points[i] += offset;
+    } else {
+        points[dragHandle] = pos;
     }
 }
 
-void CanvasScene::finishLine(const QPointF& p1, const QPointF& p2) {
-    QPen pen(Qt::red);
-    pen.setWidth(2);
-    QGraphicsLineItem* lineItem = addLine(QLineF(p1, p2), pen);
+void CanvasScene::dropHistory() {
+    if (history->count() > 0) history->clear();
+}
 
-    double lengthPx = dist(p1, p2);
-    double lengthMm = toMm(lengthPx);
+void CanvasScene::finishPendingProject() {
+    if (pendingProject) {
+        createPendingMeasurements(pendingProject->count());
+    }
+}
 
-    QGraphicsSimpleTextItem* text = addSimpleText(QString::number(lengthMm, 'f', 2) + " mm");
-    text->setBrush(Qt::blue);
-    text->setPos((p1 + p2) / 2);
-    
-    measureItems.append({0, lineItem, text, {p1, p2}, {}});
+bool CanvasScene::isLoading() const {
+    return imageLoader->isLoading() || pendingProject != nullptr;
 }
 
-void CanvasScene::finishArc(const QPointF& p1, const QPointF& p2, const QPointF& p3) {
-    double x1 = p1.x(), y1 = p1.y();
-    double x2 = p2.x(), y2 = p2.y();
-    double x3 = p3.x(), y3 = p3.y();
+void CanvasScene::flushPreview() {
+    if (previewPending) {
+        previewPending = false;
+        updatePreview(pendingPreviewPos);
+    }
+}
 
-    double D = 2 * (x1 * (y2 - y3) + x2 * (y3 - y1) + x3 * (y1 - y2));
-    if (std::abs(D) < 1e-5) {
-        emit messageChanged("三点共线，无法绘制圆弧");
-        return;
+bool CanvasScene::exportImage(const QString& path) {
+    if (!currentImage || imageLoader->isLoading()) {
+        emit messageChanged(currentImage ? "图片仍在加载, 请稍后导出" : "没有可导出的图片");
+        return false;
+    }
+    // Measurements still waiting for their scene items belong to the export too
+    finishPendingProject();
+    QVector<ImageExporter::Annotation> annotations;
+    annotations.reserve(measureItems.size());
+    for (const auto& item : measureItems) {
+        annotations.append(ImageExporter::Annotation{item.record, labelText(item.record)});
+    }
+    imageExporter->start(path, currentImage, std::move(annotations), scaleRatio);
+    emit messageChanged(QString("正在导出标注图: %1 (%2 个测量)").arg(path).arg(measureItems.size()));
+    return true;
+}
+
+void CanvasScene::cancelExport() {
+    if (!imageExporter->isRunning()) return;
+    imageExporter->cancel();
+    emit messageChanged("导出已取消");
+    emit exportFinished(false);
+}
+
+bool CanvasScene::detectFeatures() {
+    if (!currentImage || imageLoader->isLoading()) {
+        emit messageChanged(currentImage ? "图片仍在加载, 请稍后识别" : "没有可识别的图片");
+        return false;
     }
+    featureDetector->start(currentImage);
+    emit messageChanged("正在自动识别直线和圆弧...");
+    return true;
+}
 
-    double center_x = ((x1*x1 + y1*y1) * (y2 - y3) + (x2*x2 + y2*y2) * (y3 - y1) + (x3*x3 + y3*y3) * (y1 - y2)) / D;
-    double center_y = ((x1*x1 + y1*y1) * (x3 - x2) + (x2*x2 + y2*y2) * (x1 - x3) + (x3*x3 + y3*y3) * (x2 - x1)) / D;
+void CanvasScene::cancelDetection() {
+    if (!featureDetector->isRunning()) return;
+    featureDetector->cancel();
+    emit messageChanged("自动识别已取消");
+    emit detectionFinished(false);
+}
 
-    QPointF center(center_x, center_y);
-    double radiusPx = dist(center, p1);
-    double radiusMm = toMm(radiusPx);
+void CanvasScene::appendMeasurement(int type, const QPointF* points, int count) {
+    dropHistory();
+    addMeasurement(makeMeasurement(type, points, count));
+}
 
-    // Use the helper to get the correct arc path
-    QPainterPath path = createArcPathThroughMid(p1, p2, p3);
-    QGraphicsPathItem* arcItem = addPath(path, QPen(Qt::green, 2));
+void CanvasScene::changeScaleRatio(double pxPerMm) {
+    if (pxPerMm > 0 && pxPerMm != scaleRatio) {
+        finishPendingProject();
+        history->push(new ScaleCommand(this, scaleRatio, pxPerMm));
+    }
+}
 
-    QList<QGraphicsItem*> extras;
-    extras.append(addEllipse(x1-2, y1-2, 4, 4, QPen(Qt::green), QBrush(Qt::green)));
-    extras.append(addEllipse(x2-2, y2-2, 4, 4, QPen(Qt::green), QBrush(Qt::green)));
-    extras.append(addEllipse(x3-2, y3-2, 4, 4, QPen(Qt::green), QBrush(Qt::green)));
+void CanvasScene::removeMeasurement(int index) {
+    if (index >= 0 && index < measureItems.size()) {
+        finishPendingProject();
+        history->push(new RemoveCommand(this, index));
+    }
+}
 
-    QGraphicsSimpleTextItem* text = addSimpleText(QString("半径: %1 mm").arg(radiusMm, 0, 'f', 2));
-    text->setBrush(Qt::blue);
-    text->setPos(center);
-    
-    measureItems.append({1, arcItem, text, {p1, p2, p3}, extras});
+void CanvasScene::moveMeasurement(int index, const QPointF* points) {
+    if (index >= 0 && index < measureItems.size()) {
+        finishPendingProject();
+        history->push(new MoveCommand(this, index, measureItems[index].record.points, points, false));
+    }
 }
 
-void CanvasScene::finishAngle(const QPointF& p1, const QPointF& p2, const QPointF& p3) {
-    double v1x = p1.x() - p2.x();
-    double v1y = p1.y() - p2.y();
-    double v2x = p3.x() - p2.x();
-    double v2y = p3.y() - p2.y();
+void CanvasScene::createGraphicsItem(MeasureItem& item) {
+    item.graphicsItem = MeasureGraphicsItem::create(item.record);
+    item.graphicsItem->setLabel(labelText(item.record));
+    addItem(item.graphicsItem);
+}
 
-    double dot = v1x * v2x + v1y * v2y;
-    double mag1 = std::sqrt(v1x*v1x + v1y*v1y);
-    double mag2 = std::sqrt(v2x*v2x + v2y*v2y);
-    double angleRad = std::acos(dot / (mag1 * mag2));
-    double angleDeg = angleRad * 180.0 / PI;
+void CanvasScene::finishLine(const QPointF& p1, const QPointF& p2) {
+    const QPointF pts[2] = {p1, p2};
+    finishPendingProject();
+    history->push(new AddCommand(this, makeMeasurement(MeasureRecord::Line, pts, 2)));
+}
 
-    QPainterPath path;
-    path.moveTo(p2);
-    path.lineTo(p1);
-    path.moveTo(p2);
-    path.lineTo(p3);
-    QGraphicsPathItem* item = addPath(path, QPen(Qt::yellow, 2));
+void CanvasScene::finishArc(const QPointF& p1, const QPointF& p2, const QPointF& p3) {
+    const QPointF pts[3] = {p1, p2, p3};
+    MeasureItem measure = makeMeasurement(MeasureRecord::Arc, pts, 3);
+    solveMeasurement(measure);
+    if (measure.record.valuePx <= 0) {
+        emit messageChanged("三点共线，无法绘制圆弧");
+        return;
+    }
+    finishPendingProject();
+    history->push(new AddCommand(this, measure));
+}
 
-    QGraphicsSimpleTextItem* text = addSimpleText(QString("%1°").arg(angleDeg, 0, 'f', 1));
-    text->setBrush(Qt::blue);
-    text->setPos(p2 + QPointF(10, 10));
+void CanvasScene::finishArcFit() {
+    GeometryBatch::CircleFit fit;
+    if (!GeometryBatch::fitCircle(fitX.constData(), fitY.constData(), fitX.size(), fit)) {
+        emit messageChanged("轮廓点不足或共线，无法拟合圆弧");
+        return;
+    }
 
-    measureItems.append({3, item, text, {p1, p2, p3}, {}});
+    QVector<QPointF> trace(fitX.size());
+    for (int i = 0; i < fitX.size(); ++i) {
+        trace[i] = QPointF(fitX[i], fitY[i]);
+    }
+    MeasureItem measure = makeMeasurement(MeasureRecord::FittedArc, trace.constData(), trace.size());
+    measure.record.center = QPointF(fit.cx, fit.cy);
+    measure.record.valuePx = fit.radius;
+    measure.record.residualPx = fit.rms;
+    measure.record.dirty = false;
+    finishPendingProject();
+    history->push(new AddCommand(this, measure));
+    emit messageChanged("圆弧拟合完成。");
 }
 
-void CanvasScene::finishDistance(QGraphicsLineItem* line, const QPointF& point) {
-    QLineF l = line->line();
-    
-    double lx1 = l.x1();
-    double ly1 = l.y1();
-    double lx2 = l.x2();
-    double ly2 = l.y2();
-    double px = point.x();
-    double py = point.y();
-    
-    double ABx = lx2 - lx1;
-    double ABy = ly2 - ly1;
-    double APx = px - lx1;
-    double APy = py - ly1;
-    
-    double t = (APx * ABx + APy * ABy) / (ABx * ABx + ABy * ABy);
-    
-    double projX = lx1 + t * ABx;
-    double projY = ly1 + t * ABy;
-    
-    QPointF projPoint(projX, projY);
-    
-    double distPx = dist(point, projPoint);
-    double distMm = toMm(distPx);
+void CanvasScene::finishAngle(const QPointF& p1, const QPointF& p2, const QPointF& p3) {
+    const QPointF pts[3] = {p1, p2, p3};
+    finishPendingProject();
+    history->push(new AddCommand(this, makeMeasurement(MeasureRecord::Angle, pts, 3)));
+}
 
-    QGraphicsLineItem* distLine = addLine(QLineF(point, projPoint), QPen(Qt::cyan, 1, Qt::DashLine));
-    
-    QGraphicsSimpleTextItem* text = addSimpleText(QString("距离: %1 mm").arg(distMm, 0, 'f', 2));
-    text->setBrush(Qt::blue);
-    text->setPos((point + projPoint) / 2);
-    
-    measureItems.append({2, distLine, text, {point, projPoint}, {}});
+void CanvasScene::finishDistance(int lineIndex, const QPointF& point) {
+    finishPendingProject();
+    const MeasureItem& line = measureItems[lineIndex];
+    const QPointF pts[2] = {point, Geometry::projectOntoLine(line.record.points[0], line.record.points[1], point)};
+    MeasureItem measure = makeMeasurement(MeasureRecord::Distance, pts, 2);
+    measure.parentId = line.id;
+    history->push(new AddCommand(this, measure));
 }
 
 void CanvasScene::clearMeasurements() {
-    for (const auto& item : measureItems) {
-        removeItem(item.graphicsItem);
-        removeItem(item.textItem);
-        for (auto* extra : item.extraItems) {
-            removeItem(extra);
-            delete extra;
-        }
-        delete item.graphicsItem;
-        delete item.textItem;
-    }
-    measureItems.clear();
-    
-    // Clear temp items if any
+    // Drop the distance selection before its item goes away
     setMode(ToolMode::None);
+    // Measurements of a project still being opened are cleared, and restored, with the rest
+    finishPendingProject();
+    if (!measureItems.isEmpty()) {
+        history->push(new ClearCommand(this));
+    }
+
     emit modeChanged(ToolMode::None);
     
     emit messageChanged("所有绘制对象已清除");
 }
+
+ProjectData CanvasScene::projectData() const {
+    ProjectData data;
+    data.imagePath = imagePath;
+    data.rawFormat = rawFormat;
+    data.scaleRatio = scaleRatio;
+    data.types.reserve(measureItems.size());
+    data.pointOffsets.reserve(measureItems.size() + 1);
+    if (!dependents.isEmpty()) {
+        data.parents.reserve(measureItems.size());
+    }
+    for (const auto& item : measureItems) {
+        data.types.append(item.record.type);
+        if (!dependents.isEmpty()) {
+            data.parents.append(item.parentId ? idIndex.value(item.parentId, -1) : -1);
+        }
+        if (item.record.type == MeasureRecord::FittedArc) {
+            for (const QPointF& p : item.trace) {
+                data.xs.append(p.x());
+                data.ys.append(p.y());
+            }
+        } else {
+            for (int i = 0; i < item.record.pointCount; ++i) {
+                data.xs.append(item.record.points[i].x());
+                data.ys.append(item.record.points[i].y());
+            }
+        }
+        data.pointOffsets.append(quint32(data.xs.size()));
+    }
+    return data;
+}
+
+bool CanvasScene::saveProject(const QString& path) {
+    // Measurements still waiting for their scene items belong to the project too
+    finishPendingProject();
+    ProjectData data = projectData();
+    // Stored relative to the project, so both can be moved together
+    if (!data.imagePath.isEmpty()) {
+        data.imagePath = QFileInfo(path).absoluteDir().relativeFilePath(data.imagePath);
+    }
+
+    QString error;
+    const bool ok = path.endsWith(".json", Qt::CaseInsensitive) ? ProjectFile::exportJson(path, data, &error)
+                                                                : ProjectFile::save(path, data, &error);
+    if (ok) {
+        emit messageChanged(QString("项目已保存: %1 (%2 个测量)").arg(path).arg(measureItems.size()));
+    } else {
+        emit messageChanged(QString("无法保存项目 %1: %2").arg(path, error));
+    }
+    return ok;
+}
+
+bool CanvasScene::openProject(const QString& path) {
+    QString error;
+    std::shared_ptr<ProjectFile> project;
+    if (path.endsWith(".json", Qt::CaseInsensitive)) {
+        ProjectData data;
+        if (ProjectFile::importJson(path, data, &error)) {
+            project = ProjectFile::fromData(data);
+        }
+    } else {
+        project = ProjectFile::open(path, &error);
+    }
+    if (!project) {
+        emit messageChanged(QString("无法打开项目 %1: %2").arg(path, error));
+        return false;
+    }
+
+    if (project->imagePath().isEmpty()) {
+        resetForImage();
+        emit modeChanged(ToolMode::None);
+    } else {
+        const QString image = QFileInfo(path).absoluteDir().absoluteFilePath(project->imagePath());
+        if (project->rawFormat().width > 0) {
+            loadRawImage(image, project->rawFormat());
+        } else {
+            loadImage(image);
+        }
+    }
+    scaleRatio = project->scaleRatio();
+
+    // Items are only created a chunk at a time, a large project shows up
+    // progressively instead of blocking the window
+    pendingProject = project;
+    pendingNext = 0;
+    // Ids are handed out up front, a distance may come before its line
+    pendingFirstId = nextId;
+    nextId += quint32(project->count());
+    createPendingMeasurements(ProjectChunk);
+    return true;
+}
+
+void CanvasScene::createPendingMeasurements(int budget) {
+    if (!pendingProject) return;
+    const ProjectFile& project = *pendingProject;
+    const int end = pendingNext + qMin(budget, project.count() - pendingNext);
+    dropHistory();
+    QVector<QPointF> points;
+    for (; pendingNext < end; ++pendingNext) {
+        const int n = project.pointCount(pendingNext);
+        points.resize(n);
+        for (int i = 0; i < n; ++i) {
+            points[i] = project.point(pendingNext, i);
+        }
+        MeasureItem measure = makeMeasurement(project.type(pendingNext), points.constData(), n);
+        measure.id = pendingFirstId + quint32(pendingNext);
+        const int parent = project.parent(pendingNext);
+        if (parent >= 0) {
+            measure.parentId = pendingFirstId + quint32(parent);
+        }
+        addMeasurement(measure);
+    }
+
+    if (pendingNext < project.count()) {
+        emit messageChanged(QString("正在打开项目: %1 / %2").arg(pendingNext).arg(project.count()));
+        projectTimer->start();
+    } else {
+        emit messageChanged(QString("项目已打开: %1 个测量").arg(measureItems.size()));
+        pendingProject.reset();
+    }
+}
@@ -3,21 +3,39 @@
 
 #include <QGraphicsScene>
 #include <QGraphicsSceneMouseEvent>
-#include <QGraphicsPixmapItem>
-#include <QGraphicsLineItem>
-#include <QGraphicsEllipseItem>
-#include <QGraphicsSimpleTextItem>
+#include <QHash>
 #include <QList>
+#include <QVector>
 #include <QPointF>
+#include <memory>
+#include "EdgeSnapper.h"
+#include "Geometry.h"
+#include "ImageEnhancer.h"
+#include "ImageSource.h"
+#include "MappedImageSource.h"
+#include "MeasureRecord.h"
+#include "SpatialIndex.h"
 
-static constexpr double PI = 3.1415926535897932384626433832795;
+class TiledImageItem;
+class FeatureDetector;
+class ImageExporter;
+class ImageLoader;
+class MeasureGraphicsItem;
+class MeasureOverlayItem;
+class PreviewItem;
+class ProjectFile;
+struct ProjectData;
+class QTimer;
+class QUndoStack;
 
 enum class ToolMode {
     None,
     Line,
     Arc,
     Angle,
-    Distance
+    Distance,
+    ArcFit,
+    Delete
 };
 
 class CanvasScene : public QGraphicsScene {
@@ -26,50 +44,200 @@ class CanvasScene : public QGraphicsScene {
 public:
     CanvasScene(QObject* parent = nullptr);
     void setMode(ToolMode mode);
+    ToolMode mode() const { return currentMode; }
     void setScaleRatio(double pxPerMm); // pixels per 1mm
-    void loadImage(const QString& path);
-    void clearMeasurements();
+    void loadImage(const QString& path); // asynchronous, see imageLoaded()
+    void loadRawImage(const QString& path, const RawImageFormat& format);
+    void clearMeasurements(); // undoable
+    // Image reference, scale and all measurements; *.json is the readable
+    // export, any other name the binary project format
+    bool saveProject(const QString& path);
+    bool openProject(const QString& path);
     double getScaleRatio() const { return scaleRatio; }
+    // Snap placed points to the nearest image edge
+    void setEdgeSnapping(bool enabled) { snapToEdges = enabled; }
+    bool edgeSnapping() const { return snapToEdges; }
+    // Draw all finished measurements with one batched item instead of an item each
+    void setBatchedRendering(bool enabled);
+    bool batchedRendering() const { return batched; }
+    // Keep the drawn image as a pixmap in device coordinates, reused while panning
+    void setImageCaching(bool enabled);
+    // Contrast and sharpening of the shown image only; measurements, edge
+    // snapping, detection and export keep using the original pixels
+    void setEnhancement(const EnhanceSettings& settings);
+    const EnhanceSettings& enhancement() const { return enhanceSettings; }
+    std::shared_ptr<ImageSource> imageSource() const { return currentImage; }
+    // An image still decoding or project measurements still being created
+    bool isLoading() const;
+    // Runs a preview update that is waiting for the next frame now
+    void flushPreview();
+    // Renders the image with all measurements at full resolution into a TIFF
+    // or BMP (by suffix) in the background; false if there is nothing to export
+    bool exportImage(const QString& path);
+    void cancelExport();
+    // Finds lines and circular arcs in the whole image in the background and
+    // adds them as measurements, as one undoable step; false without an image
+    bool detectFeatures();
+    void cancelDetection();
+
+    // Edits made through the methods below and clearMeasurements(). Commands
+    // keep only the geometry they change, and undo/redo of a single
+    // measurement touches no other one. Loading an image or a project, and
+    // measurements added without the history, start it over.
+    QUndoStack* undoStack() const { return history; }
+    // setScaleRatio() as an undoable step
+    void changeScaleRatio(double pxPerMm);
+    // Swaps the last measurement into its place; -1 picks nothing
+    void removeMeasurement(int index);
+    // New defining points, as many as the measurement has. A fitted arc is
+    // only translated by the offset of its first point, a distance that
+    // belongs to a line keeps its foot on that line. Measurements depending
+    // on this one are updated with it, no others.
+    void moveMeasurement(int index, const QPointF* points);
+
+    // A finished measurement as if it had been drawn; type and points as in
+    // the project file (MeasureRecord::Type, every traced point for fitted
+    // arcs). Not recorded in the undo history.
+    void appendMeasurement(int type, const QPointF* points, int count);
+    int measurementCount() const { return measureItems.size(); }
+
+    // Index of the measurement closest to pos within tolerance (scene units),
+    // optionally restricted to one type; -1 if none. This is the Distance
+    // mode pick.
+    int nearestMeasurement(const QPointF& pos, double tolerance, int typeFilter = -1) const;
 
 signals:
     void messageChanged(const QString& msg);
     void modeChanged(ToolMode mode);
+    void imageLoaded(const QString& path);
+    // The previous image is gone: a load or a project open has started
+    void imageCleared();
+    void exportProgress(int bandsDone, int bandCount);
+    void exportFinished(bool ok);
+    void detectionProgress(int tilesDone, int tileCount);
+    void detectionFinished(bool ok);
 
 protected:
     void mousePressEvent(QGraphicsSceneMouseEvent* event) override;
     void mouseMoveEvent(QGraphicsSceneMouseEvent* event) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent* event) override;
 
 private:
+    // One measurement: its geometry and the scene item drawing it
+    struct MeasureItem {
+        MeasureRecord record;
+        MeasureGraphicsItem* graphicsItem = nullptr; // null while rendering is batched
+        QVector<QPointF> trace; // fitted arcs: every traced point, empty otherwise
+        quint32 id = 0;         // stable across removal and undo, unlike the index
+        quint32 parentId = 0;   // distances: id of their line, 0 for none
+    };
+
+    void resetForImage();
+    void setImage(std::shared_ptr<ImageSource> source, const QSize& sceneSize);
+
     void finishLine(const QPointF& p1, const QPointF& p2);
     void finishArc(const QPointF& p1, const QPointF& p2, const QPointF& p3);
     void finishAngle(const QPointF& p1, const QPointF& p2, const QPointF& p3);
-    void finishDistance(QGraphicsLineItem* line, const QPointF& point);
+    void finishDistance(int lineIndex, const QPointF& point);
+    void finishArcFit();
+    // Measurement of the given type through points (the whole trace for fitted arcs)
+    static MeasureItem makeMeasurement(int type, const QPointF* points, int count);
+    // Solves it if needed, appends it and attaches it
+    void addMeasurement(MeasureItem measure);
+    // Scene item or overlay entry, and index entry, of the measurement at index
+    void attachMeasurement(int index);
+    void detachMeasurement(int index);
+    // Swap-remove and its inverse, O(1) in the number of measurements
+    MeasureItem takeMeasurement(int index);
+    void insertMeasurement(int index, MeasureItem measure);
+    void setMeasurementPoints(int index, const QPointF* points);
+    // Re-solves the measurement at index and redraws it; a distance first
+    // follows its line if that still exists
+    void refreshMeasurement(int index);
+    // Defining point of a measurement within handleRadius of pos; false if none
+    bool pickHandle(const QPointF& pos, int& index, int& handle) const;
+    // Points of the measurement being dragged with its handle at pos
+    void dragPoints(const QPointF& pos, QPointF* points) const;
+    QList<MeasureItem> takeMeasurements();
+    void restoreMeasurements(const QList<MeasureItem>& items);
+    // After changes that bypass the history, which would no longer fit the measurements
+    void dropHistory();
+    // Creates what is left of a project being opened; before every edit that
+    // goes into the history, so a later chunk does not have to drop it
+    void finishPendingProject();
+    void createGraphicsItem(MeasureItem& item);
+    // Refills the overlay from measureItems when rendering is batched, empties it otherwise
+    void rebuildOverlay();
+    void setMeasurementHighlighted(int index, bool highlighted);
+    void createPendingMeasurements(int budget);
+    ProjectData projectData() const;
     
     void updateMeasurements();
+    static void solveMeasurement(MeasureItem& item);
+    QString labelText(const MeasureRecord& record) const;
     void updatePreview(const QPointF& pos);
+    // pos moved onto the nearest edge when snapping is on and one is in reach
+    QPointF snapPoint(const QPointF& pos);
 
-    // Helper to calculate distance in mm
-    double toMm(double pixels) const;
-    
+    void indexMeasurement(int index);
+
+    // Undo commands, see CanvasScene.cpp
+    class AddCommand;
+    class RemoveCommand;
+    class MoveCommand;
+    class ScaleCommand;
+    class ClearCommand;
 
     ToolMode currentMode;
     double scaleRatio; // pixels / mm
     
+    std::shared_ptr<ImageSource> currentImage;
+    QString imagePath;
+    qint64 loadStartNs; // PerfHud clock, -1 unless a timed load is running
+    RawImageFormat rawFormat; // width 0 unless imagePath is a raw dump
+    TiledImageItem* imageItem;
+    ImageLoader* imageLoader;
+    ImageExporter* imageExporter;
+    FeatureDetector* featureDetector;
+    std::unique_ptr<EdgeSnapper> edgeSnapper; // only for full resolution images
+    bool snapToEdges;
+    bool cacheImage;
+    EnhanceSettings enhanceSettings;
+    double snapRadius; // scene units, follows the zoom of the view under the mouse
+
     QList<QPointF> currentPoints;
-    QGraphicsLineItem* tempLine;
-    QGraphicsPathItem* tempArc; // Preview for arc
-    QGraphicsLineItem* selectedLineForDist; // The line selected for distance measurement
+    PreviewItem* preview;
+    // Mouse moves are folded into at most one preview update per display frame
+    QTimer* previewTimer;
+    QPointF pendingPreviewPos;
+    bool previewPending;
+    int selectedLineForDist; // The line selected for distance measurement, index into measureItems or -1
+    // Handle drag in ToolMode::None: measurement index or -1, handle, and its points when grabbed
+    int dragIndex;
+    int dragHandle;
+    QPointF dragStart[3];
+    bool dragStepping; // a drag step is being pushed to the history
+    double handleRadius; // scene units, like snapRadius
+    // Contour traced in ArcFit mode, kept as separate x/y arrays for the fit kernels
+    bool tracing;
+    QVector<double> fitX;
+    QVector<double> fitY;
     
-    // Store items to update them later
-    struct MeasureItem {
-        int type; // 0: Line, 1: Arc, 2: Distance
-        QGraphicsItem* graphicsItem; // The main visual item (Line, Path, etc.)
-        QGraphicsSimpleTextItem* textItem;
-        // Store geometry data to recalculate
-        QList<QPointF> points; 
-        QList<QGraphicsItem*> extraItems;
-    };
     QList<MeasureItem> measureItems;
+    SpatialIndex measureIndex; // keyed by position in measureItems
+    QHash<quint32, int> idIndex; // MeasureItem::id -> position in measureItems
+    // Line id -> ids of the distances measured from it, also while the line is removed
+    QHash<quint32, QVector<quint32>> dependents;
+    quint32 nextId;
+    MeasureOverlayItem* overlay;
+    bool batched;
+    QUndoStack* history;
+
+    // Project being opened; its measurements get scene items a chunk per event loop pass
+    std::shared_ptr<ProjectFile> pendingProject;
+    int pendingNext;
+    quint32 pendingFirstId; // id of the project's measurement 0
+    QTimer* projectTimer;
 };
 
 #endif // CANVASSCENE_H
@@ -1,5 +1,47 @@
 #include "CanvasView.h"
+#include "PerfHud.h"
+#include <QFontDatabase>
+#include <QGuiApplication>
+#include <QScreen>
 #include <QScrollBar>
+#include <QTimer>
+#include <cmath>
+
+// Zoom per wheel notch (120 units of angleDelta); finer wheels and trackpads get the matching fraction
+static const double ZoomPerNotch = 1.15;
+// Share of the remaining zoom applied per frame
+static const double ZoomEasing = 0.35;
+// Closer than this to the target the animation snaps onto it
+static const double ZoomEpsilon = 1e-3;
+// Still this long after zoom/pan before the quality render hints come back
+static const int IdleMs = 150;
+// Frame-time readout period
+static const int ReportMs = 500;
+// Performance overlay refresh period
+static const int HudMs = 250;
+
+RenderSettings RenderSettings::interactive() {
+    RenderSettings settings;
+    settings.updateMode = QGraphicsView::MinimalViewportUpdate;
+    // Every item sets the pen, brush and font it draws with
+    settings.optimizationFlags = QGraphicsView::DontSavePainterState | QGraphicsView::DontAdjustForAntialiasing;
+    settings.antialiasing = true;
+    settings.smoothPixmaps = true;
+    settings.hintsWhileMoving = false;
+    settings.cacheImage = true;
+    return settings;
+}
+
+RenderSettings RenderSettings::quality() {
+    RenderSettings settings;
+    settings.updateMode = QGraphicsView::MinimalViewportUpdate;
+    settings.antialiasing = true;
+    // Zoomed in, the pixel boundaries are what gets measured against
+    settings.smoothPixmaps = false;
+    settings.hintsWhileMoving = true;
+    settings.cacheImage = false;
+    return settings;
+}
 
 CanvasView::CanvasView(QWidget* parent) : QGraphicsView(parent) {
     init();
@@ -10,30 +52,193 @@ CanvasView::CanvasView(QGraphicsScene* scene, QWidget* parent) : QGraphicsView(s
 }
 
 void CanvasView::init() {
-    setRenderHint(QPainter::Antialiasing);
     setDragMode(QGraphicsView::NoDrag); // Custom handling
-    setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+    // Zoom keeps its own anchor, the mouse may have moved on by the time a frame is applied
+    setTransformationAnchor(QGraphicsView::NoAnchor);
     setResizeAnchor(QGraphicsView::AnchorUnderMouse);
     _isPanning = false;
+    _targetZoom = 1.0;
+
+    _frameTimer = new QTimer(this);
+    _frameTimer->setTimerType(Qt::PreciseTimer);
+    QScreen* screen = QGuiApplication::primaryScreen();
+    _frameTimer->setInterval(qMax(1, qRound(1000.0 / (screen ? screen->refreshRate() : 60.0))));
+    connect(_frameTimer, &QTimer::timeout, this, &CanvasView::advanceFrame);
+
+    _idleTimer = new QTimer(this);
+    _idleTimer->setSingleShot(true);
+    _idleTimer->setInterval(IdleMs);
+    connect(_idleTimer, &QTimer::timeout, this, [this]() {
+        applyRenderHints(false);
+        viewport()->update();
+    });
+
+    _frameNsTotal = 0;
+    _frameNsWorst = 0;
+    _frames = 0;
+    _reportClock.start();
+
+    _hudTimer = new QTimer(this);
+    _hudTimer->setInterval(HudMs);
+    _hudItems = 0;
+    connect(_hudTimer, &QTimer::timeout, this, [this]() {
+        _hudItems = scene() ? scene()->items().size() : 0;
+        // This repaint is not an answer to any input
+        PerfHud::discardInput();
+        viewport()->update(_hudRect);
+    });
+
+    setRenderSettings(RenderSettings::quality());
+}
+
+void CanvasView::setRenderSettings(const RenderSettings& settings) {
+    _settings = settings;
+    setViewportUpdateMode(settings.updateMode);
+    setOptimizationFlags(settings.optimizationFlags);
+    applyRenderHints(_frameTimer->isActive());
+    viewport()->update();
+}
+
+void CanvasView::applyRenderHints(bool moving) {
+    const bool on = !moving || _settings.hintsWhileMoving;
+    setRenderHint(QPainter::Antialiasing, on && _settings.antialiasing);
+    setRenderHint(QPainter::SmoothPixmapTransform, on && _settings.smoothPixmaps);
+}
+
+void CanvasView::setHudVisible(bool visible) {
+    PerfHud::setEnabled(visible);
+    if (visible) {
+        _hudTimer->start();
+    } else {
+        _hudTimer->stop();
+    }
+    viewport()->update();
+}
+
+void CanvasView::paintEvent(QPaintEvent* event) {
+    QElapsedTimer timer;
+    timer.start();
+    QGraphicsView::paintEvent(event);
+    const qint64 ns = timer.nsecsElapsed();
+    if (PerfHud::isEnabled()) {
+        PerfHud::record(PerfHud::Paint, ns);
+        PerfHud::markPainted();
+        QPainter painter(viewport());
+        paintHud(painter);
+    }
+
+    _frameNsTotal += ns;
+    _frameNsWorst = qMax(_frameNsWorst, ns);
+    ++_frames;
+    if (_reportClock.elapsed() >= ReportMs) {
+        emit frameTimeChanged(_frameNsTotal / 1e6 / _frames, _frameNsWorst / 1e6, _frames);
+        _frameNsTotal = 0;
+        _frameNsWorst = 0;
+        _frames = 0;
+        _reportClock.restart();
+    }
+}
+
+void CanvasView::scrollContentsBy(int dx, int dy) {
+    QGraphicsView::scrollContentsBy(dx, dy);
+    // Scrolling blits the viewport, overlay included: repaint where the
+    // overlay belongs and where its moved copy landed
+    if (PerfHud::isEnabled() && !_hudRect.isEmpty()) {
+        viewport()->update(_hudRect);
+        viewport()->update(_hudRect.translated(dx, dy));
+    }
 }
 
 void CanvasView::wheelEvent(QWheelEvent* event) {
+    PerfHud::markInput();
     if (event->modifiers() & Qt::ControlModifier) {
-        double scaleFactor = 1.15;
-        if (event->angleDelta().y() < 0) {
-            scaleFactor = 1.0 / scaleFactor;
-        }
-        setZoom(scaleFactor);
+        zoomBy(std::pow(ZoomPerNotch, event->angleDelta().y() / 120.0), event->position().toPoint());
+        event->accept();
     } else {
         QGraphicsView::wheelEvent(event);
     }
 }
 
-void CanvasView::setZoom(double scaleFactor) {
-    scale(scaleFactor, scaleFactor);
+void CanvasView::paintHud(QPainter& painter) {
+    QStringList lines;
+    for (int channel = 0; channel < PerfHud::ChannelCount; ++channel) {
+        const PerfHud::Percentiles p = PerfHud::percentiles(PerfHud::Channel(channel));
+        lines.append(QString("%1 p50 %2 p95 %3 p99 %4 ms (%5)")
+                         .arg(QString::fromUtf8(PerfHud::channelName(PerfHud::Channel(channel))), -8)
+                         .arg(p.p50, 7, 'f', 2).arg(p.p95, 7, 'f', 2).arg(p.p99, 7, 'f', 2)
+                         .arg(p.samples));
+    }
+    lines.append(QString("图元 %1  图块缓存 %2 MB")
+                     .arg(_hudItems).arg(PerfHud::gauge(PerfHud::TileCacheKB) / 1024.0, 0, 'f', 1));
+
+    static const QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    const QFontMetrics metrics(font);
+    int width = 0;
+    for (const QString& line : lines) {
+        width = qMax(width, metrics.horizontalAdvance(line));
+    }
+    _hudRect = QRect(8, 8, width + 16, metrics.lineSpacing() * lines.size() + 12);
+
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.fillRect(_hudRect, QColor(0, 0, 0, 170));
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+    int y = _hudRect.top() + 6 + metrics.ascent();
+    for (const QString& line : lines) {
+        painter.drawText(_hudRect.left() + 8, y, line);
+        y += metrics.lineSpacing();
+    }
+}
+
+void CanvasView::startFrames() {
+    _idleTimer->stop();
+    if (_frameTimer->isActive()) return;
+    _targetZoom = transform().m11();
+    _frameTimer->start();
+    applyRenderHints(true);
+}
+
+void CanvasView::zoomBy(double scaleFactor, const QPoint& anchor) {
+    startFrames();
+    _targetZoom *= scaleFactor;
+    _zoomAnchor = anchor;
+}
+
+void CanvasView::flushFrames() {
+    while (_frameTimer->isActive()) {
+        advanceFrame();
+    }
+}
+
+void CanvasView::advanceFrame() {
+    // Scrolling through the scroll bars lets the viewport blit what it already
+    // shows and only repaint the strip that came into view
+    if (!_pendingPan.isNull()) {
+        horizontalScrollBar()->setValue(horizontalScrollBar()->value() - _pendingPan.x());
+        verticalScrollBar()->setValue(verticalScrollBar()->value() - _pendingPan.y());
+        _pendingPan = QPoint();
+    }
+
+    const double current = transform().m11();
+    const double remaining = _targetZoom / current;
+    if (std::abs(remaining - 1) <= ZoomEpsilon) {
+        _frameTimer->stop();
+        _idleTimer->start();
+        return;
+    }
+    double step = std::pow(remaining, ZoomEasing);
+    if (std::abs(remaining / step - 1) <= ZoomEpsilon) {
+        step = remaining;
+    }
+    const QPointF anchorScene = mapToScene(_zoomAnchor);
+    scale(step, step);
+    const QPoint drift = mapFromScene(anchorScene) - _zoomAnchor;
+    horizontalScrollBar()->setValue(horizontalScrollBar()->value() + drift.x());
+    verticalScrollBar()->setValue(verticalScrollBar()->value() + drift.y());
 }
 
 void CanvasView::mousePressEvent(QMouseEvent* event) {
+    PerfHud::markInput();
     if (event->button() == Qt::RightButton) {
         _isPanning = true;
         _lastMousePos = event->pos();
@@ -45,12 +250,12 @@ void CanvasView::mousePressEvent(QMouseEvent* event) {
 }
 
 void CanvasView::mouseMoveEvent(QMouseEvent* event) {
+    PerfHud::markInput();
+    emit cursorMoved(mapToScene(event->position()));
     if (_isPanning) {
-        QPoint delta = event->pos() - _lastMousePos;
+        _pendingPan += event->pos() - _lastMousePos;
         _lastMousePos = event->pos();
-        
-        horizontalScrollBar()->setValue(horizontalScrollBar()->value() - delta.x());
-        verticalScrollBar()->setValue(verticalScrollBar()->value() - delta.y());
+        startFrames();
         event->accept();
     } else {
         QGraphicsView::mouseMoveEvent(event);
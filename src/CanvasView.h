@@ -1,10 +1,28 @@
 #ifndef CANVASVIEW_H
 #define CANVASVIEW_H
 
+#include <QElapsedTimer>
 #include <QGraphicsView>
 #include <QWheelEvent>
 #include <QMouseEvent>
 
+class QTimer;
+
+// How CanvasView trades image quality for repaint speed
+struct RenderSettings {
+    QGraphicsView::ViewportUpdateMode updateMode = QGraphicsView::MinimalViewportUpdate;
+    QGraphicsView::OptimizationFlags optimizationFlags;
+    bool antialiasing = true;
+    bool smoothPixmaps = false;       // filtered image scaling
+    bool hintsWhileMoving = true;     // false: both hints above are off during zoom/pan, back once idle
+    bool cacheImage = false;          // keep the drawn image as a device pixmap between repaints
+
+    // Cheapest repaints, full quality restored when the view comes to rest
+    static RenderSettings interactive();
+    // Antialiasing on every frame, image pixels unfiltered as before, nothing cached
+    static RenderSettings quality();
+};
+
 class CanvasView : public QGraphicsView {
     Q_OBJECT
 
@@ -12,18 +30,65 @@ public:
     CanvasView(QWidget* parent = nullptr);
     CanvasView(QGraphicsScene* scene, QWidget* parent = nullptr);
 
+    // cacheImage is for the scene to apply, the view only carries it
+    void setRenderSettings(const RenderSettings& settings);
+    const RenderSettings& renderSettings() const { return _settings; }
+
+    // Performance overlay in the top left corner, see PerfHud
+    void setHudVisible(bool visible);
+    bool hudVisible() const { return _hudTimer->isActive(); }
+
+    // Applies zoom and pan input still waiting for a frame right away, zoom
+    // animation included; for replaying input faster than real time
+    void flushFrames();
+
+signals:
+    // Paint time per viewport repaint over the last half second, in ms
+    void frameTimeChanged(double averageMs, double worstMs, int frames);
+    // Scene position under the mouse, on every move over the viewport
+    void cursorMoved(const QPointF& scenePos);
+
 protected:
+    void paintEvent(QPaintEvent* event) override;
     void wheelEvent(QWheelEvent* event) override;
     void mousePressEvent(QMouseEvent* event) override;
     void mouseReleaseEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
+    void scrollContentsBy(int dx, int dy) override;
 
 private:
     void init();
-    void setZoom(double scaleFactor);
+    // Zoom by scaleFactor around the viewport position anchor, eased over the next frames
+    void zoomBy(double scaleFactor, const QPoint& anchor);
+    // Starts applying input once per frame, switching to the moving render hints
+    void startFrames();
+    // Applies the input gathered since the last frame; stops the timer once idle
+    void advanceFrame();
+    void applyRenderHints(bool moving);
+    void paintHud(QPainter& painter);
 
     bool _isPanning;
     QPoint _lastMousePos;
+
+    // Wheel and drag input is only accumulated by the event handlers, the view
+    // transform changes at most once per display frame
+    QTimer* _frameTimer;
+    double _targetZoom; // view scale the zoom animation is heading for
+    QPoint _zoomAnchor; // viewport position that stays over the same scene point
+    QPoint _pendingPan; // drag distance not applied yet
+    QTimer* _idleTimer; // full quality again this long after the last frame
+
+    RenderSettings _settings;
+    // Frame-time readout
+    QElapsedTimer _reportClock;
+    qint64 _frameNsTotal;
+    qint64 _frameNsWorst;
+    int _frames;
+
+    // Overlay refresh; the item count is taken here, not on every paint
+    QTimer* _hudTimer;
+    QRect _hudRect;
+    int _hudItems;
 };
 
 #endif // CANVASVIEW_H
@@ -0,0 +1,129 @@
+#include "EdgeSnapper.h"
+#include <QRect>
+#include <QtMath>
+#include <cmath>
+
+EdgeSnapper::EdgeSnapper(std::shared_ptr<ImageSource> source, int cacheTiles)
+    : source(std::move(source)), cache(cacheTiles), minStrength(40.0f) {
+    imageSize = this->source ? this->source->size() : QSize();
+    const int windowSize = 2 * MaxRadius + 3;
+    windowGx.resize(windowSize * windowSize);
+    windowGy.resize(windowSize * windowSize);
+    windowMagnitude.resize(windowSize * windowSize);
+}
+
+EdgeSnapper::GradientTile* EdgeSnapper::gradientTile(int tx, int ty) {
+    const quint64 key = (quint64(quint32(ty)) << 32) | quint32(tx);
+    if (GradientTile* tile = cache.object(key)) {
+        return tile;
+    }
+
+    // The tile plus a one pixel border for the 3x3 kernel; rows and columns
+    // past the image edge are clamped to it
+    const QRect bounds(QPoint(0, 0), imageSize);
+    const QRect area = QRect(tx * TileSize, ty * TileSize, TileSize, TileSize).intersected(bounds);
+    const QRect padded = area.adjusted(-1, -1, 1, 1).intersected(bounds);
+    const QImage gray = source->tile(0, padded).convertToFormat(QImage::Format_Grayscale8);
+    if (gray.isNull()) return nullptr;
+
+    auto* tile = new GradientTile;
+    tile->width = area.width();
+    const int count = area.width() * area.height();
+    tile->gx.resize(count);
+    tile->gy.resize(count);
+    tile->magnitude.resize(count);
+
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        const uchar* r0 = gray.constScanLine(qMax(y - 1, padded.top()) - padded.top());
+        const uchar* r1 = gray.constScanLine(y - padded.top());
+        const uchar* r2 = gray.constScanLine(qMin(y + 1, padded.bottom()) - padded.top());
+        const int row = (y - area.top()) * tile->width;
+        for (int x = area.left(); x <= area.right(); ++x) {
+            const int l = qMax(x - 1, padded.left()) - padded.left();
+            const int c = x - padded.left();
+            const int r = qMin(x + 1, padded.right()) - padded.left();
+            const int gx = (r0[r] + 2 * r1[r] + r2[r]) - (r0[l] + 2 * r1[l] + r2[l]);
+            const int gy = (r2[l] + 2 * r2[c] + r2[r]) - (r0[l] + 2 * r0[c] + r0[r]);
+            const int i = row + x - area.left();
+            tile->gx[i] = float(gx);
+            tile->gy[i] = float(gy);
+            tile->magnitude[i] = std::sqrt(float(gx * gx + gy * gy));
+        }
+    }
+    cache.insert(key, tile, 1);
+    return tile;
+}
+
+bool EdgeSnapper::snap(const QPointF& pos, double radius, QPointF& snapped) {
+    if (imageSize.isEmpty()) return false;
+    const int r = qBound(1, qCeil(radius), int(MaxRadius));
+
+    // Search window plus a one pixel ring for the peak interpolation
+    const QRect window = QRect(qFloor(pos.x()) - r - 1, qFloor(pos.y()) - r - 1, 2 * r + 3, 2 * r + 3)
+                             .intersected(QRect(QPoint(0, 0), imageSize));
+    if (window.width() < 3 || window.height() < 3) return false;
+    const int w = window.width();
+
+    // Gather the window from the cached gradient tiles
+    for (int ty = window.top() / TileSize; ty <= window.bottom() / TileSize; ++ty) {
+        for (int tx = window.left() / TileSize; tx <= window.right() / TileSize; ++tx) {
+            const GradientTile* tile = gradientTile(tx, ty);
+            if (!tile) return false;
+            const QRect tileRect(tx * TileSize, ty * TileSize, TileSize, TileSize);
+            const QRect part = window.intersected(tileRect);
+            for (int y = part.top(); y <= part.bottom(); ++y) {
+                const int src = (y - tileRect.top()) * tile->width + part.left() - tileRect.left();
+                const int dst = (y - window.top()) * w + part.left() - window.left();
+                for (int x = 0; x < part.width(); ++x) {
+                    windowGx[dst + x] = tile->gx[src + x];
+                    windowGy[dst + x] = tile->gy[src + x];
+                    windowMagnitude[dst + x] = tile->magnitude[src + x];
+                }
+            }
+        }
+    }
+
+    // Strongest pixel inside the circle, the nearer one on ties
+    int best = -1;
+    float bestMagnitude = minStrength;
+    double bestDist2 = 0;
+    const double r2 = double(r) * r;
+    for (int y = 1; y < window.height() - 1; ++y) {
+        const double dy = window.top() + y + 0.5 - pos.y();
+        for (int x = 1; x < w - 1; ++x) {
+            const double dx = window.left() + x + 0.5 - pos.x();
+            const double d2 = dx * dx + dy * dy;
+            if (d2 > r2) continue;
+            const float m = windowMagnitude[y * w + x];
+            if (m > bestMagnitude || (m == bestMagnitude && best >= 0 && d2 < bestDist2)) {
+                best = y * w + x;
+                bestMagnitude = m;
+                bestDist2 = d2;
+            }
+        }
+    }
+    if (best < 0) return false;
+
+    // Step to the neighbour across the edge, the gradient direction rounded to
+    // one of the 8 neighbours as in Canny's non-maximum suppression
+    const float gx = windowGx[best], gy = windowGy[best];
+    const float tan22 = 0.41421356f;
+    int sx = 1, sy = 0;
+    if (std::abs(gy) > tan22 * std::abs(gx)) {
+        if (std::abs(gx) <= tan22 * std::abs(gy)) {
+            sx = 0;
+            sy = 1;
+        } else {
+            sy = (gx > 0) == (gy > 0) ? 1 : -1;
+        }
+    }
+    const float before = windowMagnitude[best - sy * w - sx];
+    const float after = windowMagnitude[best + sy * w + sx];
+    const float curvature = before - 2 * bestMagnitude + after;
+    double offset = curvature < 0 ? 0.5 * (before - after) / curvature : 0.0;
+    offset = qBound(-0.5, offset, 0.5);
+
+    const int bx = best % w, by = best / w;
+    snapped = QPointF(window.left() + bx + 0.5 + offset * sx, window.top() + by + 0.5 + offset * sy);
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef EDGESNAPPER_H
+#define EDGESNAPPER_H
+
+#include <QCache>
+#include <QPointF>
+#include <QSize>
+#include <QVector>
+#include <memory>
+#include "ImageSource.h"
+
+// Moves a point onto the strongest intensity edge near it, at sub-pixel
+// precision. Sobel gradients are computed per tile of the full resolution
+// image on first use and cached, so a snap only reads the few tiles under
+// its search window.
+class EdgeSnapper {
+public:
+    static constexpr int TileSize = 64;
+    static constexpr int MaxRadius = 32; // image pixels
+
+    EdgeSnapper(std::shared_ptr<ImageSource> source, int cacheTiles = 256);
+
+    // Finds the pixel with the largest gradient magnitude within radius of
+    // pos and refines it across the edge with a parabola through the
+    // magnitudes along the gradient direction. False if nothing in the window
+    // reaches the minimum strength.
+    bool snap(const QPointF& pos, double radius, QPointF& snapped);
+
+    // Sobel magnitude below which a window counts as flat (8-bit intensities)
+    void setMinStrength(float strength) { minStrength = strength; }
+
+private:
+    struct GradientTile {
+        int width;
+        QVector<float> gx;
+        QVector<float> gy;
+        QVector<float> magnitude;
+    };
+
+    GradientTile* gradientTile(int tx, int ty);
+
+    std::shared_ptr<ImageSource> source;
+    QSize imageSize;
+    QCache<quint64, GradientTile> cache; // cost in tiles
+    float minStrength;
+
+    // Gradients of the current search window, reused between snaps
+    QVector<float> windowGx;
+    QVector<float> windowGy;
+    QVector<float> windowMagnitude;
+};
+
+#endif // EDGESNAPPER_H
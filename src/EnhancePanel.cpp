@@ -0,0 +1,72 @@
+#include "EnhancePanel.h"
+#include <QFormLayout>
+#include <QLabel>
+#include <QPushButton>
+#include <QSlider>
+#include <cmath>
+
+EnhancePanel::EnhancePanel(QWidget* parent) : QWidget(parent) {
+    auto* layout = new QFormLayout(this);
+    black = addSlider(layout, "黑场", 0, 254, 0);
+    white = addSlider(layout, "白场", 1, 255, 255);
+    gamma = addSlider(layout, "伽马", -200, 200, 0);
+    clahe = addSlider(layout, "局部对比度", 0, 70, 0);
+    amount = addSlider(layout, "锐化强度", 0, 400, 0);
+    radius = addSlider(layout, "锐化半径", 1, 8, 2);
+    values = new QLabel();
+    values->setWordWrap(true);
+    auto* resetButton = new QPushButton("还原");
+    connect(resetButton, &QPushButton::clicked, this, &EnhancePanel::reset);
+    layout->addRow(values);
+    layout->addRow(resetButton);
+    updateLabels();
+}
+
+QSlider* EnhancePanel::addSlider(QFormLayout* layout, const QString& name, int minimum, int maximum, int value) {
+    auto* slider = new QSlider(Qt::Horizontal);
+    slider->setRange(minimum, maximum);
+    slider->setValue(value);
+    connect(slider, &QSlider::valueChanged, this, [this]() {
+        updateLabels();
+        emit settingsChanged(settings());
+    });
+    layout->addRow(name, slider);
+    return slider;
+}
+
+EnhanceSettings EnhancePanel::settings() const {
+    EnhanceSettings s;
+    s.black = black->value();
+    s.white = qMax(white->value(), s.black + 1);
+    s.gamma = std::pow(2.0, gamma->value() / 100.0);
+    // A limit below the mean bin would flatten the histogram to nothing
+    s.claheClip = clahe->value() > 0 ? 1.0 + clahe->value() / 10.0 : 0.0;
+    s.sharpenAmount = amount->value() / 100.0;
+    s.sharpenRadius = radius->value();
+    return s;
+}
+
+void EnhancePanel::reset() {
+    // One notification for the whole reset, not one per slider
+    const QSignalBlocker blockBlack(black), blockWhite(white), blockGamma(gamma);
+    const QSignalBlocker blockClahe(clahe), blockAmount(amount), blockRadius(radius);
+    black->setValue(0);
+    white->setValue(255);
+    gamma->setValue(0);
+    clahe->setValue(0);
+    amount->setValue(0);
+    radius->setValue(2);
+    updateLabels();
+    emit settingsChanged(settings());
+}
+
+void EnhancePanel::updateLabels() {
+    const EnhanceSettings s = settings();
+    values->setText(QString("色阶 %1–%2, 伽马 %3, 局部对比度 %4, 锐化 %5 (半径 %6)")
+                        .arg(s.black)
+                        .arg(s.white)
+                        .arg(s.gamma, 0, 'f', 2)
+                        .arg(s.claheClip > 0 ? QString::number(s.claheClip, 'f', 1) : QString("关"))
+                        .arg(s.sharpenAmount > 0 ? QString::number(s.sharpenAmount, 'f', 2) : QString("关"))
+                        .arg(s.sharpenRadius));
+}
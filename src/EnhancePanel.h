@@ -0,0 +1,40 @@
+#ifndef ENHANCEPANEL_H
+#define ENHANCEPANEL_H
+
+#include <QWidget>
+#include "ImageEnhancer.h"
+
+class QFormLayout;
+class QLabel;
+class QSlider;
+
+// Sliders for the display enhancement; every change is reported right away
+// so the view follows the slider while it is dragged
+class EnhancePanel : public QWidget {
+    Q_OBJECT
+
+public:
+    EnhancePanel(QWidget* parent = nullptr);
+
+    EnhanceSettings settings() const;
+
+public slots:
+    void reset();
+
+signals:
+    void settingsChanged(const EnhanceSettings& settings);
+
+private:
+    QSlider* addSlider(QFormLayout* layout, const QString& name, int minimum, int maximum, int value);
+    void updateLabels();
+
+    QSlider* black;
+    QSlider* white;
+    QSlider* gamma;   // log2 of the gamma in 1/100
+    QSlider* clahe;   // contrast limit above 1 in 1/10, 0 for off
+    QSlider* amount;  // sharpening in 1/100, 0 for off
+    QSlider* radius;
+    QLabel* values;
+};
+
+#endif // ENHANCEPANEL_H
@@ -0,0 +1,550 @@
+#include "FeatureDetector.h"
+#include "Geometry.h"
+#include "GeometryBatch.h"
+#include "MeasureRecord.h"
+#include <QPromise>
+#include <QRect>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+
+namespace {
+
+// Tiles are analysed with this much of their neighbours around them, so a
+// feature cut by a tile edge is still seen whole enough to be merged
+const int TileSize = 1024;
+const int Overlap = 32;
+// Sobel magnitude an edge pixel needs (8-bit intensities, as EdgeSnapper)
+const float MinStrength = 60.0f;
+
+// Lines: distance from the line and direction tolerance of an inlier, the
+// largest hole in a segment and the shortest segment kept (pixels)
+const double LineTolerance = 1.0;
+const double LineCos = 0.97; // about 14 degrees
+const double LineGap = 4.0;
+const double MinLineLength = 40.0;
+// Edge pixels per pixel of length a segment needs, about 1 for a clean edge
+const double MinLineDensity = 0.6;
+
+// Circles: radius range, distance from the circle of an inlier, shortest arc kept.
+// The largest circle is one that still fits into a tile with its overlap.
+const double MinRadius = 8.0;
+const double MaxRadius = 0.5 * (TileSize + 2 * Overlap);
+// Second points for a hypothesis are drawn from cells this close to the first;
+// larger circles are found through the opposite side of their diameter
+const double NearRadius = 256.0;
+const double CircleTolerance = 1.5;
+const double CircleCos = 0.95;
+const double MinArcDegrees = 60.0;
+const double MinArcDensity = 0.6;
+// Longest arc handed out; a full circle as start, middle and end would be degenerate
+const double MaxArcDegrees = 330.0;
+
+// Hypotheses per extracted feature and fruitless rounds before a tile is done
+const int Hypotheses = 16;
+const int MaxFailures = 12;
+// Scoring of a line hypothesis looks at no more than this many edge points
+const int ScoreSample = 4096;
+// Edge points are binned in cells of this size for the circle search
+const int CellSize = 32;
+
+// Merging of pieces from neighbouring tiles
+const double MergeDegrees = 1.0;
+const double MergeOffset = 1.5;
+const double MergeCircle = 3.0;
+
+struct EdgePoint {
+    float x, y;   // pixel centre, image coordinates
+    float nx, ny; // unit gradient
+};
+
+struct Job {
+    std::shared_ptr<ImageSource> source;
+    std::atomic<bool> canceled{false};
+};
+
+// Thin edges of area: pixels whose Sobel magnitude is above MinStrength and
+// a maximum across the edge, as in Canny's non-maximum suppression
+QVector<EdgePoint> extractEdges(const ImageSource& source, const QRect& area) {
+    const QRect bounds(QPoint(0, 0), source.size());
+    // One ring for the 3x3 kernel and one for the suppression
+    const QRect padded = area.adjusted(-2, -2, 2, 2).intersected(bounds);
+    const QImage gray = source.tile(0, padded).convertToFormat(QImage::Format_Grayscale8);
+    QVector<EdgePoint> edges;
+    if (gray.isNull()) return edges;
+
+    const int w = padded.width(), h = padded.height();
+    QVector<qint16> gxs(w * h), gys(w * h);
+    QVector<float> magnitude(w * h);
+    for (int y = 0; y < h; ++y) {
+        const uchar* r0 = gray.constScanLine(qMax(y - 1, 0));
+        const uchar* r1 = gray.constScanLine(y);
+        const uchar* r2 = gray.constScanLine(qMin(y + 1, h - 1));
+        for (int x = 0; x < w; ++x) {
+            const int l = qMax(x - 1, 0), r = qMin(x + 1, w - 1);
+            const int gx = (r0[r] + 2 * r1[r] + r2[r]) - (r0[l] + 2 * r1[l] + r2[l]);
+            const int gy = (r2[l] + 2 * r2[x] + r2[r]) - (r0[l] + 2 * r0[x] + r0[r]);
+            gxs[y * w + x] = qint16(gx);
+            gys[y * w + x] = qint16(gy);
+            magnitude[y * w + x] = std::sqrt(float(gx * gx + gy * gy));
+        }
+    }
+
+    const float tan22 = 0.41421356f;
+    const QRect inner = area.translated(-padded.topLeft()).intersected(QRect(1, 1, w - 2, h - 2));
+    for (int y = inner.top(); y <= inner.bottom(); ++y) {
+        for (int x = inner.left(); x <= inner.right(); ++x) {
+            const int i = y * w + x;
+            const float m = magnitude[i];
+            if (m < MinStrength) continue;
+            // Neighbours along the gradient rounded to one of 8 directions
+            const float gx = gxs[i], gy = gys[i];
+            int step = 1;
+            if (std::abs(gy) > tan22 * std::abs(gx)) {
+                if (std::abs(gx) <= tan22 * std::abs(gy)) {
+                    step = w;
+                } else {
+                    step = (gx > 0) == (gy > 0) ? w + 1 : w - 1;
+                }
+            }
+            if (m < magnitude[i - step] || m <= magnitude[i + step]) continue;
+            edges.append(EdgePoint{float(padded.left() + x) + 0.5f, float(padded.top() + y) + 0.5f, gx / m, gy / m});
+        }
+    }
+    return edges;
+}
+
+// Segment of a line through (px, py) with unit direction (dx, dy)
+struct LineFit {
+    double px, py, dx, dy;
+};
+
+// Total least squares line through the points
+LineFit fitLine(const QVector<EdgePoint>& edges, const QVector<int>& ids) {
+    double sx = 0, sy = 0;
+    for (int id : ids) {
+        sx += edges[id].x;
+        sy += edges[id].y;
+    }
+    const double mx = sx / ids.size(), my = sy / ids.size();
+    double sxx = 0, sxy = 0, syy = 0;
+    for (int id : ids) {
+        const double x = edges[id].x - mx, y = edges[id].y - my;
+        sxx += x * x;
+        sxy += x * y;
+        syy += y * y;
+    }
+    // Direction of the largest eigenvector of the scatter matrix
+    const double angle = 0.5 * std::atan2(2 * sxy, sxx - syy);
+    return LineFit{mx, my, std::cos(angle), std::sin(angle)};
+}
+
+// Takes lines out of the edge points of one tile; used[] marks the points they took
+void detectLines(const QVector<EdgePoint>& edges, QVector<bool>& used, std::mt19937& random,
+                 QVector<FeatureDetector::Feature>& out) {
+    QVector<int> active;
+    for (int i = 0; i < edges.size(); ++i) {
+        if (!used[i]) active.append(i);
+    }
+    QVector<int> inliers;
+    QVector<std::pair<double, int>> along;
+    int failures = 0;
+    while (active.size() >= MinLineLength * MinLineDensity && failures < MaxFailures) {
+        // One point and its gradient make a hypothesis; score on a sample of the rest
+        std::uniform_int_distribution<int> pick(0, active.size() - 1);
+        const int stride = qMax(1, int(active.size() / ScoreSample));
+        int bestSeed = -1, bestScore = 0;
+        for (int h = 0; h < Hypotheses; ++h) {
+            const int seed = active[pick(random)];
+            const EdgePoint& s = edges[seed];
+            int score = 0;
+            for (int k = 0; k < active.size(); k += stride) {
+                const EdgePoint& e = edges[active[k]];
+                if (std::abs((e.x - s.x) * s.nx + (e.y - s.y) * s.ny) <= LineTolerance
+                    && std::abs(e.nx * s.nx + e.ny * s.ny) >= LineCos) {
+                    ++score;
+                }
+            }
+            if (score > bestScore) {
+                bestScore = score;
+                bestSeed = seed;
+            }
+        }
+        if (bestSeed < 0) break;
+
+        // Inliers of the hypothesis, then of the least squares line through them
+        const EdgePoint& s = edges[bestSeed];
+        LineFit line{s.x, s.y, -s.ny, s.nx};
+        for (int pass = 0; pass < 2; ++pass) {
+            inliers.clear();
+            for (int id : active) {
+                const EdgePoint& e = edges[id];
+                if (std::abs((e.x - line.px) * line.dy - (e.y - line.py) * line.dx) <= LineTolerance
+                    && std::abs(e.nx * line.dy - e.ny * line.dx) >= LineCos) {
+                    inliers.append(id);
+                }
+            }
+            if (inliers.size() < 2) break;
+            line = fitLine(edges, inliers);
+        }
+
+        // The line may cross several edges, each run without a hole is a segment
+        along.clear();
+        for (int id : inliers) {
+            along.append({(edges[id].x - line.px) * line.dx + (edges[id].y - line.py) * line.dy, id});
+        }
+        std::sort(along.begin(), along.end());
+        bool found = false;
+        for (int begin = 0, end = 1; begin < along.size(); begin = end++) {
+            while (end < along.size() && along[end].first - along[end - 1].first <= LineGap) ++end;
+            const double t0 = along[begin].first, t1 = along[end - 1].first;
+            const double length = t1 - t0;
+            if (length < MinLineLength || (end - begin) < length * MinLineDensity) continue;
+            found = true;
+            for (int k = begin; k < end; ++k) used[along[k].second] = true;
+            FeatureDetector::Feature feature{MeasureRecord::Line, {}};
+            feature.points[0] = QPointF(line.px + t0 * line.dx, line.py + t0 * line.dy);
+            feature.points[1] = QPointF(line.px + t1 * line.dx, line.py + t1 * line.dy);
+            out.append(feature);
+        }
+        if (!found) {
+            ++failures;
+            continue;
+        }
+        failures = 0;
+        active.erase(std::remove_if(active.begin(), active.end(), [&](int id) { return used[id]; }), active.end());
+    }
+}
+
+// Takes circular arcs out of the edge points of one tile that no line took
+void detectCircles(const QVector<EdgePoint>& edges, QVector<bool>& used, const QRect& area, std::mt19937& random,
+                   QVector<FeatureDetector::Feature>& out) {
+    QVector<int> active;
+    for (int i = 0; i < edges.size(); ++i) {
+        if (!used[i]) active.append(i);
+    }
+    if (active.size() < MinArcDensity * MinRadius * MinArcDegrees * PI / 180) return;
+
+    // Points by cell, so that hypotheses and their scoring only look near a circle
+    const int columns = (area.width() + CellSize - 1) / CellSize, rows = (area.height() + CellSize - 1) / CellSize;
+    QVector<QVector<int>> cells(columns * rows);
+    const auto cellOf = [&](double x, double y, int& cx, int& cy) {
+        cx = qBound(0, int((x - area.left()) / CellSize), columns - 1);
+        cy = qBound(0, int((y - area.top()) / CellSize), rows - 1);
+    };
+    for (int id : active) {
+        int cx, cy;
+        cellOf(edges[id].x, edges[id].y, cx, cy);
+        cells[cy * columns + cx].append(id);
+    }
+    // Inliers of the circle among the cells its ring touches
+    QVector<int> inliers;
+    const auto collect = [&](double x, double y, double r, double tolerance) {
+        inliers.clear();
+        int c0, r0, c1, r1;
+        cellOf(x - r - tolerance, y - r - tolerance, c0, r0);
+        cellOf(x + r + tolerance, y + r + tolerance, c1, r1);
+        for (int cy = r0; cy <= r1; ++cy) {
+            for (int cx = c0; cx <= c1; ++cx) {
+                for (int id : cells[cy * columns + cx]) {
+                    if (used[id]) continue;
+                    const EdgePoint& e = edges[id];
+                    const double vx = e.x - x, vy = e.y - y;
+                    const double d = std::sqrt(vx * vx + vy * vy);
+                    if (d > 0 && std::abs(d - r) <= tolerance && std::abs(vx * e.nx + vy * e.ny) >= CircleCos * d) {
+                        inliers.append(id);
+                    }
+                }
+            }
+        }
+    };
+
+    QVector<double> xs, ys, angles;
+    const int reach = int(std::ceil(2 * NearRadius / CellSize));
+    QVector<int> visited(columns * rows, -1); // walk that last looked at a cell
+    int walk = 0;
+    int failures = 0;
+    while (failures < MaxFailures) {
+        active.erase(std::remove_if(active.begin(), active.end(), [&](int id) { return used[id]; }), active.end());
+        if (active.isEmpty()) break;
+        std::uniform_int_distribution<int> pick(0, active.size() - 1);
+        const EdgePoint& p = edges[active[pick(random)]];
+        int pcx, pcy;
+        cellOf(p.x, p.y, pcx, pcy);
+
+        double bestX = 0, bestY = 0, bestR = 0;
+        int bestScore = 0;
+        const auto consider = [&](double x, double y, double r) {
+            if (r < MinRadius || r > MaxRadius) return;
+            collect(x, y, r, CircleTolerance);
+            if (inliers.size() > bestScore) {
+                bestScore = inliers.size();
+                bestX = x;
+                bestY = y;
+                bestR = r;
+            }
+        };
+
+        // A second point near the first: the centre is where their gradient lines cross
+        std::uniform_int_distribution<int> offset(-reach, reach);
+        for (int h = 0; h < Hypotheses; ++h) {
+            const int cx = pcx + offset(random), cy = pcy + offset(random);
+            if (cx < 0 || cy < 0 || cx >= columns || cy >= rows || cells[cy * columns + cx].isEmpty()) continue;
+            const QVector<int>& cell = cells[cy * columns + cx];
+            const EdgePoint& q = edges[cell[std::uniform_int_distribution<int>(0, cell.size() - 1)(random)]];
+            const double cross = p.nx * q.ny - p.ny * q.nx;
+            if (&q == &p || std::abs(cross) < 0.1) continue;
+            // p + s np = q + t nq
+            const double s = ((q.x - p.x) * q.ny - (q.y - p.y) * q.nx) / cross;
+            const double x = p.x + s * p.nx, y = p.y + s * p.ny;
+            const double rp = std::abs(s), rq = std::hypot(q.x - x, q.y - y);
+            if (std::abs(rp - rq) > 2 * CircleTolerance) continue;
+            consider(x, y, 0.5 * (rp + rq));
+        }
+
+        // The other end of the diameter lies on the gradient line of the first
+        // point, with the opposite gradient; the cells along that line on both
+        // sides are searched for it, nearest first. Needs more than half of the
+        // circle in the tile but no luck with cells, whatever the radius.
+        ++walk;
+        int tried = 0;
+        for (double step = 2 * MinRadius; step <= 2 * MaxRadius && tried < Hypotheses; step += 0.25 * CellSize) {
+            for (int side = -1; side <= 1; side += 2) {
+                for (int across = -1; across <= 1; ++across) {
+                    int cx, cy;
+                    cellOf(p.x + side * step * p.nx - across * 2 * CircleTolerance * p.ny,
+                           p.y + side * step * p.ny + across * 2 * CircleTolerance * p.nx, cx, cy);
+                    if (visited[cy * columns + cx] == walk) continue;
+                    visited[cy * columns + cx] = walk;
+                    for (int id : cells[cy * columns + cx]) {
+                        const EdgePoint& q = edges[id];
+                        if (used[id] || &q == &p || p.nx * q.nx + p.ny * q.ny > -CircleCos) continue;
+                        const double dx = q.x - p.x, dy = q.y - p.y;
+                        if (std::abs(dx * p.ny - dy * p.nx) > 2 * CircleTolerance) continue;
+                        consider(0.5 * (p.x + q.x), 0.5 * (p.y + q.y), 0.5 * std::hypot(dx, dy));
+                        ++tried;
+                    }
+                }
+            }
+        }
+        if (bestScore < MinArcDensity * bestR * MinArcDegrees * PI / 180 || bestScore < 3) {
+            ++failures;
+            continue;
+        }
+
+        // Least squares circle through the inliers, then its own inliers
+        collect(bestX, bestY, bestR, CircleTolerance);
+        xs.resize(inliers.size());
+        ys.resize(inliers.size());
+        for (int k = 0; k < inliers.size(); ++k) {
+            xs[k] = edges[inliers[k]].x;
+            ys[k] = edges[inliers[k]].y;
+        }
+        GeometryBatch::CircleFit fit;
+        if (!GeometryBatch::fitCircle(xs.constData(), ys.constData(), std::size_t(xs.size()), fit)
+            || fit.radius < MinRadius || fit.radius > MaxRadius || fit.rms > CircleTolerance) {
+            ++failures;
+            continue;
+        }
+        collect(fit.cx, fit.cy, fit.radius, CircleTolerance);
+
+        // The arc is the circle less its largest gap without inliers
+        angles.resize(inliers.size());
+        for (int k = 0; k < inliers.size(); ++k) {
+            angles[k] = std::atan2(edges[inliers[k]].y - fit.cy, edges[inliers[k]].x - fit.cx);
+        }
+        std::sort(angles.begin(), angles.end());
+        double gap = angles.isEmpty() ? 2 * PI : angles.first() + 2 * PI - angles.last();
+        double start = angles.isEmpty() ? 0 : angles.first();
+        for (int k = 1; k < angles.size(); ++k) {
+            if (angles[k] - angles[k - 1] > gap) {
+                gap = angles[k] - angles[k - 1];
+                start = angles[k];
+            }
+        }
+        const double span = qMin(2 * PI - gap, MaxArcDegrees * PI / 180);
+        if (span < MinArcDegrees * PI / 180 || inliers.size() < MinArcDensity * fit.radius * span) {
+            ++failures;
+            continue;
+        }
+        failures = 0;
+        for (int id : inliers) used[id] = true;
+        FeatureDetector::Feature feature{MeasureRecord::Arc, {}};
+        for (int k = 0; k < 3; ++k) {
+            const double a = start + span * k / 2;
+            feature.points[k] = QPointF(fit.cx + fit.radius * std::cos(a), fit.cy + fit.radius * std::sin(a));
+        }
+        out.append(feature);
+    }
+}
+
+QVector<FeatureDetector::Feature> detectTile(const Job& job, const QRect& tile, int seed) {
+    QVector<FeatureDetector::Feature> features;
+    if (job.canceled) return features;
+    const QRect area = tile.adjusted(-Overlap, -Overlap, Overlap, Overlap).intersected(QRect(QPoint(0, 0), job.source->size()));
+    const QVector<EdgePoint> edges = extractEdges(*job.source, area);
+    QVector<bool> used(edges.size(), false);
+    // Seeded by tile, so a detection gives the same result every time
+    std::mt19937 random(seed);
+    detectLines(edges, used, random, features);
+    if (job.canceled) return features;
+    detectCircles(edges, used, area, random, features);
+    return features;
+}
+
+double lineAngle(const FeatureDetector::Feature& f) {
+    double a = std::atan2(f.points[1].y() - f.points[0].y(), f.points[1].x() - f.points[0].x()) * 180 / PI;
+    if (a < 0) a += 180;
+    return a >= 180 ? a - 180 : a;
+}
+
+// Joins pieces of one straight edge found by neighbouring tiles: nearly the
+// same direction, on the same line and overlapping or touching along it
+QVector<FeatureDetector::Feature> mergeLines(QVector<FeatureDetector::Feature> lines) {
+    std::sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) { return lineAngle(a) < lineAngle(b); });
+    QVector<FeatureDetector::Feature> merged;
+    QVector<double> angles;
+    // Extends merged line k by line if both lie on one line and overlap or touch
+    const auto join = [&](int k, const FeatureDetector::Feature& line) {
+        FeatureDetector::Feature& m = merged[k];
+        const QPointF a = m.points[0], b = m.points[1];
+        const double length = Geometry::distance(a, b);
+        if (length <= 0) return false;
+        const QPointF d = (b - a) / length;
+        const auto offset = [&](const QPointF& p) { return std::abs((p.x() - a.x()) * d.y() - (p.y() - a.y()) * d.x()); };
+        if (offset(line.points[0]) > MergeOffset || offset(line.points[1]) > MergeOffset) return false;
+        const auto along = [&](const QPointF& p) { return (p.x() - a.x()) * d.x() + (p.y() - a.y()) * d.y(); };
+        const double t0 = qMin(along(line.points[0]), along(line.points[1]));
+        const double t1 = qMax(along(line.points[0]), along(line.points[1]));
+        if (t1 < -LineGap || t0 > length + LineGap) return false;
+        const double lo = qMin(0.0, t0), hi = qMax(length, t1);
+        m.points[0] = a + lo * d;
+        m.points[1] = a + hi * d;
+        return true;
+    };
+    for (const auto& line : lines) {
+        const double angle = lineAngle(line);
+        bool joined = false;
+        for (int k = merged.size() - 1; k >= 0 && angle - angles[k] <= MergeDegrees && !joined; --k) {
+            joined = join(k, line);
+        }
+        // Directions wrap at 180 degrees: a piece at 179.9 continues one at 0.2,
+        // which is common for the horizontal edges of machined parts
+        for (int k = 0; k < merged.size() && angles[k] + 180 - angle <= MergeDegrees && !joined; ++k) {
+            joined = join(k, line);
+        }
+        if (!joined) {
+            merged.append(line);
+            angles.append(angle);
+        }
+    }
+    return merged;
+}
+
+// Of arcs of one circle found by several tiles keeps the longest
+QVector<FeatureDetector::Feature> mergeArcs(const QVector<FeatureDetector::Feature>& arcs) {
+    struct Circle {
+        QPointF center;
+        double radius, span;
+        int index;
+    };
+    QVector<Circle> circles;
+    for (int i = 0; i < arcs.size(); ++i) {
+        Circle c{QPointF(), 0, 0, i};
+        if (!Geometry::circumcircle(arcs[i].points[0], arcs[i].points[1], arcs[i].points[2], c.center, c.radius)) continue;
+        double start;
+        Geometry::arcAngles(c.center, arcs[i].points[0], arcs[i].points[1], arcs[i].points[2], start, c.span);
+        c.span = std::abs(c.span);
+        circles.append(c);
+    }
+    std::sort(circles.begin(), circles.end(), [](const Circle& a, const Circle& b) { return a.span > b.span; });
+    QVector<FeatureDetector::Feature> merged;
+    QVector<Circle> kept;
+    for (const Circle& c : circles) {
+        const bool duplicate = std::any_of(kept.begin(), kept.end(), [&](const Circle& k) {
+            return Geometry::distance(k.center, c.center) <= MergeCircle && std::abs(k.radius - c.radius) <= MergeCircle;
+        });
+        if (duplicate) continue;
+        kept.append(c);
+        merged.append(arcs[c.index]);
+    }
+    return merged;
+}
+
+} // namespace
+
+FeatureDetector::FeatureDetector(QObject* parent) : QObject(parent), watcher(nullptr) {
+}
+
+FeatureDetector::~FeatureDetector() {
+    if (!watcher) return;
+    QFuture<Result> running = watcher->future();
+    cancel();
+    running.waitForFinished();
+}
+
+void FeatureDetector::cancel() {
+    if (!watcher) return;
+    // Tiles not started yet return right away, the running ones finish
+    disconnect(watcher, nullptr, this, nullptr);
+    watcher->future().cancel();
+    watcher->deleteLater();
+    watcher = nullptr;
+}
+
+void FeatureDetector::start(std::shared_ptr<ImageSource> source) {
+    cancel();
+
+    auto job = std::make_shared<Job>();
+    job->source = std::move(source);
+    QThreadPool* pool = &tilePool;
+    QFuture<Result> future = QtConcurrent::run([job, pool](QPromise<Result>& promise) {
+        const QSize size = job->source->size();
+        const int columns = (size.width() + TileSize - 1) / TileSize;
+        const int rows = (size.height() + TileSize - 1) / TileSize;
+        promise.setProgressRange(0, columns * rows);
+
+        // Tiles are small next to a thread's work on them, all are queued at once
+        QVector<QFuture<QVector<Feature>>> tiles;
+        for (int ty = 0; ty < rows; ++ty) {
+            for (int tx = 0; tx < columns; ++tx) {
+                const QRect tile = QRect(tx * TileSize, ty * TileSize, TileSize, TileSize).intersected(QRect(QPoint(0, 0), size));
+                const int seed = ty * columns + tx;
+                tiles.append(QtConcurrent::run(pool, [job, tile, seed]() { return detectTile(*job, tile, seed); }));
+            }
+        }
+
+        QVector<Feature> lines, arcs;
+        for (int i = 0; i < tiles.size(); ++i) {
+            if (promise.isCanceled()) {
+                job->canceled = true;
+                for (QFuture<QVector<Feature>>& tile : tiles) tile.waitForFinished();
+                promise.addResult(Result{{}, "已取消"});
+                return;
+            }
+            for (const Feature& f : tiles[i].result()) {
+                (f.type == MeasureRecord::Line ? lines : arcs).append(f);
+            }
+            promise.setProgressValue(i + 1);
+        }
+        promise.addResult(Result{mergeLines(std::move(lines)) + mergeArcs(arcs), QString()});
+    });
+
+    watcher = new QFutureWatcher<Result>(this);
+    connect(watcher, &QFutureWatcherBase::progressValueChanged, this, [this](int value) {
+        emit progressChanged(value, watcher->progressMaximum());
+    });
+    connect(watcher, &QFutureWatcherBase::finished, this, [this]() {
+        const Result result = watcher->future().resultCount() > 0 ? watcher->result() : Result{{}, "识别中断"};
+        watcher->deleteLater();
+        watcher = nullptr;
+        if (result.error.isEmpty()) {
+            emit finished(result.features);
+        } else {
+            emit failed(result.error);
+        }
+    });
+    watcher->setFuture(future);
+}
@@ -0,0 +1,52 @@
+#ifndef FEATUREDETECTOR_H
+#define FEATUREDETECTOR_H
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QPointF>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <memory>
+#include "ImageSource.h"
+
+// Finds straight edges and circular arcs in a whole image as a first pass
+// for the operator to correct. The full resolution image is cut into
+// overlapping tiles that run on a thread pool: each extracts thin edges
+// (Sobel with non-maximum suppression) and then takes lines and circles out
+// of them by RANSAC, seeded from the gradient direction at an edge point so
+// that one or two samples make a hypothesis. Pieces of one feature found by
+// neighbouring tiles are merged at the end.
+class FeatureDetector : public QObject {
+    Q_OBJECT
+
+public:
+    struct Feature {
+        int type;          // MeasureRecord::Line or MeasureRecord::Arc
+        QPointF points[3]; // as the measurement takes them: ends, or start, middle and end
+    };
+
+    FeatureDetector(QObject* parent = nullptr);
+    ~FeatureDetector();
+
+    // Cancels a detection that is still running
+    void start(std::shared_ptr<ImageSource> source);
+    void cancel();
+    bool isRunning() const { return watcher != nullptr; }
+
+signals:
+    void progressChanged(int tilesDone, int tileCount);
+    void finished(const QVector<FeatureDetector::Feature>& features);
+    void failed(const QString& error);
+
+private:
+    struct Result {
+        QVector<Feature> features;
+        QString error; // empty on success
+    };
+
+    QFutureWatcher<Result>* watcher;
+    QThreadPool tilePool;
+};
+
+#endif // FEATUREDETECTOR_H
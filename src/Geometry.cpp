@@ -0,0 +1,126 @@
+#include "Geometry.h"
+#include <QtGlobal>
+#include <cmath>
+
+namespace Geometry {
+
+double distance(const QPointF& p1, const QPointF& p2) {
+    const double dx = p1.x() - p2.x();
+    const double dy = p1.y() - p2.y();
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+bool circumcircle(const QPointF& p1, const QPointF& p2, const QPointF& p3, QPointF& center, double& radius) {
+    double x1 = p1.x(), y1 = p1.y();
+    double x2 = p2.x(), y2 = p2.y();
+    double x3 = p3.x(), y3 = p3.y();
+
+    double D = 2 * (x1 * (y2 - y3) + x2 * (y3 - y1) + x3 * (y1 - y2));
+    if (std::abs(D) < 1e-5) return false;
+
+    center.setX(((x1*x1 + y1*y1) * (y2 - y3) + (x2*x2 + y2*y2) * (y3 - y1) + (x3*x3 + y3*y3) * (y1 - y2)) / D);
+    center.setY(((x1*x1 + y1*y1) * (x3 - x2) + (x2*x2 + y2*y2) * (x1 - x3) + (x3*x3 + y3*y3) * (x2 - x1)) / D);
+    radius = distance(center, p1);
+    return true;
+}
+
+double angleDegrees(const QPointF& p1, const QPointF& vertex, const QPointF& p3) {
+    double v1x = p1.x() - vertex.x();
+    double v1y = p1.y() - vertex.y();
+    double v2x = p3.x() - vertex.x();
+    double v2y = p3.y() - vertex.y();
+
+    double dot = v1x * v2x + v1y * v2y;
+    double mag1 = std::sqrt(v1x*v1x + v1y*v1y);
+    double mag2 = std::sqrt(v2x*v2x + v2y*v2y);
+    return std::acos(dot / (mag1 * mag2)) * 180.0 / PI;
+}
+
+QPointF projectOntoLine(const QPointF& a, const QPointF& b, const QPointF& p) {
+    double ABx = b.x() - a.x();
+    double ABy = b.y() - a.y();
+    double APx = p.x() - a.x();
+    double APy = p.y() - a.y();
+
+    double t = (APx * ABx + APy * ABy) / (ABx * ABx + ABy * ABy);
+    return QPointF(a.x() + t * ABx, a.y() + t * ABy);
+}
+
+double distanceToSegment(const QPointF& p, const QPointF& a, const QPointF& b) {
+    const double abx = b.x() - a.x(), aby = b.y() - a.y();
+    const double len2 = abx * abx + aby * aby;
+    double t = len2 > 0 ? ((p.x() - a.x()) * abx + (p.y() - a.y()) * aby) / len2 : 0.0;
+    t = qBound(0.0, t, 1.0);
+    return distance(p, QPointF(a.x() + t * abx, a.y() + t * aby));
+}
+
+double distanceToArc(const QPointF& p, const QPointF& p1, const QPointF& p2, const QPointF& p3) {
+    QPointF c;
+    double r;
+    if (!circumcircle(p1, p2, p3, c, r)) {
+        return qMin(distanceToSegment(p, p1, p2), distanceToSegment(p, p2, p3));
+    }
+    auto angle = [&](const QPointF& q) { return std::atan2(q.y() - c.y(), q.x() - c.x()); };
+    auto ccwDelta = [](double from, double to) { double d = to - from; while (d < 0) d += 2 * PI; return d; };
+    const double a1 = angle(p1), a2 = angle(p2), a3 = angle(p3), ap = angle(p);
+    const double total = ccwDelta(a1, a3);
+    const bool inside = ccwDelta(a1, a2) <= total ? ccwDelta(a1, ap) <= total
+                                                   : ccwDelta(a3, ap) <= 2 * PI - total;
+    if (inside) {
+        return std::abs(distance(p, c) - r);
+    }
+    return qMin(distance(p, p1), distance(p, p3));
+}
+
+void arcAngles(const QPointF& center, const QPointF& p1, const QPointF& p2, const QPointF& p3,
+               double& startDegrees, double& spanDegrees) {
+    auto angleQt = [&](const QPointF& p) {
+        double a = std::atan2(-(p.y() - center.y()), p.x() - center.x()) * 180.0 / PI;
+        return a < 0 ? a + 360 : a;
+    };
+    auto ccwDelta = [](double from, double to) { double d = to - from; return d < 0 ? d + 360 : d; };
+    const double a1 = angleQt(p1);
+    const double ccwTotal = ccwDelta(a1, angleQt(p3));
+    startDegrees = a1;
+    spanDegrees = ccwDelta(a1, angleQt(p2)) <= ccwTotal ? ccwTotal : -(360 - ccwTotal);
+}
+
+QRectF arcBounds(const QPointF& center, double radius, double startDegrees, double spanDegrees) {
+    const double cx = center.x(), cy = center.y();
+    const double a1 = startDegrees * PI / 180.0;
+    const double a3 = (startDegrees + spanDegrees) * PI / 180.0;
+    const double x1 = cx + radius * std::cos(a1), y1 = cy - radius * std::sin(a1);
+    const double x3 = cx + radius * std::cos(a3), y3 = cy - radius * std::sin(a3);
+    double left = qMin(x1, x3), right = qMax(x1, x3), top = qMin(y1, y3), bottom = qMax(y1, y3);
+
+    auto ccwDelta = [](double from, double to) { double d = std::fmod(to - from, 360.0); return d < 0 ? d + 360 : d; };
+    for (int axis = 0; axis < 360; axis += 90) {
+        const bool swept = spanDegrees >= 0 ? ccwDelta(startDegrees, axis) <= spanDegrees
+                                            : ccwDelta(axis, startDegrees) <= -spanDegrees;
+        if (!swept) continue;
+        if (axis == 0) right = cx + radius;
+        else if (axis == 90) top = cy - radius;
+        else if (axis == 180) left = cx - radius;
+        else bottom = cy + radius;
+    }
+    return QRectF(left, top, right - left, bottom - top);
+}
+
+int arcSegments(double radius, double spanDegrees, double tolerance) {
+    // Largest angle whose chord stays within tolerance of the arc
+    const double step = radius > tolerance ? 2 * std::acos(1 - tolerance / radius) : PI / 2;
+    const double segments = std::ceil(std::abs(spanDegrees) * PI / 180.0 / step);
+    return int(qBound(1.0, segments, 1024.0));
+}
+
+void flattenArc(const QPointF& center, double radius, double startDegrees, double spanDegrees, int segments,
+                QPointF* out) {
+    const double a0 = startDegrees * PI / 180.0;
+    const double da = spanDegrees * PI / 180.0 / segments;
+    for (int i = 0; i <= segments; ++i) {
+        const double a = a0 + i * da;
+        out[i] = QPointF(center.x() + radius * std::cos(a), center.y() - radius * std::sin(a));
+    }
+}
+
+} // namespace Geometry
@@ -0,0 +1,46 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <QPointF>
+#include <QRectF>
+
+static constexpr double PI = 3.1415926535897932384626433832795;
+
+// Measurement kernels shared by the editor and the batch tools. Only depends
+// on QtCore so it can be linked without a GUI.
+namespace Geometry {
+
+double distance(const QPointF& p1, const QPointF& p2);
+
+// Circle through three points; false if they are (nearly) collinear
+bool circumcircle(const QPointF& p1, const QPointF& p2, const QPointF& p3, QPointF& center, double& radius);
+
+// Angle p1-vertex-p3 in degrees, 0..180
+double angleDegrees(const QPointF& p1, const QPointF& vertex, const QPointF& p3);
+
+// Foot of the perpendicular from p onto the infinite line through a and b
+QPointF projectOntoLine(const QPointF& a, const QPointF& b, const QPointF& p);
+
+double distanceToSegment(const QPointF& p, const QPointF& a, const QPointF& b);
+
+// Distance from p to the arc that starts at p1, passes p2 and ends at p3
+double distanceToArc(const QPointF& p, const QPointF& p1, const QPointF& p2, const QPointF& p3);
+
+// Arc around center from the direction of p1 through that of p2 to that of p3,
+// as QPainterPath::arcTo takes it: degrees, counter-clockwise on screen
+void arcAngles(const QPointF& center, const QPointF& p1, const QPointF& p2, const QPointF& p3,
+               double& startDegrees, double& spanDegrees);
+
+// Bounding rect of such an arc: its end points plus every axis extreme it sweeps over
+QRectF arcBounds(const QPointF& center, double radius, double startDegrees, double spanDegrees);
+
+// Chords needed for such an arc to stay within tolerance of it, 1..1024
+int arcSegments(double radius, double spanDegrees, double tolerance);
+
+// segments + 1 points along such an arc, from its start to its end
+void flattenArc(const QPointF& center, double radius, double startDegrees, double spanDegrees, int segments,
+                QPointF* out);
+
+} // namespace Geometry
+
+#endif // GEOMETRY_H
@@ -0,0 +1,395 @@
+#include "GeometryBatch.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MEASURE_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(MEASURE_HAVE_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace GeometryBatch {
+
+// Implemented in GeometryBatchAvx2.cpp, which is the only file built with AVX2 enabled
+namespace avx2 {
+std::size_t lineLengths(const double*, const double*, const double*, const double*, double*, std::size_t);
+std::size_t circumcircles(const double*, const double*, const double*, const double*, const double*, const double*,
+                          double*, double*, double*, std::size_t);
+std::size_t angles(const double*, const double*, const double*, const double*, const double*, const double*,
+                   double*, std::size_t);
+std::size_t pointLineDistances(const double*, const double*, const double*, const double*, const double*, const double*,
+                               double*, std::size_t);
+std::size_t pointSums(const double*, const double*, std::size_t, double*);
+std::size_t circleMoments(const double*, const double*, std::size_t, double, double, double*);
+std::size_t circleResidualSums(const double*, const double*, std::size_t, double, double, double*);
+}
+
+namespace {
+
+#ifdef MEASURE_HAVE_SSE2
+struct VecSse2 {
+    static constexpr std::size_t Width = 2;
+    __m128d v;
+
+    static VecSse2 load(const double* p) { return {_mm_loadu_pd(p)}; }
+    static VecSse2 set1(double d) { return {_mm_set1_pd(d)}; }
+    void store(double* p) const { _mm_storeu_pd(p, v); }
+
+    friend VecSse2 operator+(VecSse2 a, VecSse2 b) { return {_mm_add_pd(a.v, b.v)}; }
+    friend VecSse2 operator-(VecSse2 a, VecSse2 b) { return {_mm_sub_pd(a.v, b.v)}; }
+    friend VecSse2 operator*(VecSse2 a, VecSse2 b) { return {_mm_mul_pd(a.v, b.v)}; }
+    friend VecSse2 operator/(VecSse2 a, VecSse2 b) { return {_mm_div_pd(a.v, b.v)}; }
+    friend VecSse2 sqrt(VecSse2 a) { return {_mm_sqrt_pd(a.v)}; }
+    friend VecSse2 abs(VecSse2 a) { return {_mm_andnot_pd(_mm_set1_pd(-0.0), a.v)}; }
+
+    friend VecSse2 operator<(VecSse2 a, VecSse2 b) { return {_mm_cmplt_pd(a.v, b.v)}; }
+    friend VecSse2 operator>(VecSse2 a, VecSse2 b) { return {_mm_cmpgt_pd(a.v, b.v)}; }
+    friend VecSse2 operator&(VecSse2 a, VecSse2 b) { return {_mm_and_pd(a.v, b.v)}; }
+    friend VecSse2 operator!(VecSse2 a) { return {_mm_xor_pd(a.v, _mm_castsi128_pd(_mm_set1_epi32(-1)))}; }
+    friend VecSse2 select(VecSse2 mask, VecSse2 a, VecSse2 b) {
+        return {_mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v))};
+    }
+};
+
+#include "GeometryBatchKernels.h"
+#endif
+
+bool cpuHasAvx2() {
+#if defined(MEASURE_HAVE_AVX2) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    // The OS must also save the YMM registers on context switches
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(MEASURE_HAVE_AVX2)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+Isa detectIsa() {
+    if (cpuHasAvx2()) return Isa::Avx2;
+#ifdef MEASURE_HAVE_SSE2
+    return Isa::Sse2;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+std::atomic<int> maxIsa{int(Isa::Avx2)};
+
+// Scalar code for the tails and the fallback, written exactly like the
+// functions in Geometry.cpp
+
+void lineLengthsScalar(const double* x1, const double* y1, const double* x2, const double* y2,
+                       double* out, std::size_t i, std::size_t n) {
+    for (; i < n; ++i) {
+        const double dx = x1[i] - x2[i];
+        const double dy = y1[i] - y2[i];
+        out[i] = std::sqrt(dx * dx + dy * dy);
+    }
+}
+
+void circumcirclesScalar(const double* x1p, const double* y1p, const double* x2p, const double* y2p,
+                         const double* x3p, const double* y3p,
+                         double* cxp, double* cyp, double* rp, std::size_t i, std::size_t n) {
+    for (; i < n; ++i) {
+        const double x1 = x1p[i], y1 = y1p[i];
+        const double x2 = x2p[i], y2 = y2p[i];
+        const double x3 = x3p[i], y3 = y3p[i];
+        const double D = 2 * (x1 * (y2 - y3) + x2 * (y3 - y1) + x3 * (y1 - y2));
+        if (std::abs(D) < 1e-5) {
+            cxp[i] = cyp[i] = rp[i] = std::numeric_limits<double>::quiet_NaN();
+            continue;
+        }
+        const double cx = ((x1*x1 + y1*y1) * (y2 - y3) + (x2*x2 + y2*y2) * (y3 - y1) + (x3*x3 + y3*y3) * (y1 - y2)) / D;
+        const double cy = ((x1*x1 + y1*y1) * (x3 - x2) + (x2*x2 + y2*y2) * (x1 - x3) + (x3*x3 + y3*y3) * (x2 - x1)) / D;
+        const double dx = cx - x1;
+        const double dy = cy - y1;
+        cxp[i] = cx;
+        cyp[i] = cy;
+        rp[i] = std::sqrt(dx * dx + dy * dy);
+    }
+}
+
+void anglesScalar(const double* x1, const double* y1, const double* vx, const double* vy,
+                  const double* x3, const double* y3, double* out, std::size_t i, std::size_t n) {
+    const double pi = 3.1415926535897932384626433832795;
+    for (; i < n; ++i) {
+        const double v1x = x1[i] - vx[i];
+        const double v1y = y1[i] - vy[i];
+        const double v2x = x3[i] - vx[i];
+        const double v2y = y3[i] - vy[i];
+        const double dot = v1x * v2x + v1y * v2y;
+        const double mag1 = std::sqrt(v1x*v1x + v1y*v1y);
+        const double mag2 = std::sqrt(v2x*v2x + v2y*v2y);
+        out[i] = std::acos(dot / (mag1 * mag2)) * 180.0 / pi;
+    }
+}
+
+void pointLineDistancesScalar(const double* ax, const double* ay, const double* bx, const double* by,
+                              const double* px, const double* py, double* out, std::size_t i, std::size_t n) {
+    for (; i < n; ++i) {
+        const double ABx = bx[i] - ax[i];
+        const double ABy = by[i] - ay[i];
+        const double APx = px[i] - ax[i];
+        const double APy = py[i] - ay[i];
+        const double t = (APx * ABx + APy * ABy) / (ABx * ABx + ABy * ABy);
+        const double dx = px[i] - (ax[i] + t * ABx);
+        const double dy = py[i] - (ay[i] + t * ABy);
+        out[i] = std::sqrt(dx * dx + dy * dy);
+    }
+}
+
+} // namespace
+
+Isa activeIsa() {
+    static const Isa best = detectIsa();
+    return Isa(std::min(int(best), maxIsa.load(std::memory_order_relaxed)));
+}
+
+const char* isaName(Isa isa) {
+    switch (isa) {
+    case Isa::Avx2: return "avx2";
+    case Isa::Sse2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+void setMaxIsa(Isa isa) {
+    maxIsa.store(int(isa), std::memory_order_relaxed);
+}
+
+namespace {
+
+// Accumulating kernels: the vector part leaves partial sums, the scalar tail adds to them
+
+void pointSums(const double* x, const double* y, std::size_t n, double* sums) {
+    std::size_t i = 0;
+    switch (activeIsa()) {
+#ifdef MEASURE_HAVE_AVX2
+    case Isa::Avx2: i = avx2::pointSums(x, y, n, sums); break;
+#endif
+#ifdef MEASURE_HAVE_SSE2
+    case Isa::Sse2: i = pointSumsSimd<VecSse2>(x, y, n, sums); break;
+#endif
+    default: sums[0] = sums[1] = 0; break;
+    }
+    for (; i < n; ++i) {
+        sums[0] += x[i];
+        sums[1] += y[i];
+    }
+}
+
+void circleMoments(const double* xp, const double* yp, std::size_t n, double mx, double my, double* sums) {
+    std::size_t i = 0;
+    switch (activeIsa()) {
+#ifdef MEASURE_HAVE_AVX2
+    case Isa::Avx2: i = avx2::circleMoments(xp, yp, n, mx, my, sums); break;
+#endif
+#ifdef MEASURE_HAVE_SSE2
+    case Isa::Sse2: i = circleMomentsSimd<VecSse2>(xp, yp, n, mx, my, sums); break;
+#endif
+    default: std::fill(sums, sums + 6, 0.0); break;
+    }
+    for (; i < n; ++i) {
+        const double x = xp[i] - mx;
+        const double y = yp[i] - my;
+        const double z = x * x + y * y;
+        sums[0] += x * x;
+        sums[1] += y * y;
+        sums[2] += x * y;
+        sums[3] += x * z;
+        sums[4] += y * z;
+        sums[5] += z * z;
+    }
+}
+
+void circleResidualSums(const double* xp, const double* yp, std::size_t n, double a, double b, double* sums) {
+    std::size_t i = 0;
+    switch (activeIsa()) {
+#ifdef MEASURE_HAVE_AVX2
+    case Isa::Avx2: i = avx2::circleResidualSums(xp, yp, n, a, b, sums); break;
+#endif
+#ifdef MEASURE_HAVE_SSE2
+    case Isa::Sse2: i = circleResidualSumsSimd<VecSse2>(xp, yp, n, a, b, sums); break;
+#endif
+    default: std::fill(sums, sums + 7, 0.0); break;
+    }
+    for (; i < n; ++i) {
+        const double dx = xp[i] - a;
+        const double dy = yp[i] - b;
+        const double dd = dx * dx + dy * dy;
+        const double d = std::sqrt(dd);
+        const double u = d > 0 ? dx / d : 0.0;
+        const double v = d > 0 ? dy / d : 0.0;
+        sums[0] += u;
+        sums[1] += v;
+        sums[2] += u * u;
+        sums[3] += u * v;
+        sums[4] += v * v;
+        sums[5] += d;
+        sums[6] += dd;
+    }
+}
+
+// Solves the symmetric 3x3 system m * x = r by Cramer's rule
+bool solve3(const double m[3][3], const double r[3], double x[3]) {
+    const double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+                     - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+                     + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    if (!(std::abs(det) > 0)) return false;
+    for (int k = 0; k < 3; ++k) {
+        double c[3][3];
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                c[i][j] = j == k ? r[i] : m[i][j];
+            }
+        }
+        x[k] = (c[0][0] * (c[1][1] * c[2][2] - c[1][2] * c[2][1])
+              - c[0][1] * (c[1][0] * c[2][2] - c[1][2] * c[2][0])
+              + c[0][2] * (c[1][0] * c[2][1] - c[1][1] * c[2][0])) / det;
+    }
+    return true;
+}
+
+} // namespace
+
+void lineLengths(const double* x1, const double* y1, const double* x2, const double* y2, double* out, std::size_t n) {
+    std::size_t done = 0;
+    switch (activeIsa()) {
+#ifdef MEASURE_HAVE_AVX2
+    case Isa::Avx2: done = avx2::lineLengths(x1, y1, x2, y2, out, n); break;
+#endif
+#ifdef MEASURE_HAVE_SSE2
+    case Isa::Sse2: done = lineLengthsSimd<VecSse2>(x1, y1, x2, y2, out, n); break;
+#endif
+    default: break;
+    }
+    lineLengthsScalar(x1, y1, x2, y2, out, done, n);
+}
+
+void circumcircles(const double* x1, const double* y1, const double* x2, const double* y2,
+                   const double* x3, const double* y3, double* cx, double* cy, double* radius, std::size_t n) {
+    std::size_t done = 0;
+    switch (activeIsa()) {
+#ifdef MEASURE_HAVE_AVX2
+    case Isa::Avx2: done = avx2::circumcircles(x1, y1, x2, y2, x3, y3, cx, cy, radius, n); break;
+#endif
+#ifdef MEASURE_HAVE_SSE2
+    case Isa::Sse2: done = circumcirclesSimd<VecSse2>(x1, y1, x2, y2, x3, y3, cx, cy, radius, n); break;
+#endif
+    default: break;
+    }
+    circumcirclesScalar(x1, y1, x2, y2, x3, y3, cx, cy, radius, done, n);
+}
+
+void angles(const double* x1, const double* y1, const double* vx, const double* vy,
+            const double* x3, const double* y3, double* degrees, std::size_t n) {
+    std::size_t done = 0;
+    switch (activeIsa()) {
+#ifdef MEASURE_HAVE_AVX2
+    case Isa::Avx2: done = avx2::angles(x1, y1, vx, vy, x3, y3, degrees, n); break;
+#endif
+#ifdef MEASURE_HAVE_SSE2
+    case Isa::Sse2: done = anglesSimd<VecSse2>(x1, y1, vx, vy, x3, y3, degrees, n); break;
+#endif
+    default: break;
+    }
+    anglesScalar(x1, y1, vx, vy, x3, y3, degrees, done, n);
+}
+
+void pointLineDistances(const double* ax, const double* ay, const double* bx, const double* by,
+                        const double* px, const double* py, double* out, std::size_t n) {
+    std::size_t done = 0;
+    switch (activeIsa()) {
+#ifdef MEASURE_HAVE_AVX2
+    case Isa::Avx2: done = avx2::pointLineDistances(ax, ay, bx, by, px, py, out, n); break;
+#endif
+#ifdef MEASURE_HAVE_SSE2
+    case Isa::Sse2: done = pointLineDistancesSimd<VecSse2>(ax, ay, bx, by, px, py, out, n); break;
+#endif
+    default: break;
+    }
+    pointLineDistancesScalar(ax, ay, bx, by, px, py, out, done, n);
+}
+
+bool fitCircle(const double* x, const double* y, std::size_t n, CircleFit& fit, int iterations) {
+    if (n < 3) return false;
+    const double count = double(n);
+
+    // Taubin fit on coordinates centred at the centroid (Chernov's formulation)
+    double sums[7];
+    pointSums(x, y, n, sums);
+    const double mx = sums[0] / count;
+    const double my = sums[1] / count;
+    circleMoments(x, y, n, mx, my, sums);
+    const double Mxx = sums[0] / count, Myy = sums[1] / count, Mxy = sums[2] / count;
+    const double Mxz = sums[3] / count, Myz = sums[4] / count, Mzz = sums[5] / count;
+
+    const double Mz = Mxx + Myy;
+    const double covXY = Mxx * Myy - Mxy * Mxy;
+    const double varZ = Mzz - Mz * Mz;
+    const double A3 = 4 * Mz;
+    const double A2 = -3 * Mz * Mz - Mzz;
+    const double A1 = varZ * Mz + 4 * covXY * Mz - Mxz * Mxz - Myz * Myz;
+    const double A0 = Mxz * (Mxz * Myy - Myz * Mxy) + Myz * (Myz * Mxx - Mxz * Mxy) - varZ * covXY;
+
+    // Smallest root of the characteristic polynomial by Newton's method from 0
+    double root = 0, value = A0;
+    for (int i = 0; i < 99; ++i) {
+        const double slope = A1 + root * (2 * A2 + 3 * A3 * root);
+        const double next = root - value / slope;
+        if (next == root || !std::isfinite(next)) break;
+        const double nextValue = A0 + next * (A1 + next * (A2 + next * A3));
+        if (std::abs(nextValue) >= std::abs(value)) break;
+        root = next;
+        value = nextValue;
+    }
+    const double det = root * root - root * Mz + covXY;
+    // Collinear points put the centre at infinity
+    if (!(std::abs(det) > 1e-12 * Mz * Mz)) return false;
+    double a = (Mxz * (Myy - root) - Myz * Mxy) / det / 2;
+    double b = (Myz * (Mxx - root) - Mxz * Mxy) / det / 2;
+    double r = std::sqrt(a * a + b * b + Mz);
+    a += mx;
+    b += my;
+
+    // Gauss-Newton on sum (d_i - r)^2; the sum of (x_i - a) is count * (mx - a)
+    for (int it = 0; it <= iterations; ++it) {
+        circleResidualSums(x, y, n, a, b, sums);
+        const double su = sums[0], sv = sums[1], sd = sums[5];
+        const double sq = sums[6] - 2 * r * sd + count * r * r; // sum of squared residuals
+        fit.cx = a;
+        fit.cy = b;
+        fit.radius = r;
+        fit.rms = std::sqrt(std::max(0.0, sq) / count);
+        if (it == iterations) break;
+
+        const double m[3][3] = {{sums[2], sums[3], su}, {sums[3], sums[4], sv}, {su, sv, count}};
+        const double rhs[3] = {count * (mx - a) - r * su, count * (my - b) - r * sv, sd - count * r};
+        double step[3];
+        if (!solve3(m, rhs, step)) break;
+        a += step[0];
+        b += step[1];
+        r += step[2];
+        if (std::abs(step[0]) + std::abs(step[1]) + std::abs(step[2]) < 1e-12 * r) {
+            iterations = it + 1; // one more pass for the final residual
+        }
+    }
+    return std::isfinite(fit.radius);
+}
+
+} // namespace GeometryBatch
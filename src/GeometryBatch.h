@@ -0,0 +1,61 @@
+#ifndef GEOMETRYBATCH_H
+#define GEOMETRYBATCH_H
+
+#include <cstddef>
+
+// Structure-of-arrays versions of the Geometry kernels for bulk evaluation.
+// The widest instruction set the CPU supports is picked at runtime: AVX2
+// (4 doubles per instruction), SSE2 (2) or plain scalar code.
+//
+// Tolerance against the scalar Geometry functions:
+//  - lengths, radii, centres and point-line distances use the same operations
+//    in the same order and match to 1e-12 relative;
+//  - angles use atan2(|cross|, dot) instead of acos(dot / |v1||v2|) and match
+//    to 2e-6 degrees (acos itself is only that exact near 0 and 180 degrees).
+//    Where the acos argument rounds past +-1 the scalar formula gives NaN and
+//    these kernels give 0 or 180.
+// `MeasureCli --verify` checks these bounds on every instruction set the CPU has.
+namespace GeometryBatch {
+
+enum class Isa { Scalar, Sse2, Avx2 };
+
+Isa activeIsa();
+const char* isaName(Isa isa);
+// Restricts dispatch to isa (or the best supported one below it); for verification
+void setMaxIsa(Isa isa);
+
+constexpr double LengthTolerance = 1e-12; // relative
+constexpr double AngleTolerance = 2e-6;   // degrees
+
+// out[i] = |p1 - p2|
+void lineLengths(const double* x1, const double* y1, const double* x2, const double* y2,
+                 double* out, std::size_t n);
+
+// Circle through p1, p2, p3; centre and radius are NaN when the points are collinear
+void circumcircles(const double* x1, const double* y1, const double* x2, const double* y2,
+                   const double* x3, const double* y3,
+                   double* cx, double* cy, double* radius, std::size_t n);
+
+// Angle p1-vertex-p3 in degrees
+void angles(const double* x1, const double* y1, const double* vx, const double* vy,
+            const double* x3, const double* y3, double* degrees, std::size_t n);
+
+// Distance from p to the infinite line through a and b
+void pointLineDistances(const double* ax, const double* ay, const double* bx, const double* by,
+                        const double* px, const double* py, double* out, std::size_t n);
+
+struct CircleFit {
+    double cx = 0, cy = 0;
+    double radius = 0;
+    double rms = 0; // root mean square of the point-to-circle distances
+};
+
+// Least-squares circle through n points: Taubin's algebraic fit, refined by
+// up to `iterations` Gauss-Newton steps on the geometric distances. False
+// for fewer than three points or points on a line. The sums run through the
+// kernels above, so results differ between instruction sets only in rounding.
+bool fitCircle(const double* x, const double* y, std::size_t n, CircleFit& fit, int iterations = 5);
+
+} // namespace GeometryBatch
+
+#endif // GEOMETRYBATCH_H
@@ -0,0 +1,72 @@
+// Built with AVX2 code generation enabled (see CMakeLists.txt) and only called
+// after GeometryBatch has checked that the CPU supports it.
+
+#include <cstddef>
+#include <limits>
+#include <immintrin.h>
+
+namespace GeometryBatch {
+namespace avx2 {
+
+namespace {
+
+struct VecAvx2 {
+    static constexpr std::size_t Width = 4;
+    __m256d v;
+
+    static VecAvx2 load(const double* p) { return {_mm256_loadu_pd(p)}; }
+    static VecAvx2 set1(double d) { return {_mm256_set1_pd(d)}; }
+    void store(double* p) const { _mm256_storeu_pd(p, v); }
+
+    friend VecAvx2 operator+(VecAvx2 a, VecAvx2 b) { return {_mm256_add_pd(a.v, b.v)}; }
+    friend VecAvx2 operator-(VecAvx2 a, VecAvx2 b) { return {_mm256_sub_pd(a.v, b.v)}; }
+    friend VecAvx2 operator*(VecAvx2 a, VecAvx2 b) { return {_mm256_mul_pd(a.v, b.v)}; }
+    friend VecAvx2 operator/(VecAvx2 a, VecAvx2 b) { return {_mm256_div_pd(a.v, b.v)}; }
+    friend VecAvx2 sqrt(VecAvx2 a) { return {_mm256_sqrt_pd(a.v)}; }
+    friend VecAvx2 abs(VecAvx2 a) { return {_mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v)}; }
+
+    friend VecAvx2 operator<(VecAvx2 a, VecAvx2 b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)}; }
+    friend VecAvx2 operator>(VecAvx2 a, VecAvx2 b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)}; }
+    friend VecAvx2 operator&(VecAvx2 a, VecAvx2 b) { return {_mm256_and_pd(a.v, b.v)}; }
+    friend VecAvx2 operator!(VecAvx2 a) { return {_mm256_xor_pd(a.v, _mm256_castsi256_pd(_mm256_set1_epi32(-1)))}; }
+    friend VecAvx2 select(VecAvx2 mask, VecAvx2 a, VecAvx2 b) { return {_mm256_blendv_pd(b.v, a.v, mask.v)}; }
+};
+
+#include "GeometryBatchKernels.h"
+
+} // namespace
+
+std::size_t lineLengths(const double* x1, const double* y1, const double* x2, const double* y2,
+                        double* out, std::size_t n) {
+    return lineLengthsSimd<VecAvx2>(x1, y1, x2, y2, out, n);
+}
+
+std::size_t circumcircles(const double* x1, const double* y1, const double* x2, const double* y2,
+                          const double* x3, const double* y3, double* cx, double* cy, double* radius, std::size_t n) {
+    return circumcirclesSimd<VecAvx2>(x1, y1, x2, y2, x3, y3, cx, cy, radius, n);
+}
+
+std::size_t angles(const double* x1, const double* y1, const double* vx, const double* vy,
+                   const double* x3, const double* y3, double* degrees, std::size_t n) {
+    return anglesSimd<VecAvx2>(x1, y1, vx, vy, x3, y3, degrees, n);
+}
+
+std::size_t pointLineDistances(const double* ax, const double* ay, const double* bx, const double* by,
+                               const double* px, const double* py, double* out, std::size_t n) {
+    return pointLineDistancesSimd<VecAvx2>(ax, ay, bx, by, px, py, out, n);
+}
+
+std::size_t pointSums(const double* x, const double* y, std::size_t n, double* sums) {
+    return pointSumsSimd<VecAvx2>(x, y, n, sums);
+}
+
+std::size_t circleMoments(const double* x, const double* y, std::size_t n, double mx, double my, double* sums) {
+    return circleMomentsSimd<VecAvx2>(x, y, n, mx, my, sums);
+}
+
+std::size_t circleResidualSums(const double* x, const double* y, std::size_t n, double a, double b, double* sums) {
+    return circleResidualSumsSimd<VecAvx2>(x, y, n, a, b, sums);
+}
+
+} // namespace avx2
+} // namespace GeometryBatch
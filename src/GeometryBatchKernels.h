@@ -0,0 +1,206 @@
+#ifndef GEOMETRYBATCHKERNELS_H
+#define GEOMETRYBATCHKERNELS_H
+
+// Kernel bodies shared by the SSE2 and AVX2 builds of GeometryBatch. Only
+// include this from inside an anonymous namespace of a GeometryBatch
+// translation unit after defining the vector type V: every instantiation
+// then has internal linkage and can never be merged with code compiled for
+// another instruction set.
+//
+// V provides Width, load/store/set1, + - * /, sqrt, abs, comparisons
+// returning a mask, and select(mask, a, b).
+
+template <typename V>
+std::size_t lineLengthsSimd(const double* x1, const double* y1, const double* x2, const double* y2,
+                            double* out, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width) {
+        V dx = V::load(x1 + i) - V::load(x2 + i);
+        V dy = V::load(y1 + i) - V::load(y2 + i);
+        sqrt(dx * dx + dy * dy).store(out + i);
+    }
+    return i;
+}
+
+template <typename V>
+std::size_t circumcirclesSimd(const double* x1p, const double* y1p, const double* x2p, const double* y2p,
+                              const double* x3p, const double* y3p,
+                              double* cxp, double* cyp, double* rp, std::size_t n) {
+    const V two = V::set1(2.0);
+    const V eps = V::set1(1e-5);
+    const V nan = V::set1(std::numeric_limits<double>::quiet_NaN());
+    std::size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width) {
+        V x1 = V::load(x1p + i), y1 = V::load(y1p + i);
+        V x2 = V::load(x2p + i), y2 = V::load(y2p + i);
+        V x3 = V::load(x3p + i), y3 = V::load(y3p + i);
+        // Same operations in the same order as Geometry::circumcircle
+        V D = two * (x1 * (y2 - y3) + x2 * (y3 - y1) + x3 * (y1 - y2));
+        V s1 = x1 * x1 + y1 * y1;
+        V s2 = x2 * x2 + y2 * y2;
+        V s3 = x3 * x3 + y3 * y3;
+        V cx = (s1 * (y2 - y3) + s2 * (y3 - y1) + s3 * (y1 - y2)) / D;
+        V cy = (s1 * (x3 - x2) + s2 * (x1 - x3) + s3 * (x2 - x1)) / D;
+        V dx = cx - x1;
+        V dy = cy - y1;
+        V r = sqrt(dx * dx + dy * dy);
+        V collinear = abs(D) < eps;
+        select(collinear, nan, cx).store(cxp + i);
+        select(collinear, nan, cy).store(cyp + i);
+        select(collinear, nan, r).store(rp + i);
+    }
+    return i;
+}
+
+// atan(t) for t >= 0, Cephes range reduction and rational approximation;
+// within a few ulp of std::atan
+template <typename V>
+V atanNonNegative(V t) {
+    const V t3p8 = V::set1(2.41421356237309504880);
+    const V big = t > t3p8;
+    const V mid = (t > V::set1(0.66)) & !big;
+    const V one = V::set1(1.0);
+    V x = select(big, V::set1(0.0) - one / t, select(mid, (t - one) / (t + one), t));
+    V y = select(big, V::set1(1.57079632679489661923), select(mid, V::set1(0.78539816339744830962), V::set1(0.0)));
+    V morebits = select(big, V::set1(6.123233995736765886130E-17),
+                        select(mid, V::set1(0.5 * 6.123233995736765886130E-17), V::set1(0.0)));
+    V z = x * x;
+    V p = (((V::set1(-8.750608600031904122785E-1) * z + V::set1(-1.615753718733365076637E1)) * z
+            + V::set1(-7.500855792314704667340E1)) * z + V::set1(-1.228866684490136173410E2)) * z
+            + V::set1(-6.485021904942025371773E1);
+    V q = ((((z + V::set1(2.485846490142306297962E1)) * z + V::set1(1.650270098316988542046E2)) * z
+            + V::set1(4.328810604912902668951E2)) * z + V::set1(4.853903996359136964868E2)) * z
+            + V::set1(1.945506571482613964425E2);
+    z = z * p / q;
+    z = x * z + x + morebits;
+    return y + z;
+}
+
+template <typename V>
+std::size_t anglesSimd(const double* x1p, const double* y1p, const double* vxp, const double* vyp,
+                       const double* x3p, const double* y3p, double* out, std::size_t n) {
+    const V pi = V::set1(3.1415926535897932384626433832795);
+    const V toDegrees = V::set1(180.0);
+    const V zero = V::set1(0.0);
+    std::size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width) {
+        V vx = V::load(vxp + i), vy = V::load(vyp + i);
+        V v1x = V::load(x1p + i) - vx, v1y = V::load(y1p + i) - vy;
+        V v2x = V::load(x3p + i) - vx, v2y = V::load(y3p + i) - vy;
+        V dot = v1x * v2x + v1y * v2y;
+        V cross = abs(v1x * v2y - v1y * v2x);
+        // atan2(cross, dot) with cross >= 0, result in [0, pi]
+        V a = atanNonNegative<V>(cross / abs(dot));
+        V angle = select(dot < zero, pi - a, a);
+        (angle * toDegrees / pi).store(out + i);
+    }
+    return i;
+}
+
+template <typename V>
+std::size_t pointLineDistancesSimd(const double* axp, const double* ayp, const double* bxp, const double* byp,
+                                   const double* pxp, const double* pyp, double* out, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width) {
+        V ax = V::load(axp + i), ay = V::load(ayp + i);
+        V px = V::load(pxp + i), py = V::load(pyp + i);
+        V ABx = V::load(bxp + i) - ax;
+        V ABy = V::load(byp + i) - ay;
+        V APx = px - ax;
+        V APy = py - ay;
+        // Same operations as Geometry::projectOntoLine followed by distance()
+        V t = (APx * ABx + APy * ABy) / (ABx * ABx + ABy * ABy);
+        V dx = px - (ax + t * ABx);
+        V dy = py - (ay + t * ABy);
+        sqrt(dx * dx + dy * dy).store(out + i);
+    }
+    return i;
+}
+
+template <typename V>
+double horizontalSum(V v) {
+    double lanes[V::Width];
+    v.store(lanes);
+    double sum = 0;
+    for (std::size_t j = 0; j < V::Width; ++j) sum += lanes[j];
+    return sum;
+}
+
+// sums[0..1] = sum of x, y
+template <typename V>
+std::size_t pointSumsSimd(const double* xp, const double* yp, std::size_t n, double* sums) {
+    V sx = V::set1(0.0), sy = V::set1(0.0);
+    std::size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width) {
+        sx = sx + V::load(xp + i);
+        sy = sy + V::load(yp + i);
+    }
+    sums[0] = horizontalSum(sx);
+    sums[1] = horizontalSum(sy);
+    return i;
+}
+
+// Moments of the points relative to (mx, my), with z = x^2 + y^2:
+// sums[0..5] = xx, yy, xy, xz, yz, zz
+template <typename V>
+std::size_t circleMomentsSimd(const double* xp, const double* yp, std::size_t n, double mx, double my, double* sums) {
+    const V vmx = V::set1(mx), vmy = V::set1(my);
+    V sxx = V::set1(0.0), syy = sxx, sxy = sxx, sxz = sxx, syz = sxx, szz = sxx;
+    std::size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width) {
+        V x = V::load(xp + i) - vmx;
+        V y = V::load(yp + i) - vmy;
+        V z = x * x + y * y;
+        sxx = sxx + x * x;
+        syy = syy + y * y;
+        sxy = sxy + x * y;
+        sxz = sxz + x * z;
+        syz = syz + y * z;
+        szz = szz + z * z;
+    }
+    sums[0] = horizontalSum(sxx);
+    sums[1] = horizontalSum(syy);
+    sums[2] = horizontalSum(sxy);
+    sums[3] = horizontalSum(sxz);
+    sums[4] = horizontalSum(syz);
+    sums[5] = horizontalSum(szz);
+    return i;
+}
+
+// Terms of the Gauss-Newton normal equations for the circle centred at (a, b),
+// with d the distance of a point to the centre and (u, v) its unit direction:
+// sums[0..6] = u, v, uu, uv, vv, d, dd
+template <typename V>
+std::size_t circleResidualSumsSimd(const double* xp, const double* yp, std::size_t n, double a, double b, double* sums) {
+    const V va = V::set1(a), vb = V::set1(b);
+    const V zero = V::set1(0.0);
+    V su = zero, sv = zero, suu = zero, suv = zero, svv = zero, sd = zero, sdd = zero;
+    std::size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width) {
+        V dx = V::load(xp + i) - va;
+        V dy = V::load(yp + i) - vb;
+        V dd = dx * dx + dy * dy;
+        V d = sqrt(dd);
+        // A point exactly on the centre has no direction
+        V valid = d > zero;
+        V u = select(valid, dx / d, zero);
+        V v = select(valid, dy / d, zero);
+        su = su + u;
+        sv = sv + v;
+        suu = suu + u * u;
+        suv = suv + u * v;
+        svv = svv + v * v;
+        sd = sd + d;
+        sdd = sdd + dd;
+    }
+    sums[0] = horizontalSum(su);
+    sums[1] = horizontalSum(sv);
+    sums[2] = horizontalSum(suu);
+    sums[3] = horizontalSum(suv);
+    sums[4] = horizontalSum(svv);
+    sums[5] = horizontalSum(sd);
+    sums[6] = horizontalSum(sdd);
+    return i;
+}
+
+#endif // GEOMETRYBATCHKERNELS_H
@@ -0,0 +1,286 @@
+#include "ImageEnhancer.h"
+#include <QMutexLocker>
+#include <QVector>
+#include <QtMath>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MEASURE_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Pyramid level the CLAHE histograms are taken from; a region is 64 x 64 pixels there
+const int HistogramLevel = 4;
+const int MaxSharpenRadius = 8;
+const double MaxSharpenAmount = 4.0;
+
+// The blur of the unsharp mask is a box filter: column sums of 2r + 1 rows
+// slide down the image, and a running sum over 2r + 1 of them per channel
+// slides along the row. The per-row work on all bytes of a row is SIMD.
+
+void accumulateRow(quint16* sums, const uchar* row, int n) {
+    int i = 0;
+#ifdef MEASURE_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i* s = reinterpret_cast<__m128i*>(sums + i);
+        _mm_storeu_si128(s, _mm_add_epi16(_mm_loadu_si128(s), _mm_unpacklo_epi8(p, zero)));
+        _mm_storeu_si128(s + 1, _mm_add_epi16(_mm_loadu_si128(s + 1), _mm_unpackhi_epi8(p, zero)));
+    }
+#endif
+    for (; i < n; ++i) {
+        sums[i] += row[i];
+    }
+}
+
+// Moves the column sums one row down: entering is added, leaving taken off
+void slideRows(quint16* sums, const uchar* entering, const uchar* leaving, int n) {
+    int i = 0;
+#ifdef MEASURE_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(entering + i));
+        const __m128i out = _mm_loadu_si128(reinterpret_cast<const __m128i*>(leaving + i));
+        __m128i* s = reinterpret_cast<__m128i*>(sums + i);
+        const __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(in, zero), _mm_unpacklo_epi8(out, zero));
+        const __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(in, zero), _mm_unpackhi_epi8(out, zero));
+        _mm_storeu_si128(s, _mm_add_epi16(_mm_loadu_si128(s), lo));
+        _mm_storeu_si128(s + 1, _mm_add_epi16(_mm_loadu_si128(s + 1), hi));
+    }
+#endif
+    for (; i < n; ++i) {
+        sums[i] = quint16(sums[i] + entering[i] - leaving[i]);
+    }
+}
+
+// out = in + amount * (in - blurred), saturated; amount in 1/4096. The
+// difference is scaled by 16 first so that the high half of the 16-bit
+// product is the result, the same in the SIMD and the scalar code.
+void sharpenRow(const uchar* in, const uchar* blurred, uchar* out, int n, int amount) {
+    int i = 0;
+#ifdef MEASURE_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i factor = _mm_set1_epi16(short(amount));
+    for (; i + 16 <= n; i += 16) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blurred + i));
+        const __m128i plo = _mm_unpacklo_epi8(p, zero), phi = _mm_unpackhi_epi8(p, zero);
+        const __m128i dlo = _mm_slli_epi16(_mm_sub_epi16(plo, _mm_unpacklo_epi8(b, zero)), 4);
+        const __m128i dhi = _mm_slli_epi16(_mm_sub_epi16(phi, _mm_unpackhi_epi8(b, zero)), 4);
+        const __m128i rlo = _mm_add_epi16(plo, _mm_mulhi_epi16(dlo, factor));
+        const __m128i rhi = _mm_add_epi16(phi, _mm_mulhi_epi16(dhi, factor));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(rlo, rhi));
+    }
+#endif
+    for (; i < n; ++i) {
+        const int d = (int(in[i]) - int(blurred[i])) * 16;
+        const int v = int(in[i]) + ((d * amount) >> 16);
+        out[i] = uchar(qBound(0, v, 255));
+    }
+}
+
+QImage sharpen(const QImage& image, int radius, double amount) {
+    const int w = image.width(), h = image.height(), bytes = 4 * w;
+    QImage out(image.size(), QImage::Format_RGB32);
+    QVector<quint16> column(bytes, 0); // at most (2 * 8 + 1) * 255, fits
+    QVector<uchar> blurred(bytes);
+    const auto line = [&](int y) { return image.constScanLine(qBound(0, y, h - 1)); };
+    for (int k = -radius; k <= radius; ++k) {
+        accumulateRow(column.data(), line(k), bytes);
+    }
+
+    const int window = 2 * radius + 1;
+    const quint64 scale = ((quint64(1) << 24) + window * window / 2) / (window * window);
+    const int factor = qRound(qBound(0.0, amount, MaxSharpenAmount) * 4096);
+    for (int y = 0; y < h; ++y) {
+        if (y > 0) {
+            slideRows(column.data(), line(y + radius), line(y - radius - 1), bytes);
+        }
+        // Horizontal pass, per channel of the interleaved pixels
+        for (int c = 0; c < 4; ++c) {
+            const auto at = [&](int x) { return quint64(column[4 * qBound(0, x, w - 1) + c]); };
+            quint64 sum = 0;
+            for (int k = -radius; k <= radius; ++k) {
+                sum += at(k);
+            }
+            for (int x = 0; x < w; ++x) {
+                blurred[4 * x + c] = uchar((sum * scale + (1 << 23)) >> 24);
+                sum += at(x + radius + 1) - at(x - radius);
+            }
+        }
+        sharpenRow(image.constScanLine(y), blurred.constData(), out.scanLine(y), bytes, factor);
+    }
+    return out;
+}
+
+} // namespace
+
+bool EnhanceSettings::isIdentity() const {
+    return black <= 0 && white >= 255 && gamma == 1.0 && claheClip <= 0 && sharpenAmount <= 0;
+}
+
+bool EnhanceSettings::operator==(const EnhanceSettings& other) const {
+    return black == other.black && white == other.white && gamma == other.gamma && claheClip == other.claheClip
+           && sharpenAmount == other.sharpenAmount && sharpenRadius == other.sharpenRadius;
+}
+
+size_t qHash(const EnhanceSettings& settings, size_t seed) {
+    return qHashMulti(seed, settings.black, settings.white, settings.gamma, settings.claheClip, settings.sharpenAmount,
+                      settings.sharpenRadius);
+}
+
+ImageEnhancer::ImageEnhancer(std::shared_ptr<ImageSource> source, const EnhanceSettings& settings)
+    : source(std::move(source)), params(settings) {
+    const int black = qBound(0, params.black, 254);
+    const int white = qBound(black + 1, params.white, 255);
+    const double exponent = 1.0 / qMax(0.01, params.gamma);
+    for (int v = 0; v < 256; ++v) {
+        const double t = qBound(0.0, double(v - black) / (white - black), 1.0);
+        levels[v] = uchar(qRound(255.0 * std::pow(t, exponent)));
+    }
+    const QSize size = this->source->size();
+    regionColumns = qMax(1, (size.width() + RegionSize - 1) / RegionSize);
+    regionRows = qMax(1, (size.height() + RegionSize - 1) / RegionSize);
+}
+
+QByteArray ImageEnhancer::regionCurve(int rx, int ry) const {
+    const quint64 key = (quint64(ry) << 32) | quint32(rx);
+    {
+        QMutexLocker lock(&curveMutex);
+        auto it = curves.constFind(key);
+        if (it != curves.constEnd()) return it.value();
+    }
+
+    // Histogram after the levels table, from a coarse level: a few thousand pixels are plenty
+    const int level = qMin(HistogramLevel, source->levelCount() - 1);
+    const int size = RegionSize >> level;
+    const QRect rect = QRect(rx * size, ry * size, size, size).intersected(QRect(QPoint(0, 0), source->levelSize(level)));
+    const QImage gray = source->tile(level, rect).convertToFormat(QImage::Format_Grayscale8);
+    qint64 histogram[256] = {};
+    qint64 total = 0;
+    for (int y = 0; y < gray.height(); ++y) {
+        const uchar* row = gray.constScanLine(y);
+        for (int x = 0; x < gray.width(); ++x) {
+            ++histogram[levels[row[x]]];
+        }
+        total += gray.width();
+    }
+
+    QByteArray curve(256, Qt::Uninitialized);
+    if (total == 0) {
+        for (int v = 0; v < 256; ++v) curve[v] = char(v);
+    } else {
+        // Counts above the limit are spread over all bins, which bounds the slope of the curve
+        const qint64 limit = qMax<qint64>(1, qint64(params.claheClip * total / 256));
+        qint64 excess = 0;
+        for (qint64& count : histogram) {
+            if (count > limit) {
+                excess += count - limit;
+                count = limit;
+            }
+        }
+        qint64 cdf = 0;
+        for (int v = 0; v < 256; ++v) {
+            cdf += histogram[v] + excess / 256 + (v < excess % 256 ? 1 : 0);
+            curve[v] = char(uchar((cdf * 255 + total / 2) / total));
+        }
+    }
+
+    QMutexLocker lock(&curveMutex);
+    curves.insert(key, curve);
+    return curve;
+}
+
+void ImageEnhancer::applyCurves(QImage& image, int level, const QPoint& origin) const {
+    const int w = image.width(), h = image.height();
+    if (params.claheClip <= 0) {
+        for (int y = 0; y < h; ++y) {
+            QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < w; ++x) {
+                const QRgb p = row[x];
+                row[x] = qRgb(levels[qRed(p)], levels[qGreen(p)], levels[qBlue(p)]);
+            }
+        }
+        return;
+    }
+
+    // Every pixel blends the curves of the four regions whose centres
+    // surround it; positions are in full resolution pixels so the blend is
+    // the same at every zoom level. Weights in 1/256.
+    const double scale = double(qint64(1) << level) / RegionSize;
+    const auto locate = [&](int pixel, int regions, int& region, int& weight) {
+        const double g = (pixel + 0.5) * scale - 0.5;
+        region = qFloor(g);
+        weight = qRound((g - region) * 256);
+        if (region < 0) {
+            region = 0;
+            weight = 0;
+        } else if (region >= regions - 1) {
+            region = regions - 1;
+            weight = 0;
+        }
+    };
+    QVector<int> columnRegion(w), columnWeight(w);
+    for (int x = 0; x < w; ++x) {
+        locate(origin.x() + x, regionColumns, columnRegion[x], columnWeight[x]);
+    }
+    int firstRow, lastRow, unused;
+    locate(origin.y(), regionRows, firstRow, unused);
+    locate(origin.y() + h - 1, regionRows, lastRow, unused);
+    const int rx0 = columnRegion.first(), rx1 = qMin(columnRegion.last() + 1, regionColumns - 1);
+    const int ry1 = qMin(lastRow + 1, regionRows - 1);
+
+    // Curves of the regions this image touches, fetched once
+    const int span = rx1 - rx0 + 1;
+    QVector<QByteArray> local;
+    local.reserve(span * (ry1 - firstRow + 1));
+    for (int ry = firstRow; ry <= ry1; ++ry) {
+        for (int rx = rx0; rx <= rx1; ++rx) {
+            local.append(regionCurve(rx, ry));
+        }
+    }
+    const auto curve = [&](int rx, int ry) {
+        return reinterpret_cast<const uchar*>(local[(ry - firstRow) * span + rx - rx0].constData());
+    };
+
+    for (int y = 0; y < h; ++y) {
+        int ry, wy;
+        locate(origin.y() + y, regionRows, ry, wy);
+        const int ryNext = qMin(ry + 1, regionRows - 1);
+        QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < w; ++x) {
+            const int rx = columnRegion[x], wx = columnWeight[x];
+            const int rxNext = qMin(rx + 1, regionColumns - 1);
+            const uchar* c00 = curve(rx, ry);
+            const uchar* c10 = curve(rxNext, ry);
+            const uchar* c01 = curve(rx, ryNext);
+            const uchar* c11 = curve(rxNext, ryNext);
+            const auto map = [&](int value) {
+                const int v = levels[value];
+                const int top = c00[v] * (256 - wx) + c10[v] * wx;
+                const int bottom = c01[v] * (256 - wx) + c11[v] * wx;
+                return (top * (256 - wy) + bottom * wy + 32768) >> 16;
+            };
+            const QRgb p = row[x];
+            row[x] = qRgb(map(qRed(p)), map(qGreen(p)), map(qBlue(p)));
+        }
+    }
+}
+
+QImage ImageEnhancer::tile(int level, const QRect& rect) const {
+    // The blur reaches this far past the tile, those pixels are read but not returned
+    const int radius = params.sharpenAmount > 0 ? qBound(1, params.sharpenRadius, MaxSharpenRadius) : 0;
+    const QRect padded = rect.adjusted(-radius, -radius, radius, radius)
+                             .intersected(QRect(QPoint(0, 0), source->levelSize(level)));
+    QImage image = source->tile(level, padded).convertToFormat(QImage::Format_RGB32);
+    if (image.isNull()) return image;
+
+    if (params.black > 0 || params.white < 255 || params.gamma != 1.0 || params.claheClip > 0) {
+        applyCurves(image, level, padded.topLeft());
+    }
+    if (radius == 0) return image;
+    return sharpen(image, radius, params.sharpenAmount).copy(rect.translated(-padded.topLeft()));
+}
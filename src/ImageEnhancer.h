@@ -0,0 +1,63 @@
+#ifndef IMAGEENHANCER_H
+#define IMAGEENHANCER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QRect>
+#include <memory>
+#include "ImageSource.h"
+
+// Display adjustments of the image; the defaults leave it as it is
+struct EnhanceSettings {
+    int black = 0;             // input level shown as black
+    int white = 255;           // input level shown as white
+    double gamma = 1.0;        // applied between black and white, > 1 brightens
+    double claheClip = 0;      // CLAHE contrast limit in multiples of the mean histogram bin, 0 for off
+    double sharpenAmount = 0;  // unsharp mask strength 0..4, 0 for off
+    int sharpenRadius = 2;     // box blur radius 1..8, in pixels of the shown pyramid level
+
+    bool isIdentity() const;
+    bool operator==(const EnhanceSettings& other) const;
+    bool operator!=(const EnhanceSettings& other) const { return !(*this == other); }
+};
+
+size_t qHash(const EnhanceSettings& settings, size_t seed = 0);
+
+// Enhanced pixels of an ImageSource for display: levels and gamma through a
+// lookup table, then CLAHE, then an unsharp mask. One instance holds one set
+// of settings. The source is never modified, measurements and edge snapping
+// keep reading the original pixels.
+//
+// CLAHE works on context regions of RegionSize full resolution pixels. Their
+// curves come from the histogram of a coarse pyramid level and are cached,
+// so a tile at any zoom level only needs the curves of the regions around
+// it and tiles join without seams.
+class ImageEnhancer {
+public:
+    static constexpr int RegionSize = 1024;
+
+    ImageEnhancer(std::shared_ptr<ImageSource> source, const EnhanceSettings& settings);
+
+    const EnhanceSettings& settings() const { return params; }
+    // Pixels of rect (coordinates of level) as RGB32; may be called from several threads at once
+    QImage tile(int level, const QRect& rect) const;
+
+private:
+    // Levels, gamma and CLAHE of image, whose top left pixel is origin at level
+    void applyCurves(QImage& image, int level, const QPoint& origin) const;
+    // CLAHE curve of region (rx, ry), 256 entries applied after the levels table
+    QByteArray regionCurve(int rx, int ry) const;
+
+    std::shared_ptr<ImageSource> source;
+    EnhanceSettings params;
+    uchar levels[256];
+    int regionColumns;
+    int regionRows;
+
+    mutable QMutex curveMutex;
+    mutable QHash<quint64, QByteArray> curves; // (ry << 32 | rx) -> curve
+};
+
+#endif // IMAGEENHANCER_H
@@ -0,0 +1,155 @@
+#include "ImageExporter.h"
+#include "MeasureGraphicsItem.h"
+#include "SpatialIndex.h"
+#include "StreamingImageWriter.h"
+#include <QPainter>
+#include <QPromise>
+#include <QStyleOptionGraphicsItem>
+#include <QtConcurrent>
+#include <algorithm>
+#include <deque>
+
+namespace {
+
+// Pixels of one band while it is painted; a few of these per thread are in flight
+const qint64 BandBytes = 16 * 1024 * 1024;
+
+struct Job {
+    std::shared_ptr<ImageSource> source;
+    QVector<ImageExporter::Annotation> annotations;
+    QVector<QRectF> bounds; // painted area of every annotation, labels included
+    SpatialIndex index{256.0};
+};
+
+// Bounds come from the same items that paint them, so nothing drawn is cut off at a band edge
+void indexAnnotations(Job& job) {
+    job.bounds.reserve(job.annotations.size());
+    for (int i = 0; i < job.annotations.size(); ++i) {
+        std::unique_ptr<MeasureGraphicsItem> item(MeasureGraphicsItem::create(job.annotations[i].record));
+        item->setLabel(job.annotations[i].label);
+        job.bounds.append(item->boundingRect());
+        job.index.insert(i, job.bounds.last());
+    }
+}
+
+// Image pixels of band with every annotation touching it on top, in the
+// writer's pixel format. Items are created per band: their paint caches
+// must not be shared between threads.
+QImage renderBand(const Job& job, const QRect& band, QImage::Format format) {
+    QImage image(band.size(), QImage::Format_RGB32);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.drawImage(0, 0, job.source->tile(0, band));
+
+    QVector<int> ids;
+    job.index.query(band, [&](int id) {
+        if (job.bounds[id].intersects(band)) ids.append(id);
+    });
+    // Stacked in the order they were measured, as in the scene
+    std::sort(ids.begin(), ids.end());
+
+    painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing);
+    painter.translate(-band.topLeft());
+    QStyleOptionGraphicsItem option;
+    option.exposedRect = band;
+    for (int id : ids) {
+        std::unique_ptr<MeasureGraphicsItem> item(MeasureGraphicsItem::create(job.annotations[id].record));
+        item->setLabel(job.annotations[id].label);
+        item->paint(&painter, &option, nullptr);
+    }
+    painter.end();
+    return image.convertToFormat(format);
+}
+
+} // namespace
+
+ImageExporter::ImageExporter(QObject* parent) : QObject(parent), watcher(nullptr) {
+}
+
+ImageExporter::~ImageExporter() {
+    if (!watcher) return;
+    QFuture<QString> running = watcher->future();
+    cancel();
+    running.waitForFinished();
+}
+
+void ImageExporter::cancel() {
+    if (!watcher) return;
+    // The export stops after the bands in flight and deletes its file
+    disconnect(watcher, nullptr, this, nullptr);
+    watcher->future().cancel();
+    watcher->deleteLater();
+    watcher = nullptr;
+}
+
+void ImageExporter::start(const QString& path, std::shared_ptr<ImageSource> source, QVector<Annotation> annotations,
+                          double pixelsPerMm) {
+    if (watcher) {
+        // Never two writers on one file
+        QFuture<QString> running = watcher->future();
+        cancel();
+        running.waitForFinished();
+    }
+    currentPath = path;
+
+    auto job = std::make_shared<Job>();
+    job->source = std::move(source);
+    job->annotations = std::move(annotations);
+    // Initialised here, not concurrently by the first bands
+    MeasureGraphicsItem::labelMetrics();
+
+    QThreadPool* pool = &bandPool;
+    QFuture<QString> future = QtConcurrent::run([path, job, pixelsPerMm, pool](QPromise<QString>& promise) {
+        const QSize size = job->source->size();
+        StreamingImageWriter writer;
+        QString error;
+        if (!writer.open(path, size, pixelsPerMm, &error)) {
+            promise.addResult(error);
+            return;
+        }
+        indexAnnotations(*job);
+
+        const int bandRows = int(qBound<qint64>(1, BandBytes / (qint64(size.width()) * 4), size.height()));
+        const int bandCount = (size.height() + bandRows - 1) / bandRows;
+        const QImage::Format format = writer.pixelFormat();
+        promise.setProgressRange(0, bandCount);
+
+        // Bands are rendered ahead of the writer, but only so far
+        const int window = 2 * pool->maxThreadCount();
+        std::deque<QFuture<QImage>> inFlight;
+        int next = 0;
+        for (int done = 0; done < bandCount; ++done) {
+            while (next < bandCount && int(inFlight.size()) < window) {
+                const QRect band(0, next * bandRows, size.width(), qMin(bandRows, size.height() - next * bandRows));
+                inFlight.push_back(QtConcurrent::run(pool, [job, band, format]() { return renderBand(*job, band, format); }));
+                ++next;
+            }
+            const QImage rows = inFlight.front().result();
+            inFlight.pop_front();
+            if (promise.isCanceled() || !writer.writeRows(rows, &error)) {
+                for (QFuture<QImage>& band : inFlight) band.waitForFinished();
+                writer.abort();
+                promise.addResult(promise.isCanceled() ? QString("已取消") : error);
+                return;
+            }
+            promise.setProgressValue(done + 1);
+        }
+        promise.addResult(writer.close(&error) ? QString() : error);
+    });
+
+    watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcherBase::progressValueChanged, this, [this](int value) {
+        emit progressChanged(value, watcher->progressMaximum());
+    });
+    connect(watcher, &QFutureWatcherBase::finished, this, [this]() {
+        const QString error = watcher->future().resultCount() > 0 ? watcher->result() : QString("导出中断");
+        watcher->deleteLater();
+        watcher = nullptr;
+        if (error.isEmpty()) {
+            emit finished(currentPath);
+        } else {
+            emit failed(currentPath, error);
+        }
+    });
+    watcher->setFuture(future);
+}
@@ -0,0 +1,48 @@
+#ifndef IMAGEEXPORTER_H
+#define IMAGEEXPORTER_H
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <memory>
+#include "ImageSource.h"
+#include "MeasureRecord.h"
+
+// Renders an image with its measurements at full resolution into a TIFF or
+// BMP file (see StreamingImageWriter). The image is cut into horizontal
+// bands that are painted on a thread pool, each into its own QImage, and
+// handed to the writer in order as they finish. Only a few bands are in
+// flight at once, so memory stays a small multiple of one band however
+// large the image is.
+class ImageExporter : public QObject {
+    Q_OBJECT
+
+public:
+    struct Annotation {
+        MeasureRecord record;
+        QString label;
+    };
+
+    ImageExporter(QObject* parent = nullptr);
+    ~ImageExporter(); // waits for a running export to remove its partial file
+
+    // Cancels an export that is still running; pixelsPerMm goes into the file
+    void start(const QString& path, std::shared_ptr<ImageSource> source, QVector<Annotation> annotations,
+               double pixelsPerMm);
+    void cancel();
+    bool isRunning() const { return watcher != nullptr; }
+
+signals:
+    void progressChanged(int bandsDone, int bandCount);
+    void finished(const QString& path);
+    void failed(const QString& path, const QString& error);
+
+private:
+    QFutureWatcher<QString>* watcher; // result: empty on success, else the error
+    QString currentPath;
+    QThreadPool bandPool;
+};
+
+#endif // IMAGEEXPORTER_H
@@ -0,0 +1,98 @@
+#include "ImageLoader.h"
+#include "TiledImageItem.h"
+#include <QImageReader>
+#include <QPromise>
+#include <QtConcurrent>
+
+// Long side of the quick preview, in pixels
+static constexpr int PreviewSize = 2048;
+// Largest decoded image, in MB
+static constexpr int MaxDecodeMegabytes = 400 * 4;
+
+ImageLoader::ImageLoader(QObject* parent) : QObject(parent), watcher(nullptr) {
+    // Stitched inspection images are far beyond Qt's default 256 MB limit;
+    // still refuse anything beyond 400 megapixels at 4 bytes each
+    QImageReader::setAllocationLimit(MaxDecodeMegabytes);
+}
+
+ImageLoader::~ImageLoader() {
+    cancel();
+}
+
+void ImageLoader::cancel() {
+    if (!watcher) return;
+    // Results of the old load must never reach the scene, even if already queued
+    disconnect(watcher, nullptr, this, nullptr);
+    watcher->future().cancel();
+    watcher->deleteLater();
+    watcher = nullptr;
+}
+
+void ImageLoader::load(const QString& path) {
+    cancel();
+    currentPath = path;
+
+    QFuture<Result> future = QtConcurrent::run([path](QPromise<Result>& promise) {
+        QImageReader probe(path);
+        const QSize fullSize = probe.size();
+        const QByteArray format = probe.format();
+
+        // Only JPEG decodes a scaled image faster than a full one
+        if ((format == "jpeg" || format == "jpg") && fullSize.isValid()
+            && qMax(fullSize.width(), fullSize.height()) > PreviewSize) {
+            probe.setAutoTransform(true);
+            probe.setScaledSize(fullSize.scaled(PreviewSize, PreviewSize, Qt::KeepAspectRatio));
+            QImage preview = probe.read();
+            if (!preview.isNull()) {
+                // size() reports the stored orientation, the decoded image is already rotated
+                QSize shownSize = fullSize;
+                if (probe.transformation() & QImageIOHandler::TransformationRotate90) {
+                    shownSize.transpose();
+                }
+                auto source = std::make_shared<PyramidImageSource>(preview, TiledImageItem::TileSize);
+                promise.addResult(Result{source, shownSize, true, QString()});
+            }
+        }
+        if (promise.isCanceled()) return;
+
+        QImageReader reader(path);
+        reader.setAutoTransform(true);
+        QImage image = reader.read();
+        if (promise.isCanceled()) return;
+        if (image.isNull()) {
+            promise.addResult(Result{nullptr, QSize(), false, reader.errorString()});
+            return;
+        }
+
+        auto source = std::make_shared<PyramidImageSource>(image, TiledImageItem::TileSize);
+        image = QImage();
+        if (promise.isCanceled()) return;
+        promise.addResult(Result{source, source->size(), false, QString()});
+    });
+
+    watcher = new QFutureWatcher<Result>(this);
+    QFutureWatcher<Result>* current = watcher;
+    connect(watcher, &QFutureWatcherBase::resultReadyAt, this, [this, current](int index) {
+        onResultReady(current, index);
+    });
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, current]() {
+        if (watcher == current) {
+            watcher->deleteLater();
+            watcher = nullptr;
+        }
+    });
+    watcher->setFuture(future);
+}
+
+void ImageLoader::onResultReady(QFutureWatcher<Result>* from, int index) {
+    if (from != watcher) return;
+
+    const Result result = from->future().resultAt(index);
+    if (!result.source) {
+        emit loadFailed(currentPath, result.error);
+    } else if (result.preview) {
+        emit previewReady(result.source, result.fullSize);
+    } else {
+        emit imageReady(result.source, currentPath);
+    }
+}
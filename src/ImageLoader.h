@@ -0,0 +1,45 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <memory>
+#include "ImageSource.h"
+
+// Decodes an image file on the thread pool. For JPEG a reduced-size preview is
+// decoded first (DCT scaling through QImageReader::setScaledSize) so something
+// can be shown long before the full-resolution pyramid is ready.
+class ImageLoader : public QObject {
+    Q_OBJECT
+
+public:
+    ImageLoader(QObject* parent = nullptr);
+    ~ImageLoader();
+
+    void load(const QString& path); // cancels a load that is still running
+    void cancel();
+    bool isLoading() const { return watcher != nullptr; }
+
+signals:
+    void previewReady(std::shared_ptr<ImageSource> preview, const QSize& fullSize);
+    void imageReady(std::shared_ptr<ImageSource> source, const QString& path);
+    void loadFailed(const QString& path, const QString& error);
+
+private:
+    struct Result {
+        std::shared_ptr<ImageSource> source; // null on failure
+        QSize fullSize;
+        bool preview;
+        QString error;
+    };
+
+    void onResultReady(QFutureWatcher<Result>* from, int index);
+
+    QFutureWatcher<Result>* watcher;
+    QString currentPath;
+};
+
+#endif // IMAGELOADER_H
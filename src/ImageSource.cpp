@@ -0,0 +1,71 @@
+#include "ImageSource.h"
+#include <QDir>
+
+QSize ImageSource::levelSize(int level) const {
+    QSize s = size();
+    for (int i = 0; i < level; ++i) {
+        s = QSize((s.width() + 1) / 2, (s.height() + 1) / 2);
+    }
+    return s;
+}
+
+int ImageSource::levelCountFor(const QSize& size, int tileSize) {
+    int count = 1;
+    QSize s = size;
+    while (s.width() > tileSize || s.height() > tileSize) {
+        s = QSize((s.width() + 1) / 2, (s.height() + 1) / 2);
+        ++count;
+    }
+    return count;
+}
+
+PyramidImageSource::PyramidImageSource(const QImage& image, int tileSize) {
+    if (image.isNull()) return;
+
+    // Keep grayscale captures at 1 byte per pixel, everything else in the format
+    // QPixmap::fromImage converts fastest
+    QImage base = image;
+    if (base.format() != QImage::Format_Grayscale8 && base.format() != QImage::Format_RGB32
+        && base.format() != QImage::Format_ARGB32_Premultiplied) {
+        base = base.convertToFormat(base.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                           : QImage::Format_RGB32);
+    }
+    levels.append(base);
+
+    const int count = levelCountFor(base.size(), tileSize);
+    for (int i = 1; i < count; ++i) {
+        const QImage& prev = levels.last();
+        QSize next((prev.width() + 1) / 2, (prev.height() + 1) / 2);
+        levels.append(prev.scaled(next, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    }
+    if (base.sizeInBytes() >= SpillBytes) {
+        base = QImage();
+        spill();
+    }
+}
+
+void PyramidImageSource::spill() {
+    auto file = std::make_unique<QTemporaryFile>(QDir::temp().filePath("MeasureTool-XXXXXX.pyramid"));
+    if (!file->open()) return;
+    QVector<qint64> offsets;
+    for (const QImage& level : levels) {
+        offsets.append(file->pos());
+        const qint64 bytes = level.sizeInBytes();
+        if (file->write(reinterpret_cast<const char*>(level.constBits()), bytes) != bytes) return;
+    }
+    if (!file->flush()) return;
+    const uchar* data = file->map(0, file->size());
+    if (!data) return;
+
+    // Rows keep their stride, every level starts 4-byte aligned in the file
+    for (int i = 0; i < levels.size(); ++i) {
+        const QImage& level = levels[i];
+        levels[i] = QImage(data + offsets[i], level.width(), level.height(), level.bytesPerLine(), level.format());
+    }
+    spillFile = std::move(file);
+}
+
+QImage PyramidImageSource::tile(int level, const QRect& rect) const {
+    if (level < 0 || level >= levels.size()) return QImage();
+    return levels[level].copy(rect);
+}
@@ -0,0 +1,53 @@
+#ifndef IMAGESOURCE_H
+#define IMAGESOURCE_H
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QTemporaryFile>
+#include <QVector>
+#include <memory>
+
+// Read-only access to the pixels of a (possibly huge) image, organised as a
+// power-of-two pyramid. Level 0 is full resolution, level n is 1/2^n.
+class ImageSource {
+public:
+    virtual ~ImageSource() = default;
+
+    virtual QSize size() const = 0;
+    virtual int levelCount() const = 0;
+    // Returns the pixels of `rect` (in coordinates of `level`)
+    virtual QImage tile(int level, const QRect& rect) const = 0;
+
+    QSize levelSize(int level) const;
+
+    // Number of levels needed until the coarsest one fits in a single tile
+    static int levelCountFor(const QSize& size, int tileSize);
+};
+
+// Source backed by a decoded QImage, with the coarser levels built up front.
+// The pyramid of a large image is moved into a temporary file and mapped
+// back, so only the pages of the tiles in use stay resident and the decoded
+// pixels do not hold memory for the lifetime of the image. Decoding itself
+// still needs the whole image in memory once.
+class PyramidImageSource : public ImageSource {
+public:
+    // Pyramids from this size on are moved to a file
+    static constexpr qint64 SpillBytes = 64 * 1024 * 1024;
+
+    PyramidImageSource(const QImage& image, int tileSize);
+
+    QSize size() const override { return levels.isEmpty() ? QSize() : levels.first().size(); }
+    int levelCount() const override { return levels.size(); }
+    QImage tile(int level, const QRect& rect) const override;
+
+private:
+    // Writes the levels to spillFile and replaces them by views of its
+    // mapping; keeps them in memory if the file cannot be written
+    void spill();
+
+    std::unique_ptr<QTemporaryFile> spillFile; // declared first, outlives the views in levels
+    QVector<QImage> levels;
+};
+
+#endif // IMAGESOURCE_H
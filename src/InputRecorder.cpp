@@ -0,0 +1,165 @@
+#include "InputRecorder.h"
+#include "CanvasView.h"
+#include "PerfHud.h"
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMouseEvent>
+#include <QScrollBar>
+#include <QWheelEvent>
+
+InputRecorder::InputRecorder(CanvasView* view, CanvasScene* scene, QObject* parent)
+    : QObject(parent), view(view), scene(scene), startNs(0), interactiveProfile(false) {
+}
+
+bool InputRecorder::start(const QString& path, QString* error) {
+    stop();
+
+    // Replays start from the scene as it is now
+    const QString project = path + ".mproj";
+    if (!scene->saveProject(project)) {
+        if (error) *error = "无法保存场景: " + project;
+        return false;
+    }
+    log.setFileName(path);
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (error) *error = log.errorString();
+        return false;
+    }
+
+    const QTransform t = view->transform();
+    const QJsonObject viewState{
+        {"width", view->width()},
+        {"height", view->height()},
+        {"transform", QJsonArray{t.m11(), t.m12(), t.m21(), t.m22(), t.dx(), t.dy()}},
+        {"scroll", QJsonArray{view->horizontalScrollBar()->value(), view->verticalScrollBar()->value()}}};
+    const QJsonObject header{{"format", "measure-input"},
+                             {"version", Version},
+                             {"project", QFileInfo(project).fileName()},
+                             {"mode", int(scene->mode())},
+                             {"snap", scene->edgeSnapping()},
+                             {"batched", scene->batchedRendering()},
+                             {"interactive", interactiveProfile},
+                             {"enhance", enhancementToJson(scene->enhancement())},
+                             {"view", viewState}};
+    log.write(QJsonDocument(header).toJson(QJsonDocument::Compact));
+    log.write("\n");
+
+    startNs = PerfHud::now();
+    view->viewport()->installEventFilter(this);
+    return true;
+}
+
+void InputRecorder::stop() {
+    if (!log.isOpen()) return;
+    view->viewport()->removeEventFilter(this);
+    log.close();
+}
+
+void InputRecorder::write(const char* type, QJsonObject fields) {
+    if (!log.isOpen()) return;
+    fields.insert("t", double(PerfHud::now() - startNs));
+    fields.insert("e", type);
+    log.write(QJsonDocument(fields).toJson(QJsonDocument::Compact));
+    log.write("\n");
+}
+
+void InputRecorder::recordMode(ToolMode mode) {
+    write("mode", {{"mode", int(mode)}});
+}
+
+void InputRecorder::recordScale(double pxPerMm) {
+    write("scale", {{"value", pxPerMm}});
+}
+
+void InputRecorder::recordEdgeSnapping(bool enabled) {
+    write("snap", {{"on", enabled}});
+}
+
+void InputRecorder::recordBatchedRendering(bool enabled) {
+    write("batched", {{"on", enabled}});
+}
+
+void InputRecorder::recordClear() {
+    write("clear");
+}
+
+void InputRecorder::recordUndo() {
+    write("undo");
+}
+
+void InputRecorder::recordRedo() {
+    write("redo");
+}
+
+void InputRecorder::recordDetection() {
+    write("detect");
+}
+
+void InputRecorder::recordEnhancement(const EnhanceSettings& settings) {
+    write("enhance", enhancementToJson(settings));
+}
+
+void InputRecorder::recordRenderProfile(bool interactive) {
+    interactiveProfile = interactive;
+    write("profile", {{"interactive", interactive}});
+}
+
+QJsonObject InputRecorder::enhancementToJson(const EnhanceSettings& settings) {
+    return {{"black", settings.black},
+            {"white", settings.white},
+            {"gamma", settings.gamma},
+            {"clahe", settings.claheClip},
+            {"amount", settings.sharpenAmount},
+            {"radius", settings.sharpenRadius}};
+}
+
+EnhanceSettings InputRecorder::enhancementFromJson(const QJsonObject& object) {
+    EnhanceSettings settings;
+    settings.black = object.value("black").toInt(settings.black);
+    settings.white = object.value("white").toInt(settings.white);
+    settings.gamma = object.value("gamma").toDouble(settings.gamma);
+    settings.claheClip = object.value("clahe").toDouble(settings.claheClip);
+    settings.sharpenAmount = object.value("amount").toDouble(settings.sharpenAmount);
+    settings.sharpenRadius = object.value("radius").toInt(settings.sharpenRadius);
+    return settings;
+}
+
+bool InputRecorder::eventFilter(QObject* watched, QEvent* event) {
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseMove:
+    case QEvent::MouseButtonRelease: {
+        const auto* mouse = static_cast<QMouseEvent*>(event);
+        const char* type = event->type() == QEvent::MouseButtonPress      ? "press"
+                           : event->type() == QEvent::MouseButtonDblClick ? "dblclick"
+                           : event->type() == QEvent::MouseMove           ? "move"
+                                                                          : "release";
+        write(type, {{"x", mouse->position().x()},
+                     {"y", mouse->position().y()},
+                     {"button", int(mouse->button())},
+                     {"buttons", int(mouse->buttons())},
+                     {"mods", int(mouse->modifiers())}});
+        break;
+    }
+    case QEvent::Wheel: {
+        const auto* wheel = static_cast<QWheelEvent*>(event);
+        write("wheel", {{"x", wheel->position().x()},
+                        {"y", wheel->position().y()},
+                        {"dx", wheel->angleDelta().x()},
+                        {"dy", wheel->angleDelta().y()},
+                        {"px", wheel->pixelDelta().x()},
+                        {"py", wheel->pixelDelta().y()},
+                        {"buttons", int(wheel->buttons())},
+                        {"mods", int(wheel->modifiers())}});
+        break;
+    }
+    case QEvent::Resize:
+        write("resize", {{"width", view->width()}, {"height", view->height()}});
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
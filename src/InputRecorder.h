@@ -0,0 +1,63 @@
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <QFile>
+#include <QJsonObject>
+#include <QObject>
+#include "CanvasScene.h"
+
+class CanvasView;
+
+// Logs the input going into a CanvasView and its scene so a session can be
+// replayed offscreen (see MeasureReplay). The log is JSON Lines:
+//   header  {"format": "measure-input", "version", "project", "mode", "snap",
+//            "batched", "interactive", "enhance",
+//            "view": {"width", "height", "transform", "scroll"}}
+//   events  {"t": ns since start, "e": "press" | "move" | "release" | "wheel" |
+//            "resize" | "mode" | "scale" | "snap" | "batched" | "clear" | "undo" |
+//            "redo" | "detect" | "profile" | "enhance", ...}
+// The scene as it was when recording started is saved next to the log as a
+// project ("<log>.mproj") and referenced by the header. Loading another image
+// or project cannot be replayed from it; the window stops recording first.
+class InputRecorder : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int Version = 2;
+
+    InputRecorder(CanvasView* view, CanvasScene* scene, QObject* parent = nullptr);
+
+    bool start(const QString& path, QString* error = nullptr);
+    void stop();
+    bool isRecording() const { return log.isOpen(); }
+
+    // Changes made through the window rather than the canvas; no-ops while not recording
+    void recordMode(ToolMode mode);
+    void recordScale(double pxPerMm);
+    void recordEdgeSnapping(bool enabled);
+    void recordBatchedRendering(bool enabled);
+    void recordClear();
+    void recordUndo();
+    void recordRedo();
+    void recordDetection();
+    void recordEnhancement(const EnhanceSettings& settings);
+    // Kept while not recording too, for the header of the next log
+    void recordRenderProfile(bool interactive);
+
+    static QJsonObject enhancementToJson(const EnhanceSettings& settings);
+    static EnhanceSettings enhancementFromJson(const QJsonObject& object);
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+    void write(const char* type, QJsonObject fields = QJsonObject());
+
+    CanvasView* view;
+    CanvasScene* scene;
+    QFile log;
+    qint64 startNs;
+    bool interactiveProfile;
+};
+
+#endif // INPUTRECORDER_H
@@ -0,0 +1,111 @@
+#include "LoupeWidget.h"
+#include <QPainter>
+#include <QWheelEvent>
+#include <QtMath>
+
+namespace {
+
+// The cached patch spans this many times the visible one in each direction,
+// so small moves are served from it
+const int PatchScale = 3;
+// Crosshair arms stop this far from the centre to leave the pixel visible
+const int CrossGap = 4;
+
+} // namespace
+
+LoupeWidget::LoupeWidget(QWidget* parent)
+    : QWidget(parent), hasPosition(false), magnification(8) {
+    // Every pixel is painted, nothing underneath needs to be drawn first
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumSize(120, 120);
+}
+
+QSize LoupeWidget::sizeHint() const {
+    return QSize(240, 240);
+}
+
+void LoupeWidget::setSource(std::shared_ptr<ImageSource> source) {
+    this->source = std::move(source);
+    patch = QImage();
+    patchRect = QRect();
+    update();
+}
+
+void LoupeWidget::setZoom(int zoom) {
+    zoom = qBound(int(MinZoom), zoom, int(MaxZoom));
+    if (zoom == magnification) return;
+    magnification = zoom;
+    update();
+}
+
+void LoupeWidget::setPosition(const QPointF& pos) {
+    position = pos;
+    hasPosition = true;
+    // Hidden in a closed dock, skip even the patch lookup
+    if (isVisible()) update();
+}
+
+QRect LoupeWidget::visibleRect() const {
+    // One extra pixel on each side for the fractional offset of the cursor
+    const double halfW = 0.5 * width() / magnification, halfH = 0.5 * height() / magnification;
+    const QPoint topLeft(qFloor(position.x() - halfW), qFloor(position.y() - halfH));
+    const QPoint bottomRight(qCeil(position.x() + halfW), qCeil(position.y() + halfH));
+    return QRect(topLeft, bottomRight);
+}
+
+void LoupeWidget::ensurePatch(const QRect& rect) {
+    const QRect bounds(QPoint(0, 0), source->size());
+    const QRect needed = rect.intersected(bounds);
+    if (needed.isEmpty() || patchRect.contains(needed)) return;
+    const int marginX = rect.width() * (PatchScale - 1) / 2, marginY = rect.height() * (PatchScale - 1) / 2;
+    patchRect = rect.adjusted(-marginX, -marginY, marginX, marginY).intersected(bounds);
+    patch = source->tile(0, patchRect).convertToFormat(QImage::Format_RGB32);
+    if (patch.isNull()) patchRect = QRect();
+}
+
+void LoupeWidget::paintEvent(QPaintEvent* event) {
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::darkGray);
+    if (!source || !hasPosition) return;
+
+    const QRect visible = visibleRect();
+    ensurePatch(visible);
+    const QRect shown = visible.intersected(patchRect);
+    if (!shown.isEmpty()) {
+        // The cursor lands on the widget centre; whole pixels, no filtering
+        const QPointF origin = position - QPointF(0.5 * width(), 0.5 * height()) / magnification;
+        const QRectF target((shown.left() - origin.x()) * magnification, (shown.top() - origin.y()) * magnification,
+                            shown.width() * magnification, shown.height() * magnification);
+        painter.drawImage(target, patch, QRectF(shown.translated(-patchRect.topLeft())));
+
+        // Outline of the pixel under the cursor
+        const QPointF pixel((qFloor(position.x()) - origin.x()) * magnification,
+                            (qFloor(position.y()) - origin.y()) * magnification);
+        painter.setPen(QPen(QColor(255, 255, 0, 160), 1));
+        painter.drawRect(QRectF(pixel, QSizeF(magnification, magnification)));
+    }
+
+    const QPointF c(0.5 * width(), 0.5 * height());
+    painter.setPen(QPen(Qt::red, 1));
+    painter.drawLine(QPointF(0, c.y()), QPointF(c.x() - CrossGap, c.y()));
+    painter.drawLine(QPointF(c.x() + CrossGap, c.y()), QPointF(width(), c.y()));
+    painter.drawLine(QPointF(c.x(), 0), QPointF(c.x(), c.y() - CrossGap));
+    painter.drawLine(QPointF(c.x(), c.y() + CrossGap), QPointF(c.x(), height()));
+
+    painter.setPen(Qt::white);
+    painter.drawText(rect().adjusted(4, 0, -4, -4), Qt::AlignLeft | Qt::AlignBottom,
+                     QString("%1, %2  ×%3").arg(position.x(), 0, 'f', 1).arg(position.y(), 0, 'f', 1).arg(magnification));
+}
+
+void LoupeWidget::wheelEvent(QWheelEvent* event) {
+    const int steps = event->angleDelta().y() / 120;
+    if (steps != 0) setZoom(magnification + 2 * steps);
+    event->accept();
+}
+
+void LoupeWidget::resizeEvent(QResizeEvent* event) {
+    // The patch was sized for the old widget
+    patchRect = QRect();
+    QWidget::resizeEvent(event);
+}
@@ -0,0 +1,55 @@
+#ifndef LOUPEWIDGET_H
+#define LOUPEWIDGET_H
+
+#include <QImage>
+#include <QPointF>
+#include <QRect>
+#include <QWidget>
+#include <memory>
+#include "ImageSource.h"
+
+// Magnified, pixel-exact patch of the image around the cursor with a
+// crosshair on the exact cursor position. Pixels come straight from the
+// full resolution level of the ImageSource and are scaled nearest-neighbour;
+// a patch a few times larger than what is shown is kept, so following the
+// cursor normally only repaints this widget from memory.
+class LoupeWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    static constexpr int MinZoom = 4;
+    static constexpr int MaxZoom = 16;
+
+    LoupeWidget(QWidget* parent = nullptr);
+
+    void setSource(std::shared_ptr<ImageSource> source);
+    // Screen pixels per image pixel, MinZoom..MaxZoom; the mouse wheel over the loupe changes it too
+    void setZoom(int zoom);
+    int zoom() const { return magnification; }
+
+    QSize sizeHint() const override;
+
+public slots:
+    // Image (= scene) coordinates of the cursor
+    void setPosition(const QPointF& pos);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    // Image pixels under the widget for the current position and zoom
+    QRect visibleRect() const;
+    // Refetches the patch if it does not cover rect
+    void ensurePatch(const QRect& rect);
+
+    std::shared_ptr<ImageSource> source;
+    QPointF position;
+    bool hasPosition;
+    int magnification;
+    QImage patch;    // RGB32, cached pixels of patchRect
+    QRect patchRect; // image coordinates
+};
+
+#endif // LOUPEWIDGET_H
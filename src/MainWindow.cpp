@@ -5,21 +5,71 @@
 #include <QVBoxLayout>
 #include <QStatusBar>
 #include <QActionGroup>
+#include <QFileInfo>
+#include <QUndoStack>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), scene(new CanvasScene(this)) {
     
     view = new CanvasView(scene);
     setCentralWidget(view);
+    recorder = new InputRecorder(view, scene, this);
+
+    // Magnified pixels under the cursor, repainted on its own without the view
+    loupe = new LoupeWidget();
+    loupeDock = new QDockWidget("放大镜", this);
+    loupeDock->setObjectName("loupeDock");
+    loupeDock->setWidget(loupe);
+    addDockWidget(Qt::RightDockWidgetArea, loupeDock);
+    loupeDock->hide();
+    connect(view, &CanvasView::cursorMoved, loupe, &LoupeWidget::setPosition);
+    connect(scene, &CanvasScene::imageLoaded, this, [this]() { loupe->setSource(scene->imageSource()); });
+    // Nothing rather than the old pixels while a new image decodes or after a failed load
+    connect(scene, &CanvasScene::imageCleared, this, [this]() { loupe->setSource(nullptr); });
+
+    // Display only, the loupe keeps showing the original pixels
+    enhancePanel = new EnhancePanel();
+    enhanceDock = new QDockWidget("图像增强", this);
+    enhanceDock->setObjectName("enhanceDock");
+    enhanceDock->setWidget(enhancePanel);
+    addDockWidget(Qt::RightDockWidgetArea, enhanceDock);
+    enhanceDock->hide();
+    connect(enhancePanel, &EnhancePanel::settingsChanged, scene, &CanvasScene::setEnhancement);
+    connect(enhancePanel, &EnhancePanel::settingsChanged, recorder, &InputRecorder::recordEnhancement);
     
     createActions();
     createToolbar();
 
     statusLabel = new QLabel("就绪");
     statusBar()->addWidget(statusLabel);
+    frameTimeLabel = new QLabel();
+    statusBar()->addPermanentWidget(frameTimeLabel);
+    connect(view, &CanvasView::frameTimeChanged, this, &MainWindow::onFrameTime);
 
     connect(scene, &CanvasScene::messageChanged, this, &MainWindow::updateStatus);
     connect(scene, &CanvasScene::modeChanged, this, &MainWindow::onModeChanged);
+
+    exportProgress = new QProgressDialog("正在导出标注图...", "取消", 0, 0, this);
+    exportProgress->setWindowModality(Qt::WindowModal);
+    exportProgress->setMinimumDuration(500);
+    exportProgress->reset();
+    connect(exportProgress, &QProgressDialog::canceled, scene, &CanvasScene::cancelExport);
+    connect(scene, &CanvasScene::exportProgress, this, [this](int done, int total) {
+        exportProgress->setMaximum(total);
+        exportProgress->setValue(done);
+    });
+    connect(scene, &CanvasScene::exportFinished, exportProgress, &QProgressDialog::reset);
+
+    detectProgress = new QProgressDialog("正在自动识别直线和圆弧...", "取消", 0, 0, this);
+    detectProgress->setWindowModality(Qt::WindowModal);
+    detectProgress->setMinimumDuration(500);
+    detectProgress->reset();
+    connect(detectProgress, &QProgressDialog::canceled, scene, &CanvasScene::cancelDetection);
+    connect(scene, &CanvasScene::detectionProgress, this, [this](int done, int total) {
+        detectProgress->setMaximum(total);
+        detectProgress->setValue(done);
+    });
+    connect(scene, &CanvasScene::detectionFinished, detectProgress, &QProgressDialog::reset);
     
     resize(1024, 768);
     setWindowTitle("测量工具");
@@ -32,6 +82,20 @@ void MainWindow::createActions() {
     actionImport = new QAction("导入图片", this);
     connect(actionImport, &QAction::triggered, this, &MainWindow::onImportImage);
 
+    actionOpenProject = new QAction("打开项目", this);
+    connect(actionOpenProject, &QAction::triggered, this, &MainWindow::onOpenProject);
+
+    actionSaveProject = new QAction("保存项目", this);
+    connect(actionSaveProject, &QAction::triggered, this, &MainWindow::onSaveProject);
+
+    actionExportImage = new QAction("导出标注图", this);
+    actionExportImage->setToolTip("按原始分辨率导出带测量标注的图片 (TIFF/BMP)");
+    connect(actionExportImage, &QAction::triggered, this, &MainWindow::onExportImage);
+
+    actionDetect = new QAction("自动识别", this);
+    actionDetect->setToolTip("在整张图片中识别直线和圆弧并添加为测量, 可撤销");
+    connect(actionDetect, &QAction::triggered, this, &MainWindow::onDetectFeatures);
+
     actionSetScale = new QAction("设置比例尺", this);
     connect(actionSetScale, &QAction::triggered, this, &MainWindow::onSetScale);
 
@@ -50,7 +114,41 @@ void MainWindow::createActions() {
     actionDistance = new QAction("点线距离", this);
     actionDistance->setCheckable(true);
     connect(actionDistance, &QAction::triggered, this, &MainWindow::onModeDistance);
+
+    actionArcFit = new QAction("拟合圆弧", this);
+    actionArcFit->setCheckable(true);
+    connect(actionArcFit, &QAction::triggered, this, &MainWindow::onModeArcFit);
+
+    actionDelete = new QAction("删除测量", this);
+    actionDelete->setCheckable(true);
+    connect(actionDelete, &QAction::triggered, this, &MainWindow::onModeDelete);
+
+    actionUndo = scene->undoStack()->createUndoAction(this, "撤销");
+    actionUndo->setShortcut(QKeySequence::Undo);
+    connect(actionUndo, &QAction::triggered, recorder, &InputRecorder::recordUndo);
+
+    actionRedo = scene->undoStack()->createRedoAction(this, "重做");
+    actionRedo->setShortcut(QKeySequence::Redo);
+    connect(actionRedo, &QAction::triggered, recorder, &InputRecorder::recordRedo);
     
+    actionSnap = new QAction("边缘吸附", this);
+    actionSnap->setCheckable(true);
+    connect(actionSnap, &QAction::toggled, this, &MainWindow::onEdgeSnapToggled);
+
+    actionBatched = new QAction("批量绘制", this);
+    actionBatched->setCheckable(true);
+    connect(actionBatched, &QAction::toggled, this, &MainWindow::onBatchedToggled);
+
+    actionHud = new QAction("性能面板", this);
+    actionHud->setCheckable(true);
+    actionHud->setShortcut(Qt::Key_F12);
+    connect(actionHud, &QAction::toggled, this, &MainWindow::onHudToggled);
+
+    actionRecord = new QAction("录制操作", this);
+    actionRecord->setCheckable(true);
+    actionRecord->setToolTip("把画布上的操作录制为日志, 用 MeasureReplay 离屏回放并统计延迟");
+    connect(actionRecord, &QAction::toggled, this, &MainWindow::onRecordToggled);
+
     actionClear = new QAction("清除所有", this);
     connect(actionClear, &QAction::triggered, this, &MainWindow::onClear);
     
@@ -60,27 +158,111 @@ void MainWindow::createActions() {
     modeGroup->addAction(actionArc);
     modeGroup->addAction(actionAngle);
     modeGroup->addAction(actionDistance);
+    modeGroup->addAction(actionArcFit);
+    modeGroup->addAction(actionDelete);
     actionLine->setChecked(false);
 }
 
 void MainWindow::createToolbar() {
     QToolBar* toolbar = addToolBar("工具栏");
     toolbar->addAction(actionImport);
+    toolbar->addAction(actionOpenProject);
+    toolbar->addAction(actionSaveProject);
+    toolbar->addAction(actionExportImage);
+    toolbar->addAction(actionDetect);
     toolbar->addAction(actionSetScale);
     toolbar->addSeparator();
     toolbar->addAction(actionLine);
     toolbar->addAction(actionArc);
     toolbar->addAction(actionAngle);
     toolbar->addAction(actionDistance);
+    toolbar->addAction(actionArcFit);
+    toolbar->addAction(actionDelete);
     toolbar->addSeparator();
+    toolbar->addAction(actionUndo);
+    toolbar->addAction(actionRedo);
+    toolbar->addSeparator();
+    toolbar->addAction(actionSnap);
+    toolbar->addAction(actionBatched);
+    renderProfile = new QComboBox();
+    renderProfile->addItem("画质优先");
+    renderProfile->addItem("流畅优先");
+    renderProfile->setToolTip("画质优先: 始终抗锯齿, 图片按原始像素显示\n流畅优先: 缩放平移时关闭抗锯齿、缓存已绘制的图片，停下后恢复");
+    connect(renderProfile, &QComboBox::currentIndexChanged, this, &MainWindow::onRenderProfileChanged);
+    toolbar->addWidget(renderProfile);
+    toolbar->addAction(actionHud);
+    toolbar->addAction(loupeDock->toggleViewAction());
+    toolbar->addAction(enhanceDock->toggleViewAction());
+    toolbar->addAction(actionRecord);
     toolbar->addAction(actionClear);
 }
 
 void MainWindow::onImportImage() {
-    QString path = QFileDialog::getOpenFileName(this, "打开图片", "", "图片文件 (*.png *.jpg *.jpeg *.bmp)");
-    if (!path.isEmpty()) {
+    QString path = QFileDialog::getOpenFileName(this, "打开图片", "", "图片文件 (*.png *.jpg *.jpeg *.bmp *.raw)");
+    if (path.isEmpty()) {
+        return;
+    }
+    if (!path.endsWith(".raw", Qt::CaseInsensitive)) {
+        stopRecording();
         scene->loadImage(path);
-        updateStatus("图片已加载: " + path);
+        return;
+    }
+
+    // Raw dumps carry no header: ask for the row width and depth, the height follows from the file size
+    bool ok;
+    int width = QInputDialog::getInt(this, "原始图像", "图像宽度 (像素):", 4096, 1, 1 << 20, 1, &ok);
+    if (!ok) return;
+    QString depth = QInputDialog::getItem(this, "原始图像", "位深:", {"8 位", "16 位"}, 0, false, &ok);
+    if (!ok) return;
+
+    RawImageFormat format;
+    format.width = width;
+    format.bitsPerPixel = depth.startsWith("16") ? 16 : 8;
+    format.height = int(QFileInfo(path).size() / (qint64(width) * (format.bitsPerPixel / 8)));
+    stopRecording();
+    scene->loadRawImage(path, format);
+}
+
+void MainWindow::onOpenProject() {
+    QString path = QFileDialog::getOpenFileName(this, "打开项目", "", "测量项目 (*.mproj *.json)");
+    if (!path.isEmpty()) {
+        stopRecording();
+        scene->openProject(path);
+    }
+}
+
+void MainWindow::onSaveProject() {
+    QString filter;
+    QString path = QFileDialog::getSaveFileName(this, "保存项目", "", "测量项目 (*.mproj);;JSON 导出 (*.json)", &filter);
+    if (path.isEmpty()) {
+        return;
+    }
+    if (QFileInfo(path).suffix().isEmpty()) {
+        path += filter.contains("json") ? ".json" : ".mproj";
+    }
+    scene->saveProject(path);
+}
+
+void MainWindow::onExportImage() {
+    QString filter;
+    QString path = QFileDialog::getSaveFileName(this, "导出标注图", "", "TIFF 图像 (*.tif *.tiff);;BMP 图像 (*.bmp)", &filter);
+    if (path.isEmpty()) {
+        return;
+    }
+    if (QFileInfo(path).suffix().isEmpty()) {
+        path += filter.startsWith("BMP") ? ".bmp" : ".tif";
+    }
+    if (scene->exportImage(path)) {
+        exportProgress->setMaximum(0);
+        exportProgress->setValue(0);
+    }
+}
+
+void MainWindow::onDetectFeatures() {
+    if (scene->detectFeatures()) {
+        recorder->recordDetection();
+        detectProgress->setMaximum(0);
+        detectProgress->setValue(0);
     }
 }
 
@@ -88,7 +270,8 @@ void MainWindow::onSetScale() {
     bool ok;
     double val = QInputDialog::getDouble(this, "设置比例尺", "输入每1mm对应的像素数:", scene->getScaleRatio(), 0.1, 10000.0, 2, &ok);
     if (ok) {
-        scene->setScaleRatio(val);
+        scene->changeScaleRatio(val);
+        recorder->recordScale(val);
         updateStatus(QString("比例尺已设置: %1 px/mm").arg(val));
     }
 }
@@ -96,6 +279,7 @@ void MainWindow::onSetScale() {
 void MainWindow::onModeLine() {
     if (actionLine->isChecked()) {
         scene->setMode(ToolMode::Line);
+        recorder->recordMode(ToolMode::Line);
         updateStatus("模式: 直线测量 (点击2个点)");
     }
 }
@@ -103,6 +287,7 @@ void MainWindow::onModeLine() {
 void MainWindow::onModeArc() {
     if (actionArc->isChecked()) {
         scene->setMode(ToolMode::Arc);
+        recorder->recordMode(ToolMode::Arc);
         updateStatus("模式: 圆弧测量 (点击3个点)");
     }
 }
@@ -110,6 +295,7 @@ void MainWindow::onModeArc() {
 void MainWindow::onModeAngle() {
     if (actionAngle->isChecked()) {
         scene->setMode(ToolMode::Angle);
+        recorder->recordMode(ToolMode::Angle);
         updateStatus("模式: 角度测量 (点击3个点: 起点, 顶点, 终点)");
     }
 }
@@ -117,12 +303,86 @@ void MainWindow::onModeAngle() {
 void MainWindow::onModeDistance() {
     if (actionDistance->isChecked()) {
         scene->setMode(ToolMode::Distance);
+        recorder->recordMode(ToolMode::Distance);
         updateStatus("模式: 点线距离 (先选中直线, 再点击点)");
     }
 }
 
+void MainWindow::onModeArcFit() {
+    if (actionArcFit->isChecked()) {
+        scene->setMode(ToolMode::ArcFit);
+        recorder->recordMode(ToolMode::ArcFit);
+        updateStatus("模式: 拟合圆弧 (按住左键沿轮廓拖动)");
+    }
+}
+
+void MainWindow::onModeDelete() {
+    if (actionDelete->isChecked()) {
+        scene->setMode(ToolMode::Delete);
+        recorder->recordMode(ToolMode::Delete);
+        updateStatus("模式: 删除测量 (点击要删除的测量)");
+    }
+}
+
+void MainWindow::onEdgeSnapToggled(bool enabled) {
+    scene->setEdgeSnapping(enabled);
+    recorder->recordEdgeSnapping(enabled);
+    updateStatus(enabled ? "边缘吸附: 开 (点击点将吸附到附近最强边缘)" : "边缘吸附: 关");
+}
+
+void MainWindow::onBatchedToggled(bool enabled) {
+    scene->setBatchedRendering(enabled);
+    recorder->recordBatchedRendering(enabled);
+    updateStatus(enabled ? "批量绘制: 开 (所有测量由一个图元按批绘制，适合大量标注)" : "批量绘制: 关");
+}
+
+void MainWindow::onRenderProfileChanged(int index) {
+    const RenderSettings settings = index == 1 ? RenderSettings::interactive() : RenderSettings::quality();
+    view->setRenderSettings(settings);
+    scene->setImageCaching(settings.cacheImage);
+    recorder->recordRenderProfile(index == 1);
+}
+
+void MainWindow::onHudToggled(bool enabled) {
+    view->setHudVisible(enabled);
+}
+
+void MainWindow::onRecordToggled(bool enabled) {
+    if (!enabled) {
+        if (recorder->isRecording()) {
+            recorder->stop();
+            updateStatus("录制已停止");
+        }
+        return;
+    }
+    QString path = QFileDialog::getSaveFileName(this, "录制操作", "", "操作日志 (*.jsonl)");
+    QString error;
+    if (!path.isEmpty() && QFileInfo(path).suffix().isEmpty()) {
+        path += ".jsonl";
+    }
+    if (path.isEmpty() || !recorder->start(path, &error)) {
+        if (!error.isEmpty()) updateStatus("无法开始录制: " + error);
+        actionRecord->setChecked(false);
+        return;
+    }
+    updateStatus("正在录制: " + QFileInfo(path).fileName());
+}
+
+void MainWindow::stopRecording() {
+    // A replay starts from the scene saved with the log and cannot follow a new image or project
+    if (recorder->isRecording()) {
+        actionRecord->setChecked(false);
+    }
+}
+
+void MainWindow::onFrameTime(double averageMs, double worstMs, int frames) {
+    frameTimeLabel->setText(QString("绘制: 平均 %1 ms, 最长 %2 ms (%3 帧)")
+                                .arg(averageMs, 0, 'f', 1).arg(worstMs, 0, 'f', 1).arg(frames));
+}
+
 void MainWindow::onClear() {
     scene->clearMeasurements();
+    recorder->recordClear();
 }
 
 void MainWindow::updateStatus(const QString& message) {
@@ -142,4 +402,6 @@ void MainWindow::resetActions() {
     actionArc->setChecked(false);
     actionAngle->setChecked(false);
     actionDistance->setChecked(false);
+    actionArcFit->setChecked(false);
+    actionDelete->setChecked(false);
 }
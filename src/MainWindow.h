@@ -5,8 +5,14 @@
 #include <QToolBar>
 #include <QLabel>
 #include <QAction>
+#include <QComboBox>
+#include <QDockWidget>
+#include <QProgressDialog>
 #include "CanvasScene.h"
 #include "CanvasView.h"
+#include "EnhancePanel.h"
+#include "InputRecorder.h"
+#include "LoupeWidget.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -17,11 +23,23 @@ public:
 
 private slots:
     void onImportImage();
+    void onOpenProject();
+    void onSaveProject();
+    void onExportImage();
+    void onDetectFeatures();
     void onSetScale();
     void onModeLine();
     void onModeArc();
     void onModeAngle();
     void onModeDistance();
+    void onModeArcFit();
+    void onModeDelete();
+    void onEdgeSnapToggled(bool enabled);
+    void onBatchedToggled(bool enabled);
+    void onRenderProfileChanged(int index);
+    void onHudToggled(bool enabled);
+    void onRecordToggled(bool enabled);
+    void onFrameTime(double averageMs, double worstMs, int frames);
     void onClear();
     void onModeChanged(ToolMode mode);
     void updateStatus(const QString& message);
@@ -30,17 +48,40 @@ private:
     void createActions();
     void createToolbar();
     void resetActions();
+    // Ends a recording before the scene is replaced
+    void stopRecording();
 
     CanvasView* view;
     CanvasScene* scene;
+    InputRecorder* recorder;
     QLabel* statusLabel;
+    QLabel* frameTimeLabel;
+    QComboBox* renderProfile;
+    QProgressDialog* exportProgress;
+    QProgressDialog* detectProgress;
+    LoupeWidget* loupe;
+    QDockWidget* loupeDock;
+    EnhancePanel* enhancePanel;
+    QDockWidget* enhanceDock;
 
     QAction* actionImport;
+    QAction* actionOpenProject;
+    QAction* actionSaveProject;
+    QAction* actionExportImage;
+    QAction* actionDetect;
     QAction* actionSetScale;
     QAction* actionLine;
     QAction* actionArc;
     QAction* actionAngle;
     QAction* actionDistance;
+    QAction* actionArcFit;
+    QAction* actionDelete;
+    QAction* actionUndo;
+    QAction* actionRedo;
+    QAction* actionSnap;
+    QAction* actionBatched;
+    QAction* actionHud;
+    QAction* actionRecord;
     QAction* actionClear;
 };
 
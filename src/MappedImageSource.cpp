@@ -0,0 +1,191 @@
+#include "MappedImageSource.h"
+#include <QtEndian>
+#include <cstring>
+
+std::shared_ptr<MappedImageSource::Mapping> MappedImageSource::map(const QString& path, QString* error) {
+    auto mapping = std::make_shared<Mapping>();
+    mapping->file.setFileName(path);
+    if (!mapping->file.open(QIODevice::ReadOnly)) {
+        if (error) *error = mapping->file.errorString();
+        return nullptr;
+    }
+    mapping->data = mapping->file.map(0, mapping->file.size());
+    if (!mapping->data) {
+        if (error) *error = mapping->file.errorString();
+        return nullptr;
+    }
+    return mapping;
+}
+
+void MappedImageSource::releaseMapping(void* info) {
+    delete static_cast<std::shared_ptr<Mapping>*>(info);
+}
+
+std::shared_ptr<MappedImageSource> MappedImageSource::openRaw(const QString& path, const RawImageFormat& rawFormat, int tileSize, QString* error) {
+    if (rawFormat.width <= 0 || rawFormat.height <= 0
+        || (rawFormat.bitsPerPixel != 8 && rawFormat.bitsPerPixel != 16)) {
+        if (error) *error = "不支持的原始图像格式";
+        return nullptr;
+    }
+    auto mapping = map(path, error);
+    if (!mapping) return nullptr;
+
+    const int bpp = rawFormat.bitsPerPixel / 8;
+    const qint64 needed = rawFormat.headerBytes + qint64(rawFormat.width) * rawFormat.height * bpp;
+    if (mapping->file.size() < needed) {
+        if (error) *error = "文件大小与图像尺寸不符";
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedImageSource> source(new MappedImageSource);
+    source->mapping = mapping;
+    source->firstRow = mapping->data + rawFormat.headerBytes;
+    source->stride = qsizetype(rawFormat.width) * bpp;
+    source->width = rawFormat.width;
+    source->height = rawFormat.height;
+    source->bytesPerPixel = bpp;
+    source->levels = levelCountFor(source->size(), tileSize);
+    source->format = QImage::Format_Grayscale8;
+    source->sixteenBit = (bpp == 2);
+    if (source->sixteenBit) {
+        source->estimateWindow();
+    }
+    return source;
+}
+
+std::shared_ptr<MappedImageSource> MappedImageSource::openBmp(const QString& path, int tileSize, QString* error) {
+    auto mapping = map(path, error);
+    if (!mapping) return nullptr;
+
+    const uchar* data = mapping->data;
+    const qint64 fileSize = mapping->file.size();
+    if (fileSize < 54 || data[0] != 'B' || data[1] != 'M') return nullptr;
+
+    const quint32 pixelOffset = qFromLittleEndian<quint32>(data + 10);
+    const quint32 infoSize = qFromLittleEndian<quint32>(data + 14);
+    const qint32 bmpWidth = qFromLittleEndian<qint32>(data + 18);
+    const qint32 bmpHeight = qFromLittleEndian<qint32>(data + 22);
+    const quint16 bitCount = qFromLittleEndian<quint16>(data + 28);
+    const quint32 compression = qFromLittleEndian<quint32>(data + 30);
+    const quint32 colorsUsed = qFromLittleEndian<quint32>(data + 46);
+
+    // BI_RGB only, everything else goes through the regular decoder
+    if (infoSize < 40 || compression != 0 || bmpWidth <= 0 || bmpHeight == 0) return nullptr;
+    if (bitCount != 8 && bitCount != 24 && bitCount != 32) return nullptr;
+
+    const int h = qAbs(bmpHeight);
+    const qsizetype rowBytes = ((qsizetype(bmpWidth) * bitCount + 31) / 32) * 4;
+    if (qint64(pixelOffset) + rowBytes * h > fileSize) {
+        if (error) *error = "BMP 文件不完整";
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedImageSource> source(new MappedImageSource);
+    source->mapping = mapping;
+    source->width = bmpWidth;
+    source->height = h;
+    source->bytesPerPixel = bitCount / 8;
+    source->levels = levelCountFor(source->size(), tileSize);
+    if (bmpHeight > 0) {
+        // Bottom-up: walk the rows backwards from the last one in the file
+        source->firstRow = data + pixelOffset + rowBytes * (h - 1);
+        source->stride = -rowBytes;
+    } else {
+        source->firstRow = data + pixelOffset;
+        source->stride = rowBytes;
+    }
+
+    if (bitCount == 8) {
+        const int entries = colorsUsed ? int(qMin<quint32>(colorsUsed, 256)) : 256;
+        const uchar* palette = data + 14 + infoSize;
+        if (palette + entries * 4 > data + pixelOffset) return nullptr;
+        bool gray = true;
+        QVector<QRgb> table(entries);
+        for (int i = 0; i < entries; ++i) {
+            table[i] = qRgb(palette[i * 4 + 2], palette[i * 4 + 1], palette[i * 4]);
+            gray = gray && table[i] == qRgb(i, i, i);
+        }
+        // A plain gray ramp needs no color table, so the rows can be wrapped as they are
+        if (gray) {
+            source->format = QImage::Format_Grayscale8;
+        } else {
+            source->format = QImage::Format_Indexed8;
+            source->colorTable = table;
+        }
+    } else if (bitCount == 24) {
+        source->format = QImage::Format_BGR888;
+    } else {
+        source->format = QImage::Format_RGB32;
+    }
+    return source;
+}
+
+void MappedImageSource::setWindow(int low, int high) {
+    low = qBound(0, low, 65535);
+    high = qBound(low + 1, high, 65536);
+    windowLut.resize(65536);
+    const double scale = 255.0 / (high - low);
+    for (int v = 0; v < 65536; ++v) {
+        windowLut[v] = uchar(qBound(0.0, (v - low) * scale + 0.5, 255.0));
+    }
+}
+
+void MappedImageSource::estimateWindow() {
+    // Sparse sample so only a few hundred rows of a huge dump get paged in
+    const int rowStep = qMax(1, height / 256);
+    const int colStep = qMax(1, width / 1024);
+    int low = 65535;
+    int high = 0;
+    for (int y = 0; y < height; y += rowStep) {
+        const uchar* row = rowAt(y);
+        for (int x = 0; x < width; x += colStep) {
+            const int v = qFromLittleEndian<quint16>(row + qsizetype(x) * 2);
+            low = qMin(low, v);
+            high = qMax(high, v);
+        }
+    }
+    if (high <= low) {
+        low = 0;
+        high = 65535;
+    }
+    setWindow(low, high);
+}
+
+QImage MappedImageSource::tile(int level, const QRect& rect) const {
+    if (level < 0 || level >= levels || rect.isEmpty()) return QImage();
+
+    // No copy at all: wrap the mapped rows, the image keeps the mapping alive
+    const uchar* first = rowAt(rect.y()) + qsizetype(rect.x()) * bytesPerPixel;
+    if (level == 0 && !sixteenBit && stride > 0 && colorTable.isEmpty()
+        && (bytesPerPixel != 4 || (quintptr(first) % 4 == 0 && stride % 4 == 0))) {
+        return QImage(first, rect.width(), rect.height(), stride, format,
+                      &MappedImageSource::releaseMapping, new std::shared_ptr<Mapping>(mapping));
+    }
+
+    // Copy (and window/subsample) only the pixels of this tile
+    const int step = 1 << level;
+    QImage out(rect.size(), format);
+    if (!colorTable.isEmpty()) {
+        out.setColorTable(colorTable);
+    }
+    for (int y = 0; y < rect.height(); ++y) {
+        const uchar* src = rowAt(qMin(height - 1, (rect.y() + y) * step));
+        uchar* dst = out.scanLine(y);
+        const int x0 = rect.x() * step;
+        if (sixteenBit) {
+            const uchar* lut = windowLut.constData();
+            for (int x = 0; x < rect.width(); ++x) {
+                const int sx = qMin(width - 1, x0 + x * step);
+                dst[x] = lut[qFromLittleEndian<quint16>(src + qsizetype(sx) * 2)];
+            }
+        } else if (step == 1) {
+            std::memcpy(dst, src + qsizetype(x0) * bytesPerPixel, size_t(rect.width()) * bytesPerPixel);
+        } else {
+            for (int x = 0; x < rect.width(); ++x) {
+                const int sx = qMin(width - 1, x0 + x * step);
+                std::memcpy(dst + x * bytesPerPixel, src + qsizetype(sx) * bytesPerPixel, bytesPerPixel);
+            }
+        }
+    }
+    return out;
+}
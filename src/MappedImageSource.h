@@ -0,0 +1,64 @@
+#ifndef MAPPEDIMAGESOURCE_H
+#define MAPPEDIMAGESOURCE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include "ImageSource.h"
+
+// Layout of a headerless line-scan dump
+struct RawImageFormat {
+    int width = 0;
+    int height = 0;
+    int bitsPerPixel = 8;  // 8 or 16 (little endian) grayscale
+    qint64 headerBytes = 0; // skipped at the start of the file
+};
+
+// Image source that reads pixels straight out of a memory-mapped file.
+// Opening only maps the file; pages become resident when a tile touching
+// them is requested. Full-resolution tiles of top-down 8/24/32-bit data
+// wrap the mapped rows without copying, 16-bit data is windowed to 8-bit
+// per tile.
+class MappedImageSource : public ImageSource {
+public:
+    static std::shared_ptr<MappedImageSource> openRaw(const QString& path, const RawImageFormat& format, int tileSize, QString* error);
+    // Returns null for anything but an uncompressed BMP
+    static std::shared_ptr<MappedImageSource> openBmp(const QString& path, int tileSize, QString* error);
+
+    QSize size() const override { return QSize(width, height); }
+    int levelCount() const override { return levels; }
+    QImage tile(int level, const QRect& rect) const override;
+
+    bool isSixteenBit() const { return sixteenBit; }
+    // Maps [low, high] of 16-bit data onto 0..255
+    void setWindow(int low, int high);
+
+private:
+    struct Mapping {
+        QFile file;
+        uchar* data = nullptr;
+        ~Mapping() { if (data) file.unmap(data); }
+    };
+
+    MappedImageSource() = default;
+    static std::shared_ptr<Mapping> map(const QString& path, QString* error);
+    static void releaseMapping(void* info);
+
+    const uchar* rowAt(int y) const { return firstRow + qsizetype(y) * stride; }
+    void estimateWindow();
+
+    std::shared_ptr<Mapping> mapping;
+    const uchar* firstRow = nullptr; // top row of the image
+    qsizetype stride = 0;            // negative for bottom-up BMP rows
+    int width = 0;
+    int height = 0;
+    int bytesPerPixel = 1;
+    int levels = 1;
+    QImage::Format format = QImage::Format_Grayscale8;
+    QVector<QRgb> colorTable;        // only for non-gray palettes
+    bool sixteenBit = false;
+    QVector<uchar> windowLut;        // 16-bit value -> display byte
+};
+
+#endif // MAPPEDIMAGESOURCE_H
@@ -0,0 +1,450 @@
+// Batch re-measurement of point lists produced by an upstream detector.
+//
+// CSV input, one primitive per line (only the first line of the input may be
+// an "id," header, lines starting with # are comments):
+//     id,type,x1,y1,x2,y2[,x3,y3]
+// type is line | arc | angle | distance. An arc passes through the three
+// points, an angle has its vertex at x2,y2, a distance is measured from
+// x3,y3 to the line through x1,y1 and x2,y2.
+//
+// JSONL input, one object per line:
+//     {"id": "a1", "type": "arc", "points": [x1, y1, x2, y2, x3, y3]}
+//
+// The output uses the format of the input and keeps its order: the value in
+// pixels, the value in mm (degrees for angles) and the centre of arcs. Rows that
+// cannot be measured carry an error instead: parse, collinear (arc through
+// three points on a line) or degenerate (a non-finite result).
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Geometry.h"
+#include "GeometryBatch.h"
+
+static constexpr qint64 BlockSize = 8 * 1024 * 1024;
+
+enum class Kind { Invalid, Line, Arc, Angle, Distance };
+
+struct Primitive {
+    QByteArray id;
+    QJsonValue jsonId;
+    Kind kind = Kind::Invalid;
+    double c[6];
+    int count = 0;
+};
+
+struct Result {
+    double px = 0;
+    double value = 0;
+    QPointF center;
+    const char* error = nullptr;
+};
+
+static Kind kindFromName(const char* s, int n) {
+    auto is = [&](const char* name) { return int(std::strlen(name)) == n && std::memcmp(s, name, n) == 0; };
+    if (is("line")) return Kind::Line;
+    if (is("arc")) return Kind::Arc;
+    if (is("angle")) return Kind::Angle;
+    if (is("distance")) return Kind::Distance;
+    return Kind::Invalid;
+}
+
+static const char* kindName(Kind kind) {
+    switch (kind) {
+    case Kind::Line: return "line";
+    case Kind::Arc: return "arc";
+    case Kind::Angle: return "angle";
+    case Kind::Distance: return "distance";
+    default: return "invalid";
+    }
+}
+
+static int coordinateCount(Kind kind) {
+    return kind == Kind::Line ? 4 : 6;
+}
+
+static bool parseCsv(const char* s, const char* end, Primitive& p) {
+    const char* fields[9];
+    int lengths[9];
+    int n = 0;
+    const char* cur = s;
+    while (n < 9) {
+        const char* comma = static_cast<const char*>(std::memchr(cur, ',', end - cur));
+        fields[n] = cur;
+        lengths[n] = int((comma ? comma : end) - cur);
+        ++n;
+        if (!comma) break;
+        cur = comma + 1;
+    }
+    if (n < 2) return false;
+
+    p.id = QByteArray(fields[0], lengths[0]);
+    p.kind = kindFromName(fields[1], lengths[1]);
+    p.count = 0;
+    for (int i = 2; i < n && p.count < 6; ++i) {
+        // strtod stops at the comma; LC_NUMERIC is forced to "C" in main()
+        char* numberEnd = nullptr;
+        p.c[p.count++] = std::strtod(fields[i], &numberEnd);
+        if (numberEnd == fields[i] || numberEnd > fields[i] + lengths[i]) return false;
+    }
+    return p.kind != Kind::Invalid && p.count == coordinateCount(p.kind);
+}
+
+static bool parseJson(const char* s, const char* end, Primitive& p) {
+    const QJsonObject obj = QJsonDocument::fromJson(QByteArray::fromRawData(s, int(end - s))).object();
+    p.jsonId = obj.value("id");
+    const QByteArray type = obj.value("type").toString().toLatin1();
+    p.kind = kindFromName(type.constData(), type.size());
+    const QJsonArray points = obj.value("points").toArray();
+    p.count = 0;
+    for (int i = 0; i < points.size() && p.count < 6; ++i) {
+        p.c[p.count++] = points[i].toDouble();
+    }
+    return p.kind != Kind::Invalid && p.count == coordinateCount(p.kind);
+}
+
+static void writeCsv(QByteArray& out, const Primitive& p, const Result& r) {
+    // No fixed buffer: a huge coordinate or radius makes an arbitrarily long number
+    const auto number = [&](double v) {
+        out.append(',');
+        out.append(QByteArray::number(v, 'f', 6));
+    };
+    out.append(p.id);
+    out.append(',');
+    out.append(kindName(p.kind));
+    if (r.error) {
+        out.append(",,,,,");
+        out.append(r.error);
+        out.append('\n');
+    } else if (p.kind == Kind::Arc) {
+        number(r.px);
+        number(r.value);
+        number(r.center.x());
+        number(r.center.y());
+        out.append(",\n");
+    } else {
+        number(r.px);
+        number(r.value);
+        out.append(",,,\n");
+    }
+}
+
+static void writeJson(QByteArray& out, const Primitive& p, const Result& r) {
+    QJsonObject obj;
+    obj.insert("id", p.jsonId);
+    obj.insert("type", kindName(p.kind));
+    if (r.error) {
+        obj.insert("error", r.error);
+    } else {
+        obj.insert("px", r.px);
+        obj.insert("value", r.value);
+        if (p.kind == Kind::Arc) {
+            obj.insert("center", QJsonArray{r.center.x(), r.center.y()});
+        }
+    }
+    out.append(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    out.append('\n');
+}
+
+struct Slice {
+    const char* begin;
+    const char* end;
+};
+
+// Coordinates of all primitives of one kind in a slice, one array per column
+struct Columns {
+    std::vector<double> c[6];
+    std::vector<double> out[3];
+
+    int append(const Primitive& p) {
+        for (int k = 0; k < 6; ++k) {
+            c[k].push_back(k < p.count ? p.c[k] : 0.0);
+        }
+        return int(c[0].size()) - 1;
+    }
+    void resizeOutputs() {
+        for (auto& o : out) o.resize(c[0].size());
+    }
+};
+
+// Parses every complete line of one slice, measures each kind in one batch
+// call and formats the results in input order
+static QByteArray processSlice(const Slice& slice, bool json, double mmPerPx) {
+    std::vector<Primitive> prims;
+    std::vector<int> slots;
+    Columns columns[5]; // indexed by Kind
+    Primitive p;
+
+    const char* line = slice.begin;
+    while (line < slice.end) {
+        const char* nl = static_cast<const char*>(std::memchr(line, '\n', slice.end - line));
+        const char* lineEnd = nl ? nl : slice.end;
+        const char* trimmed = lineEnd;
+        if (trimmed > line && trimmed[-1] == '\r') --trimmed;
+
+        if (trimmed > line && line[0] != '#') {
+            p.id.clear();
+            p.jsonId = QJsonValue();
+            p.kind = Kind::Invalid;
+            const bool ok = json ? parseJson(line, trimmed, p) : parseCsv(line, trimmed, p);
+            if (!ok) {
+                p.kind = Kind::Invalid;
+            }
+            slots.push_back(ok ? columns[int(p.kind)].append(p) : -1);
+            prims.push_back(p);
+        }
+        line = lineEnd + 1;
+    }
+
+    for (Columns& col : columns) {
+        col.resizeOutputs();
+    }
+    Columns& lines = columns[int(Kind::Line)];
+    GeometryBatch::lineLengths(lines.c[0].data(), lines.c[1].data(), lines.c[2].data(), lines.c[3].data(),
+                               lines.out[0].data(), lines.c[0].size());
+    Columns& arcs = columns[int(Kind::Arc)];
+    GeometryBatch::circumcircles(arcs.c[0].data(), arcs.c[1].data(), arcs.c[2].data(), arcs.c[3].data(),
+                                 arcs.c[4].data(), arcs.c[5].data(),
+                                 arcs.out[1].data(), arcs.out[2].data(), arcs.out[0].data(), arcs.c[0].size());
+    Columns& angles = columns[int(Kind::Angle)];
+    GeometryBatch::angles(angles.c[0].data(), angles.c[1].data(), angles.c[2].data(), angles.c[3].data(),
+                          angles.c[4].data(), angles.c[5].data(), angles.out[0].data(), angles.c[0].size());
+    Columns& distances = columns[int(Kind::Distance)];
+    GeometryBatch::pointLineDistances(distances.c[0].data(), distances.c[1].data(), distances.c[2].data(),
+                                      distances.c[3].data(), distances.c[4].data(), distances.c[5].data(),
+                                      distances.out[0].data(), distances.c[0].size());
+
+    QByteArray out;
+    out.reserve(int(slice.end - slice.begin));
+    for (std::size_t i = 0; i < prims.size(); ++i) {
+        const Primitive& prim = prims[i];
+        Result r;
+        if (slots[i] < 0) {
+            r.error = "parse";
+        } else {
+            const Columns& col = columns[int(prim.kind)];
+            r.px = col.out[0][slots[i]];
+            r.value = prim.kind == Kind::Angle ? r.px : r.px * mmPerPx;
+            if (prim.kind == Kind::Arc) {
+                r.center = QPointF(col.out[1][slots[i]], col.out[2][slots[i]]);
+                if (std::isnan(r.px)) r.error = "collinear";
+            }
+            // Zero-length arms or a line through two equal points
+            if (!r.error && !(std::isfinite(r.px) && std::isfinite(r.center.x()) && std::isfinite(r.center.y()))) {
+                r.error = "degenerate";
+            }
+        }
+        if (json) {
+            writeJson(out, prim, r);
+        } else {
+            writeCsv(out, prim, r);
+        }
+    }
+    return out;
+}
+
+// Compares the vectorised kernels of every supported instruction set with the
+// scalar Geometry functions on random input; returns false on a mismatch
+static bool verifyKernels() {
+    const std::size_t n = 100003; // not a multiple of any vector width, so the tails run too
+    std::vector<double> c[6];
+    quint64 state = 0x9E3779B97F4A7C15ull;
+    for (auto& col : c) {
+        col.resize(n);
+        for (double& v : col) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            v = double(state >> 11) / double(1ull << 53) * 10000.0 - 5000.0;
+        }
+    }
+
+    bool ok = true;
+    const GeometryBatch::Isa best = GeometryBatch::activeIsa();
+    for (int isa = int(GeometryBatch::Isa::Scalar); isa <= int(best); ++isa) {
+        GeometryBatch::setMaxIsa(GeometryBatch::Isa(isa));
+        std::vector<double> length(n), cx(n), cy(n), radius(n), angle(n), distance(n);
+        GeometryBatch::lineLengths(c[0].data(), c[1].data(), c[2].data(), c[3].data(), length.data(), n);
+        GeometryBatch::circumcircles(c[0].data(), c[1].data(), c[2].data(), c[3].data(), c[4].data(), c[5].data(),
+                                     cx.data(), cy.data(), radius.data(), n);
+        GeometryBatch::angles(c[0].data(), c[1].data(), c[2].data(), c[3].data(), c[4].data(), c[5].data(), angle.data(), n);
+        GeometryBatch::pointLineDistances(c[0].data(), c[1].data(), c[2].data(), c[3].data(), c[4].data(), c[5].data(),
+                                          distance.data(), n);
+
+        double worstLength = 0, worstAngle = 0;
+        auto relative = [](double a, double b) { return std::abs(a - b) / qMax(1.0, std::abs(b)); };
+        for (std::size_t i = 0; i < n; ++i) {
+            const QPointF p1(c[0][i], c[1][i]), p2(c[2][i], c[3][i]), p3(c[4][i], c[5][i]);
+            QPointF center;
+            double r = 0;
+            worstLength = qMax(worstLength, relative(length[i], Geometry::distance(p1, p2)));
+            if (Geometry::circumcircle(p1, p2, p3, center, r)) {
+                worstLength = qMax(worstLength, relative(radius[i], r));
+                worstLength = qMax(worstLength, relative(cx[i], center.x()));
+                worstLength = qMax(worstLength, relative(cy[i], center.y()));
+            } else if (!std::isnan(radius[i])) {
+                worstLength = 1.0;
+            }
+            worstLength = qMax(worstLength, relative(distance[i], Geometry::distance(p3, Geometry::projectOntoLine(p1, p2, p3))));
+            const double expected = Geometry::angleDegrees(p1, p2, p3);
+            if (!std::isnan(expected)) {
+                worstAngle = qMax(worstAngle, std::abs(angle[i] - expected));
+            }
+        }
+        const bool pass = worstLength <= GeometryBatch::LengthTolerance && worstAngle <= GeometryBatch::AngleTolerance;
+        std::fprintf(stderr, "%-6s length/radius/distance %.3g (rel), angle %.3g deg: %s\n",
+                     GeometryBatch::isaName(GeometryBatch::Isa(isa)), worstLength, worstAngle, pass ? "ok" : "FAIL");
+        ok = ok && pass;
+    }
+
+    // Circle fit on a noisy 100 degree arc: every instruction set has to land on
+    // the scalar result up to summation order, and all of them near the truth
+    std::vector<double> fx(20001), fy(20001);
+    for (std::size_t i = 0; i < fx.size(); ++i) {
+        const double t = 0.3 + 1.75 * double(i) / double(fx.size());
+        fx[i] = 1500 + 800 * std::cos(t) + (c[0][i] / 5000.0) * 0.5;
+        fy[i] = -700 + 800 * std::sin(t) + (c[1][i] / 5000.0) * 0.5;
+    }
+    GeometryBatch::CircleFit reference;
+    for (int isa = int(GeometryBatch::Isa::Scalar); isa <= int(best); ++isa) {
+        GeometryBatch::setMaxIsa(GeometryBatch::Isa(isa));
+        GeometryBatch::CircleFit fit;
+        const bool fitted = GeometryBatch::fitCircle(fx.data(), fy.data(), fx.size(), fit);
+        if (isa == int(GeometryBatch::Isa::Scalar)) reference = fit;
+        const double drift = qMax(std::abs(fit.radius - reference.radius),
+                                  qMax(std::abs(fit.cx - reference.cx), std::abs(fit.cy - reference.cy))) / reference.radius;
+        const bool pass = fitted && drift <= 1e-9 && std::abs(fit.radius - 800) < 0.1;
+        std::fprintf(stderr, "%-6s circle fit r=%.6f rms=%.4f drift %.3g (rel): %s\n",
+                     GeometryBatch::isaName(GeometryBatch::Isa(isa)), fit.radius, fit.rms, drift, pass ? "ok" : "FAIL");
+        ok = ok && pass;
+    }
+    GeometryBatch::setMaxIsa(best);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("MeasureCli");
+    // Qt sets the user locale on startup; numbers in the files always use '.'
+    std::setlocale(LC_NUMERIC, "C");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("批量测量: 从 CSV/JSONL 点集计算长度、半径、角度和点线距离");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "输入文件 (默认标准输入)");
+    QCommandLineOption scaleOption("scale", "每1mm对应的像素数", "px/mm", "1.0");
+    QCommandLineOption formatOption("format", "csv 或 jsonl (默认按扩展名)", "format");
+    QCommandLineOption outputOption({"o", "output"}, "输出文件 (默认标准输出)", "file");
+    QCommandLineOption threadsOption("threads", "工作线程数 (默认全部核心)", "n");
+    QCommandLineOption verifyOption("verify", "校验向量化内核与标量公式的一致性后退出");
+    parser.addOption(scaleOption);
+    parser.addOption(formatOption);
+    parser.addOption(outputOption);
+    parser.addOption(threadsOption);
+    parser.addOption(verifyOption);
+    parser.process(app);
+
+    if (parser.isSet(verifyOption)) {
+        return verifyKernels() ? 0 : 1;
+    }
+
+    const double scale = parser.value(scaleOption).toDouble();
+    if (scale <= 0) {
+        std::fprintf(stderr, "invalid --scale\n");
+        return 1;
+    }
+    if (parser.isSet(threadsOption)) {
+        QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(threadsOption).toInt()));
+    }
+
+    const QStringList args = parser.positionalArguments();
+    QFile in;
+    bool opened = false;
+    if (args.isEmpty()) {
+        opened = in.open(stdin, QIODevice::ReadOnly);
+    } else {
+        in.setFileName(args.first());
+        opened = in.open(QIODevice::ReadOnly);
+    }
+    QFile out;
+    if (parser.isSet(outputOption)) {
+        out.setFileName(parser.value(outputOption));
+        opened = opened && out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    } else {
+        opened = opened && out.open(stdout, QIODevice::WriteOnly);
+    }
+    if (!opened) {
+        std::fprintf(stderr, "cannot open input/output\n");
+        return 1;
+    }
+
+    QString format = parser.value(formatOption);
+    if (format.isEmpty()) {
+        format = (!args.isEmpty() && (args.first().endsWith(".jsonl") || args.first().endsWith(".json"))) ? "jsonl" : "csv";
+    }
+    const bool json = (format == "jsonl" || format == "json");
+    const double mmPerPx = 1.0 / scale;
+    const int slicesPerBlock = QThreadPool::globalInstance()->maxThreadCount() * 4;
+
+    if (!json) {
+        out.write("id,type,px,value,cx,cy,error\n");
+    }
+
+    QByteArray carry;
+    bool firstBlock = true;
+    while (true) {
+        QByteArray block = in.read(BlockSize);
+        const bool atEnd = block.isEmpty();
+        QByteArray data = carry + block;
+        carry.clear();
+        if (data.isEmpty()) break;
+
+        // Keep the incomplete last line for the next block
+        if (!atEnd) {
+            const int last = data.lastIndexOf('\n');
+            if (last < 0) {
+                carry = data;
+                continue;
+            }
+            carry = data.mid(last + 1);
+            data.truncate(last + 1);
+        }
+
+        // Cut the block into slices at line boundaries, one task each, results stay in order
+        QList<Slice> slices;
+        const char* begin = data.constData();
+        const char* end = begin + data.size();
+        // Only the very first line may be a header, an "id," row further down is data
+        if (firstBlock && !json && data.startsWith("id,")) {
+            const char* nl = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+            begin = nl ? nl + 1 : end;
+        }
+        firstBlock = false;
+        const qint64 step = qMax<qint64>(4096, data.size() / slicesPerBlock);
+        while (begin < end) {
+            const char* cut = begin + qMin<qint64>(step, end - begin);
+            if (cut < end) {
+                const char* nl = static_cast<const char*>(std::memchr(cut, '\n', end - cut));
+                cut = nl ? nl + 1 : end;
+            }
+            slices.append(Slice{begin, cut});
+            begin = cut;
+        }
+
+        const QList<QByteArray> results = QtConcurrent::blockingMapped<QList<QByteArray>>(slices,
+            [json, mmPerPx](const Slice& slice) { return processSlice(slice, json, mmPerPx); });
+        for (const QByteArray& result : results) {
+            out.write(result);
+        }
+        if (atEnd) break;
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+#include "MeasureGraphicsItem.h"
+#include "Geometry.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+const double MarkerRadius = 2;
+// Half the widest pen (a highlighted line) plus antialiasing
+const double PenMargin = 3;
+
+// Largest distance between an arc and its flattened chords, device pixels
+const double ArcTolerance = 0.25;
+
+} // namespace
+
+QPen MeasureGraphicsItem::pen(int type, bool highlighted) {
+    switch (type) {
+    case MeasureRecord::Line: return highlighted ? QPen(Qt::magenta, 4) : QPen(Qt::red, 2);
+    case MeasureRecord::Distance: return QPen(Qt::cyan, 1, Qt::DashLine);
+    case MeasureRecord::Angle: return QPen(Qt::yellow, 2);
+    default: return QPen(Qt::green, 2);
+    }
+}
+
+const QFont& MeasureGraphicsItem::labelFont() {
+    static const QFont font;
+    return font;
+}
+
+const QFontMetricsF& MeasureGraphicsItem::labelMetrics() {
+    static const QFontMetricsF metrics(labelFont());
+    return metrics;
+}
+
+QPointF MeasureGraphicsItem::labelPosition(const MeasureRecord& record) {
+    const QPointF* p = record.points;
+    switch (record.type) {
+    case MeasureRecord::Line:
+    case MeasureRecord::Distance: return (p[0] + p[1]) / 2;
+    case MeasureRecord::Angle: return p[1] + QPointF(10, 10);
+    default: return record.center;
+    }
+}
+
+MeasureGraphicsItem* MeasureGraphicsItem::create(const MeasureRecord& record) {
+    switch (record.type) {
+    case MeasureRecord::Line: return new LineMeasureItem(record);
+    case MeasureRecord::Arc: return new ArcMeasureItem(record);
+    case MeasureRecord::Distance: return new DistanceMeasureItem(record);
+    case MeasureRecord::Angle: return new AngleMeasureItem(record);
+    default: return new FittedArcMeasureItem(record);
+    }
+}
+
+MeasureGraphicsItem::MeasureGraphicsItem(const MeasureRecord& record)
+    : rec(record), highlighted(false) {
+}
+
+QStaticText MeasureGraphicsItem::staticLabel(const QString& text) {
+    QStaticText label(text);
+    label.setTextFormat(Qt::PlainText);
+    label.prepare(QTransform(), labelFont());
+    return label;
+}
+
+int MeasureGraphicsItem::lodLevel(double lod) {
+    return lod > 0 ? int(std::floor(std::log2(lod))) : INT_MIN / 2;
+}
+
+double MeasureGraphicsItem::lodScale(int level) {
+    return std::ldexp(1.0, level + 1);
+}
+
+void MeasureGraphicsItem::setRecord(const MeasureRecord& record) {
+    prepareGeometryChange();
+    rec = record;
+    geometryRect = layoutGeometry();
+    updateBounds();
+}
+
+void MeasureGraphicsItem::setLabel(const QString& text) {
+    if (text == labelText) return;
+    prepareGeometryChange();
+    labelText = text;
+    labelGlyphs = staticLabel(text);
+    updateBounds();
+}
+
+void MeasureGraphicsItem::setHighlighted(bool on) {
+    if (on == highlighted) return;
+    highlighted = on;
+    update();
+}
+
+void MeasureGraphicsItem::updateBounds() {
+    labelRect = labelText.isEmpty() ? QRectF()
+                                    : QRectF(labelPosition(rec), QSizeF(labelMetrics().horizontalAdvance(labelText),
+                                                                   labelMetrics().height()));
+    bounds = geometryRect.united(labelRect);
+}
+
+QRectF MeasureGraphicsItem::boundingRect() const {
+    return bounds;
+}
+
+void MeasureGraphicsItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    Q_UNUSED(widget);
+    const double lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    paintGeometry(painter, lod);
+
+    // Too small to read is not worth drawing
+    if (!labelText.isEmpty() && labelReadable(lod)) {
+        painter->setFont(labelFont());
+        painter->setPen(Qt::blue);
+        painter->drawStaticText(labelRect.topLeft(), labelGlyphs);
+    }
+}
+
+LineMeasureItem::LineMeasureItem(const MeasureRecord& record) : MeasureGraphicsItem(record) {
+    setRecord(record);
+}
+
+QRectF LineMeasureItem::layoutGeometry() {
+    return QRectF(rec.points[0], rec.points[1]).normalized().adjusted(-PenMargin, -PenMargin, PenMargin, PenMargin);
+}
+
+void LineMeasureItem::paintGeometry(QPainter* painter, double lod) {
+    Q_UNUSED(lod);
+    painter->setPen(pen(MeasureRecord::Line, highlighted));
+    painter->drawLine(rec.points[0], rec.points[1]);
+}
+
+ArcMeasureItem::ArcMeasureItem(const MeasureRecord& record) : ArcMeasureItem(record, true) {
+}
+
+ArcMeasureItem::ArcMeasureItem(const MeasureRecord& record, bool markers)
+    : MeasureGraphicsItem(record), markers(markers), arcStart(0), arcSpan(0), polylineLevel(INT_MIN) {
+    setRecord(record);
+}
+
+QRectF ArcMeasureItem::layoutGeometry() {
+    const QPointF* p = rec.points;
+    const double r = rec.valuePx;
+    QRectF rect;
+    polyline.clear();
+    polylineLevel = INT_MIN;
+    if (r > 0) {
+        Geometry::arcAngles(rec.center, p[0], p[1], p[2], arcStart, arcSpan);
+        rect = Geometry::arcBounds(rec.center, r, arcStart, arcSpan);
+    } else {
+        // Collinear, just draw lines
+        polyline = {p[0], p[1], p[2]};
+        rect = QRectF(p[0], p[1]).normalized() | QRectF(p[1], p[2]).normalized();
+    }
+
+    if (markers) {
+        for (int i = 0; i < 3; ++i) {
+            rect |= QRectF(p[i].x() - MarkerRadius, p[i].y() - MarkerRadius, 2 * MarkerRadius, 2 * MarkerRadius);
+        }
+    }
+    return rect.adjusted(-PenMargin, -PenMargin, PenMargin, PenMargin);
+}
+
+void ArcMeasureItem::paintGeometry(QPainter* painter, double lod) {
+    // As many chords as the on-screen radius needs, redone only when the zoom
+    // crosses a factor of 2
+    const int level = lodLevel(lod);
+    if (rec.valuePx > 0 && level != polylineLevel) {
+        const int segments = Geometry::arcSegments(rec.valuePx * lodScale(level), arcSpan, ArcTolerance);
+        polyline.resize(segments + 1);
+        Geometry::flattenArc(rec.center, rec.valuePx, arcStart, arcSpan, segments, polyline.data());
+        polylineLevel = level;
+    }
+
+    painter->setPen(pen(rec.type));
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPolyline(polyline.constData(), polyline.size());
+    if (markers) {
+        painter->setPen(QPen(Qt::green));
+        painter->setBrush(Qt::green);
+        for (int i = 0; i < 3; ++i) {
+            painter->drawEllipse(rec.points[i], MarkerRadius, MarkerRadius);
+        }
+    }
+}
+
+DistanceMeasureItem::DistanceMeasureItem(const MeasureRecord& record) : MeasureGraphicsItem(record) {
+    setRecord(record);
+}
+
+QRectF DistanceMeasureItem::layoutGeometry() {
+    return QRectF(rec.points[0], rec.points[1]).normalized().adjusted(-PenMargin, -PenMargin, PenMargin, PenMargin);
+}
+
+void DistanceMeasureItem::paintGeometry(QPainter* painter, double lod) {
+    Q_UNUSED(lod);
+    painter->setPen(pen(MeasureRecord::Distance));
+    painter->drawLine(rec.points[0], rec.points[1]);
+}
+
+AngleMeasureItem::AngleMeasureItem(const MeasureRecord& record) : MeasureGraphicsItem(record) {
+    setRecord(record);
+}
+
+QRectF AngleMeasureItem::layoutGeometry() {
+    const QPointF* p = rec.points;
+    const qreal left = qMin(p[0].x(), qMin(p[1].x(), p[2].x()));
+    const qreal right = qMax(p[0].x(), qMax(p[1].x(), p[2].x()));
+    const qreal top = qMin(p[0].y(), qMin(p[1].y(), p[2].y()));
+    const qreal bottom = qMax(p[0].y(), qMax(p[1].y(), p[2].y()));
+    return QRectF(left, top, right - left, bottom - top).adjusted(-PenMargin, -PenMargin, PenMargin, PenMargin);
+}
+
+void AngleMeasureItem::paintGeometry(QPainter* painter, double lod) {
+    Q_UNUSED(lod);
+    painter->setPen(pen(MeasureRecord::Angle));
+    painter->drawLine(rec.points[1], rec.points[0]);
+    painter->drawLine(rec.points[1], rec.points[2]);
+}
+
+FittedArcMeasureItem::FittedArcMeasureItem(const MeasureRecord& record) : ArcMeasureItem(record, false) {
+}
@@ -0,0 +1,122 @@
+#ifndef MEASUREGRAPHICSITEM_H
+#define MEASUREGRAPHICSITEM_H
+
+#include <QFont>
+#include <QFontMetricsF>
+#include <QGraphicsItem>
+#include <QPen>
+#include <QStaticText>
+#include <QString>
+#include <QVector>
+#include "MeasureRecord.h"
+
+// A whole measurement in one scene item: geometry, point markers and label
+// are painted from its MeasureRecord, instead of a cluster of line, path,
+// ellipse and text items each with their own scene index entry.
+class MeasureGraphicsItem : public QGraphicsItem {
+public:
+    // Item class matching record.type
+    static MeasureGraphicsItem* create(const MeasureRecord& record);
+
+    const MeasureRecord& record() const { return rec; }
+    void setRecord(const MeasureRecord& record);
+
+    const QString& label() const { return labelText; }
+    void setLabel(const QString& text);
+
+    // Drawn in the selection colour, e.g. the line picked for a distance
+    void setHighlighted(bool highlighted);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+    // Look shared with MeasureOverlayItem, which draws the same records in batches
+    static QPen pen(int type, bool highlighted = false);
+    static const QFont& labelFont();
+    static const QFontMetricsF& labelMetrics();
+    // Top left corner of the label of record
+    static QPointF labelPosition(const MeasureRecord& record);
+    // Laid out once and drawn from its cached glyphs afterwards
+    static QStaticText staticLabel(const QString& text);
+    // Labels are skipped once their text is shorter than this on screen
+    static constexpr double MinLabelPixels = 6;
+    static bool labelReadable(double lod) { return labelMetrics().height() * lod >= MinLabelPixels; }
+
+    // Zoom steps of a factor 2 that curves are flattened for: a level covers
+    // view scales up to 2^(level + 1)
+    static int lodLevel(double lod);
+    static double lodScale(int level);
+
+protected:
+    MeasureGraphicsItem(const MeasureRecord& record);
+
+    // Called whenever the record changes; returns the bounds of the geometry
+    virtual QRectF layoutGeometry() = 0;
+    // lod: view scale, device pixels per scene unit
+    virtual void paintGeometry(QPainter* painter, double lod) = 0;
+
+    MeasureRecord rec;
+    bool highlighted;
+
+private:
+    void updateBounds();
+
+    QString labelText;
+    QStaticText labelGlyphs;
+    QRectF geometryRect;
+    QRectF labelRect;
+    QRectF bounds;
+};
+
+class LineMeasureItem : public MeasureGraphicsItem {
+public:
+    LineMeasureItem(const MeasureRecord& record);
+
+protected:
+    QRectF layoutGeometry() override;
+    void paintGeometry(QPainter* painter, double lod) override;
+};
+
+class ArcMeasureItem : public MeasureGraphicsItem {
+public:
+    ArcMeasureItem(const MeasureRecord& record);
+
+protected:
+    ArcMeasureItem(const MeasureRecord& record, bool markers);
+
+    QRectF layoutGeometry() override;
+    void paintGeometry(QPainter* painter, double lod) override;
+
+    bool markers;
+    double arcStart; // degrees, see Geometry::arcAngles
+    double arcSpan;
+    // Flattened for the zoom level it was last painted at
+    QVector<QPointF> polyline;
+    int polylineLevel;
+};
+
+class DistanceMeasureItem : public MeasureGraphicsItem {
+public:
+    DistanceMeasureItem(const MeasureRecord& record);
+
+protected:
+    QRectF layoutGeometry() override;
+    void paintGeometry(QPainter* painter, double lod) override;
+};
+
+class AngleMeasureItem : public MeasureGraphicsItem {
+public:
+    AngleMeasureItem(const MeasureRecord& record);
+
+protected:
+    QRectF layoutGeometry() override;
+    void paintGeometry(QPainter* painter, double lod) override;
+};
+
+// Circle fitted to a traced contour, drawn over the traced span without markers
+class FittedArcMeasureItem : public ArcMeasureItem {
+public:
+    FittedArcMeasureItem(const MeasureRecord& record);
+};
+
+#endif // MEASUREGRAPHICSITEM_H
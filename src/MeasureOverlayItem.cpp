@@ -0,0 +1,258 @@
+#include "MeasureOverlayItem.h"
+#include "Geometry.h"
+#include "MeasureGraphicsItem.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+const double MarkerRadius = 2;
+// Half the widest pen (a highlighted line) plus antialiasing
+const double PenMargin = 3;
+const int StyleTypes[] = {MeasureRecord::Line, MeasureRecord::Distance, MeasureRecord::Angle, MeasureRecord::Arc};
+// Largest distance between an arc and its flattened chords, device pixels
+const double ArcTolerance = 0.25;
+
+} // namespace
+
+MeasureOverlayItem::MeasureOverlayItem(QGraphicsItem* parent)
+    : QGraphicsItem(parent), bucketIndex(BucketSize), measurementCount(0) {
+    // exposedRect is only filled in with this flag set
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+void MeasureOverlayItem::flattenArcs(Bucket& bucket, int level) {
+    bucket.arcLines.clear();
+    const double scale = MeasureGraphicsItem::lodScale(level);
+    for (const Arc& arc : bucket.arcs) {
+        const int segments = Geometry::arcSegments(arc.radius * scale, arc.span, ArcTolerance);
+        arcPoints.resize(segments + 1);
+        Geometry::flattenArc(arc.center, arc.radius, arc.start, arc.span, segments, arcPoints.data());
+        for (int i = 0; i < segments; ++i) {
+            bucket.arcLines.append(QLineF(arcPoints[i], arcPoints[i + 1]));
+        }
+    }
+    bucket.arcLevel = level;
+}
+
+int MeasureOverlayItem::bucketAt(const QPointF& pos) {
+    const quint64 key = (quint64(quint32(qint64(std::floor(pos.x() / BucketSize)))) << 32)
+                        | quint32(qint64(std::floor(pos.y() / BucketSize)));
+    auto it = bucketCells.constFind(key);
+    if (it != bucketCells.constEnd()) return it.value();
+    buckets.append(Bucket());
+    buckets.last().arcLevel = INT_MIN;
+    buckets.last().stale = false;
+    bucketCells.insert(key, buckets.size() - 1);
+    return buckets.size() - 1;
+}
+
+void MeasureOverlayItem::grow(const QRectF& rect) {
+    if (bounds.contains(rect)) {
+        update(rect);
+    } else {
+        prepareGeometryChange();
+        bounds |= rect;
+    }
+}
+
+QRectF MeasureOverlayItem::layout(const MeasureRecord& record, int& style, QVector<QLineF>& lines, Arc& arc) {
+    const QPointF* p = record.points;
+    QRectF rect;
+    arc = Arc{record.center, 0, 0, 0};
+    switch (record.type) {
+    case MeasureRecord::Line:
+    case MeasureRecord::Distance:
+        style = record.type == MeasureRecord::Line ? LineStyle : DistanceStyle;
+        lines.append(QLineF(p[0], p[1]));
+        rect = QRectF(p[0], p[1]).normalized();
+        break;
+    case MeasureRecord::Angle:
+        style = AngleStyle;
+        lines.append(QLineF(p[1], p[0]));
+        lines.append(QLineF(p[1], p[2]));
+        rect = QRectF(p[1], p[0]).normalized() | QRectF(p[1], p[2]).normalized();
+        break;
+    default:
+        style = ArcStyle;
+        if (record.valuePx > 0) {
+            arc.radius = record.valuePx;
+            Geometry::arcAngles(record.center, p[0], p[1], p[2], arc.start, arc.span);
+            rect = Geometry::arcBounds(record.center, arc.radius, arc.start, arc.span);
+        } else {
+            // Collinear, just draw lines
+            lines.append(QLineF(p[0], p[1]));
+            lines.append(QLineF(p[1], p[2]));
+            rect = QRectF(p[0], p[1]).normalized() | QRectF(p[1], p[2]).normalized();
+        }
+        if (record.type == MeasureRecord::Arc) {
+            for (int i = 0; i < 3; ++i) {
+                rect |= QRectF(p[i].x() - MarkerRadius, p[i].y() - MarkerRadius, 2 * MarkerRadius, 2 * MarkerRadius);
+            }
+        }
+        break;
+    }
+    return rect.adjusted(-PenMargin, -PenMargin, PenMargin, PenMargin);
+}
+
+QRectF MeasureOverlayItem::addToBucket(Bucket& bucket, const Member& member) {
+    const MeasureRecord& record = member.record;
+    int style;
+    Arc arc;
+    QVector<QLineF> lines;
+    QRectF rect = layout(record, style, lines, arc);
+
+    bucket.lines[style] += lines;
+    if (arc.radius > 0) {
+        bucket.arcs.append(arc);
+        // Flattened again on the next paint
+        bucket.arcLevel = INT_MIN;
+    }
+    if (record.type == MeasureRecord::Arc) {
+        bucket.markers.append(record.points[0]);
+        bucket.markers.append(record.points[1]);
+        bucket.markers.append(record.points[2]);
+    }
+    if (!member.label.isEmpty()) {
+        const QFontMetricsF& metrics = MeasureGraphicsItem::labelMetrics();
+        const QPointF pos = MeasureGraphicsItem::labelPosition(record);
+        bucket.labels.append(Label{pos, MeasureGraphicsItem::staticLabel(member.label)});
+        rect |= QRectF(pos, QSizeF(metrics.horizontalAdvance(member.label), metrics.height()));
+    }
+    bucket.bounds |= rect;
+    return rect;
+}
+
+void MeasureOverlayItem::rebuild(Bucket& bucket) {
+    // Lines of different measurements are merged per pen, lay out all of them again
+    bucket.bounds = QRectF();
+    for (QVector<QLineF>& lines : bucket.lines) lines.clear();
+    bucket.markers.clear();
+    bucket.labels.clear();
+    bucket.arcs.clear();
+    bucket.arcLines.clear();
+    bucket.arcLevel = INT_MIN;
+    bucket.stale = false;
+    for (const Member& member : bucket.members) {
+        addToBucket(bucket, member);
+    }
+}
+
+void MeasureOverlayItem::insert(int key, const MeasureRecord& record, const QString& label) {
+    int style;
+    Arc arc;
+    QVector<QLineF> lines;
+    const int id = bucketAt(layout(record, style, lines, arc).center());
+    Bucket& bucket = buckets[id];
+    bucket.members.append(Member{key, record, label});
+    // Also into a stale bucket: its bounds must cover the new member before the rebuild
+    const QRectF rect = addToBucket(bucket, bucket.members.last());
+    bucketIndex.insert(id, bucket.bounds);
+    keySlots.insert(key, Slot{id, int(bucket.members.size()) - 1});
+    ++measurementCount;
+    grow(rect);
+}
+
+void MeasureOverlayItem::remove(int key) {
+    auto it = keySlots.find(key);
+    if (it == keySlots.end()) return;
+    const Slot slot = it.value();
+    keySlots.erase(it);
+
+    Bucket& bucket = buckets[slot.bucket];
+    update(bucket.bounds);
+    if (slot.member != bucket.members.size() - 1) {
+        bucket.members[slot.member] = bucket.members.last();
+        keySlots[bucket.members[slot.member].key].member = slot.member;
+    }
+    bucket.members.removeLast();
+    --measurementCount;
+
+    if (bucket.members.isEmpty()) {
+        rebuild(bucket);
+        bucketIndex.remove(slot.bucket);
+    } else {
+        // Until then its drawing and bounds are a superset of what is left
+        bucket.stale = true;
+    }
+}
+
+void MeasureOverlayItem::clear() {
+    if (measurementCount == 0) return;
+    prepareGeometryChange();
+    buckets.clear();
+    bucketCells.clear();
+    keySlots.clear();
+    bucketIndex.clear();
+    bounds = highlightLine.isNull() ? QRectF()
+                                    : QRectF(highlightLine.p1(), highlightLine.p2()).normalized().adjusted(
+                                          -PenMargin, -PenMargin, PenMargin, PenMargin);
+    measurementCount = 0;
+}
+
+void MeasureOverlayItem::setHighlightedLine(const QLineF& line) {
+    if (line == highlightLine) return;
+    const auto lineRect = [](const QLineF& l) {
+        return QRectF(l.p1(), l.p2()).normalized().adjusted(-PenMargin, -PenMargin, PenMargin, PenMargin);
+    };
+    if (!highlightLine.isNull()) update(lineRect(highlightLine));
+    highlightLine = line;
+    if (!highlightLine.isNull()) grow(lineRect(highlightLine));
+}
+
+QRectF MeasureOverlayItem::boundingRect() const {
+    return bounds;
+}
+
+void MeasureOverlayItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    Q_UNUSED(widget);
+    const QRectF exposed = option->exposedRect;
+    const double lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    const int level = MeasureGraphicsItem::lodLevel(lod);
+    visibleBuckets.clear();
+    bucketIndex.query(exposed, [&](int id) {
+        if (buckets[id].bounds.intersects(exposed)) visibleBuckets.append(id);
+    });
+    for (int id : visibleBuckets) {
+        if (buckets[id].stale) {
+            rebuild(buckets[id]);
+            bucketIndex.insert(id, buckets[id].bounds);
+        }
+        if (buckets[id].arcLevel != level) flattenArcs(buckets[id], level);
+    }
+
+    // Pen changes are the expensive part, one per style for the whole repaint
+    painter->setBrush(Qt::NoBrush);
+    for (int style = 0; style < StyleCount; ++style) {
+        painter->setPen(MeasureGraphicsItem::pen(StyleTypes[style]));
+        for (int id : visibleBuckets) {
+            const QVector<QLineF>& lines = buckets[id].lines[style];
+            if (!lines.isEmpty()) painter->drawLines(lines);
+            if (style == ArcStyle && !buckets[id].arcLines.isEmpty()) painter->drawLines(buckets[id].arcLines);
+        }
+    }
+
+    // Round points as wide as the markers of a single arc item
+    painter->setPen(QPen(Qt::green, 2 * MarkerRadius, Qt::SolidLine, Qt::RoundCap));
+    for (int id : visibleBuckets) {
+        const QVector<QPointF>& markers = buckets[id].markers;
+        if (!markers.isEmpty()) painter->drawPoints(markers.constData(), markers.size());
+    }
+
+    if (!highlightLine.isNull()) {
+        painter->setPen(MeasureGraphicsItem::pen(MeasureRecord::Line, true));
+        painter->drawLine(highlightLine);
+    }
+
+    // Zoomed out this far the labels would be unreadable smudges, and most of the cost
+    if (!MeasureGraphicsItem::labelReadable(lod)) return;
+    painter->setFont(MeasureGraphicsItem::labelFont());
+    painter->setPen(Qt::blue);
+    for (int id : visibleBuckets) {
+        for (const Label& label : buckets[id].labels) {
+            painter->drawStaticText(label.pos, label.text);
+        }
+    }
+}
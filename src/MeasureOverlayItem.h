@@ -0,0 +1,103 @@
+#ifndef MEASUREOVERLAYITEM_H
+#define MEASUREOVERLAYITEM_H
+
+#include <QGraphicsItem>
+#include <QHash>
+#include <QLineF>
+#include <QStaticText>
+#include <QString>
+#include <QVector>
+#include "MeasureRecord.h"
+#include "SpatialIndex.h"
+
+// Any number of finished measurements drawn by one scene item. Their geometry
+// is flattened into line lists, one per pen, kept in the buckets of a coarse
+// grid. A repaint looks up the buckets touching the exposed rect and issues
+// one drawLines() per pen and bucket, so its cost follows what is on screen
+// and not how many measurements exist. Arcs are flattened per bucket for the
+// current zoom level, and labels too small to read are not drawn at all.
+class MeasureOverlayItem : public QGraphicsItem {
+public:
+    // Scene units; measurements go to the bucket holding the centre of their bounds
+    static constexpr double BucketSize = 512.0;
+
+    MeasureOverlayItem(QGraphicsItem* parent = nullptr);
+
+    // key identifies the measurement for remove(), e.g. its index in the scene
+    void insert(int key, const MeasureRecord& record, const QString& label);
+    // Constant time: the bucket that held it is only laid out again when it
+    // is next painted, so a drag moving many measurements stays cheap
+    void remove(int key);
+    void clear();
+    int count() const { return measurementCount; }
+
+    // Drawn on top in the selection colour, e.g. the line picked for a distance;
+    // a null line for none
+    void setHighlightedLine(const QLineF& line);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+    // One line list per pen; fitted arcs share the arc pen
+    enum Style { LineStyle, DistanceStyle, AngleStyle, ArcStyle, StyleCount };
+
+    struct Label {
+        QPointF pos; // top left
+        QStaticText text;
+    };
+
+    struct Arc {
+        QPointF center;
+        double radius;
+        double start; // degrees, see Geometry::arcAngles
+        double span;
+    };
+
+    struct Member {
+        int key;
+        MeasureRecord record;
+        QString label;
+    };
+
+    struct Bucket {
+        QRectF bounds; // everything drawn from it, labels included
+        QVector<Member> members;
+        QVector<QLineF> lines[StyleCount];
+        QVector<QPointF> markers;
+        QVector<Label> labels;
+        QVector<Arc> arcs;
+        // arcs flattened for zoom level arcLevel (see MeasureGraphicsItem::lodLevel)
+        QVector<QLineF> arcLines;
+        int arcLevel;
+        bool stale; // the drawing still holds removed members
+    };
+
+    struct Slot {
+        int bucket;
+        int member;
+    };
+
+    void flattenArcs(Bucket& bucket, int level);
+    // Lines and arc (radius 0 for none) of record in style; returns their bounds
+    static QRectF layout(const MeasureRecord& record, int& style, QVector<QLineF>& lines, Arc& arc);
+    // Adds the drawing of member to the bucket; returns its bounds
+    QRectF addToBucket(Bucket& bucket, const Member& member);
+    // Drawing of the bucket from its members alone
+    void rebuild(Bucket& bucket);
+
+    int bucketAt(const QPointF& pos);
+    void grow(const QRectF& rect);
+
+    QVector<Bucket> buckets;
+    QHash<quint64, int> bucketCells; // grid cell -> index into buckets
+    QHash<int, Slot> keySlots;       // measurement key -> its bucket and member
+    SpatialIndex bucketIndex;        // by bucket bounds, which may overhang their cell
+    QVector<int> visibleBuckets;     // reused by paint()
+    QVector<QPointF> arcPoints;      // reused by flattenArcs()
+    QLineF highlightLine;
+    QRectF bounds;
+    int measurementCount;
+};
+
+#endif // MEASUREOVERLAYITEM_H
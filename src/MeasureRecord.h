@@ -0,0 +1,24 @@
+#ifndef MEASURERECORD_H
+#define MEASURERECORD_H
+
+#include <QPointF>
+
+// Geometry of one measurement as plain data; the label and the scene item
+// are derived from it. Trivially copyable, no allocation.
+struct MeasureRecord {
+    // Also the type codes of the project file
+    enum Type : quint8 { Line = 0, Arc = 1, Distance = 2, Angle = 3, FittedArc = 4 };
+
+    quint8 type = Line;
+    quint8 pointCount = 0; // 2 for lines and distances, 3 otherwise
+    bool dirty = true;     // derived values below need solving
+    // Line: ends; Arc: start, middle, end; Distance: point, its projection;
+    // Angle: start, vertex, end; FittedArc: first, middle and last traced point
+    QPointF points[3];
+
+    QPointF center;        // arcs
+    double valuePx = 0;    // length / radius / distance in px, angle in degrees
+    double residualPx = 0; // fitted arcs: rms distance of the traced points from the circle
+};
+
+#endif // MEASURERECORD_H
@@ -0,0 +1,255 @@
+// Replays an input log written by InputRecorder against an offscreen canvas
+// and reports how long each event took to handle, including the preview and
+// the view frames it caused:
+//
+//   MeasureReplay session.jsonl [--realtime] [-o latency.csv]
+//
+// Without --realtime the events are sent back to back, which measures the
+// cost of the work alone; with it they keep their recorded spacing so timers
+// and frame coalescing behave as they did in the session.
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMouseEvent>
+#include <QScrollBar>
+#include <QThread>
+#include <QUndoStack>
+#include <QWheelEvent>
+#include <algorithm>
+#include <clocale>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "CanvasScene.h"
+#include "CanvasView.h"
+#include "InputRecorder.h"
+#include "PerfHud.h"
+
+namespace {
+
+struct Sample {
+    qint64 t;
+    std::string type;
+    qint64 ns;
+};
+
+Qt::KeyboardModifiers modifiers(const QJsonObject& e) {
+    return Qt::KeyboardModifiers(e.value("mods").toInt());
+}
+
+Qt::MouseButtons buttons(const QJsonObject& e) {
+    return Qt::MouseButtons(e.value("buttons").toInt());
+}
+
+QPointF position(const QJsonObject& e) {
+    return QPointF(e.value("x").toDouble(), e.value("y").toDouble());
+}
+
+void sendMouse(QWidget* viewport, QEvent::Type type, const QJsonObject& e) {
+    const QPointF local = position(e);
+    QMouseEvent event(type, local, viewport->mapToGlobal(local), Qt::MouseButton(e.value("button").toInt()),
+                      buttons(e), modifiers(e));
+    QCoreApplication::sendEvent(viewport, &event);
+}
+
+void sendWheel(QWidget* viewport, const QJsonObject& e) {
+    const QPointF local = position(e);
+    const QPoint pixelDelta(e.value("px").toInt(), e.value("py").toInt());
+    const QPoint angleDelta(e.value("dx").toInt(), e.value("dy").toInt());
+    QWheelEvent event(local, viewport->mapToGlobal(local), pixelDelta, angleDelta, buttons(e), modifiers(e),
+                      Qt::NoScrollPhase, false);
+    QCoreApplication::sendEvent(viewport, &event);
+}
+
+void applyProfile(CanvasView& view, CanvasScene& scene, bool interactive) {
+    const RenderSettings settings = interactive ? RenderSettings::interactive() : RenderSettings::quality();
+    view.setRenderSettings(settings);
+    scene.setImageCaching(settings.cacheImage);
+}
+
+// Applies one logged event; false for an event type this build does not know
+bool apply(CanvasView& view, CanvasScene& scene, const QString& type, const QJsonObject& e) {
+    QWidget* viewport = view.viewport();
+    if (type == "press") {
+        sendMouse(viewport, QEvent::MouseButtonPress, e);
+    } else if (type == "dblclick") {
+        sendMouse(viewport, QEvent::MouseButtonDblClick, e);
+    } else if (type == "move") {
+        sendMouse(viewport, QEvent::MouseMove, e);
+    } else if (type == "release") {
+        sendMouse(viewport, QEvent::MouseButtonRelease, e);
+    } else if (type == "wheel") {
+        sendWheel(viewport, e);
+    } else if (type == "resize") {
+        view.resize(e.value("width").toInt(), e.value("height").toInt());
+    } else if (type == "mode") {
+        scene.setMode(ToolMode(e.value("mode").toInt()));
+    } else if (type == "scale") {
+        scene.changeScaleRatio(e.value("value").toDouble());
+    } else if (type == "snap") {
+        scene.setEdgeSnapping(e.value("on").toBool());
+    } else if (type == "batched") {
+        scene.setBatchedRendering(e.value("on").toBool());
+    } else if (type == "clear") {
+        scene.clearMeasurements();
+    } else if (type == "undo") {
+        scene.undoStack()->undo();
+    } else if (type == "redo") {
+        scene.undoStack()->redo();
+    } else if (type == "detect") {
+        // Runs in the background in the session too; seeded, so the same features come back
+        QEventLoop loop;
+        QObject::connect(&scene, &CanvasScene::detectionFinished, &loop, &QEventLoop::quit);
+        if (scene.detectFeatures()) loop.exec();
+    } else if (type == "profile") {
+        applyProfile(view, scene, e.value("interactive").toBool());
+    } else if (type == "enhance") {
+        scene.setEnhancement(InputRecorder::enhancementFromJson(e));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Runs everything the event queued: coalesced frames, the pending preview and the repaint
+void settle(CanvasView& view, CanvasScene& scene) {
+    view.flushFrames();
+    scene.flushPreview();
+    QCoreApplication::processEvents();
+}
+
+double percentile(std::vector<qint64>& sorted, double p) {
+    const size_t i = std::min(sorted.size() - 1, size_t(p * double(sorted.size() - 1) + 0.5));
+    return double(sorted[i]) / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("MeasureReplay");
+    std::setlocale(LC_NUMERIC, "C");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("离屏回放录制的操作并统计每个事件的处理延迟");
+    parser.addHelpOption();
+    parser.addPositionalArgument("log", "InputRecorder 录制的 .jsonl 文件");
+    QCommandLineOption realtimeOption("realtime", "按录制时的时间间隔发送事件");
+    QCommandLineOption outputOption({"o", "output"}, "逐事件延迟 CSV 文件", "file");
+    parser.addOption(realtimeOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.isEmpty()) {
+        parser.showHelp(1);
+    }
+    QFile log(args.first());
+    if (!log.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        std::fprintf(stderr, "cannot open %s\n", qPrintable(args.first()));
+        return 1;
+    }
+
+    const QJsonObject header = QJsonDocument::fromJson(log.readLine()).object();
+    if (header.value("format").toString() != "measure-input" || header.value("version").toInt() > InputRecorder::Version) {
+        std::fprintf(stderr, "not a supported input log\n");
+        return 1;
+    }
+
+    CanvasScene scene;
+    CanvasView view(&scene);
+    const QString project = QFileInfo(log.fileName()).dir().filePath(header.value("project").toString());
+    if (!scene.openProject(project)) {
+        std::fprintf(stderr, "cannot open project %s\n", qPrintable(project));
+        return 1;
+    }
+    while (scene.isLoading()) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents | QEventLoop::WaitForMoreEvents, 50);
+    }
+    scene.setMode(ToolMode(header.value("mode").toInt()));
+    scene.setEdgeSnapping(header.value("snap").toBool());
+    scene.setBatchedRendering(header.value("batched").toBool());
+    scene.setEnhancement(InputRecorder::enhancementFromJson(header.value("enhance").toObject()));
+
+    const QJsonObject viewState = header.value("view").toObject();
+    view.resize(viewState.value("width").toInt(), viewState.value("height").toInt());
+    applyProfile(view, scene, header.value("interactive").toBool());
+    view.show();
+    const QJsonArray t = viewState.value("transform").toArray();
+    view.setTransform(QTransform(t.at(0).toDouble(), t.at(1).toDouble(), t.at(2).toDouble(), t.at(3).toDouble(),
+                                 t.at(4).toDouble(), t.at(5).toDouble()));
+    const QJsonArray scroll = viewState.value("scroll").toArray();
+    view.horizontalScrollBar()->setValue(scroll.at(0).toInt());
+    view.verticalScrollBar()->setValue(scroll.at(1).toInt());
+    settle(view, scene);
+
+    const bool realtime = parser.isSet(realtimeOption);
+    std::vector<Sample> samples;
+    const qint64 startNs = PerfHud::now();
+    int skipped = 0;
+    while (!log.atEnd()) {
+        const QByteArray line = log.readLine().trimmed();
+        if (line.isEmpty()) continue;
+        const QJsonObject e = QJsonDocument::fromJson(line).object();
+        const QString type = e.value("e").toString();
+        const qint64 at = qint64(e.value("t").toDouble());
+        if (realtime) {
+            // Let the timers of the previous events fire as they would have
+            while (PerfHud::now() - startNs < at) {
+                QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+                QThread::usleep(200);
+            }
+        }
+
+        const qint64 begin = PerfHud::now();
+        if (!apply(view, scene, type, e)) {
+            ++skipped;
+            continue;
+        }
+        settle(view, scene);
+        samples.push_back(Sample{at, type.toStdString(), PerfHud::now() - begin});
+    }
+
+    if (parser.isSet(outputOption)) {
+        QFile out(parser.value(outputOption));
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            std::fprintf(stderr, "cannot open %s\n", qPrintable(out.fileName()));
+            return 1;
+        }
+        out.write("t_ms,event,latency_ms\n");
+        for (const Sample& s : samples) {
+            out.write(QString("%1,%2,%3\n")
+                          .arg(double(s.t) / 1e6, 0, 'f', 3)
+                          .arg(QString::fromStdString(s.type))
+                          .arg(double(s.ns) / 1e6, 0, 'f', 3)
+                          .toUtf8());
+        }
+    }
+
+    std::map<std::string, std::vector<qint64>> byType;
+    for (const Sample& s : samples) {
+        byType[s.type].push_back(s.ns);
+        byType["all"].push_back(s.ns);
+    }
+    std::printf("%-10s %8s %10s %10s %10s %10s\n", "event", "count", "p50 ms", "p95 ms", "p99 ms", "max ms");
+    for (auto& [type, values] : byType) {
+        std::sort(values.begin(), values.end());
+        std::printf("%-10s %8zu %10.3f %10.3f %10.3f %10.3f\n", type.c_str(), values.size(), percentile(values, 0.50),
+                    percentile(values, 0.95), percentile(values, 0.99), double(values.back()) / 1e6);
+    }
+    if (skipped > 0) {
+        std::fprintf(stderr, "%d unknown events skipped\n", skipped);
+    }
+    return 0;
+}
@@ -0,0 +1,327 @@
+// Benchmarks for the hot paths of the editor, built when Google Benchmark is
+// found. Runs offscreen; compare builds through the JSON report:
+//
+//   MeasureToolBench --benchmark_out=bench.json --benchmark_out_format=json
+//
+// Every case uses fixed seeds so two runs measure the same work.
+
+#include <benchmark/benchmark.h>
+#include <QApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+#include "CanvasScene.h"
+#include "CanvasView.h"
+#include "Geometry.h"
+#include "ImageEnhancer.h"
+#include "MeasureRecord.h"
+
+namespace {
+
+const QSize ImageSize(4096, 4096);
+const double SceneExtent = 4096;
+
+struct Triple {
+    QPointF p1, p2, p3;
+};
+
+// Three points on a random circle inside the scene, in drawing order
+std::vector<Triple> randomArcs(int count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> pos(0, SceneExtent);
+    std::uniform_real_distribution<double> radius(10, 400);
+    std::uniform_real_distribution<double> angle(0, 2 * PI);
+    std::vector<Triple> arcs(count);
+    for (Triple& t : arcs) {
+        const QPointF c(pos(rng), pos(rng));
+        const double r = radius(rng);
+        const double a = angle(rng);
+        const double step = 0.5 + angle(rng) / 8;
+        auto at = [&](double phi) { return c + QPointF(r * std::cos(phi), r * std::sin(phi)); };
+        t = Triple{at(a), at(a + step), at(a + 2 * step)};
+    }
+    return arcs;
+}
+
+// Scene with count measurements of every type, mostly lines as in real sessions
+void fillScene(CanvasScene& scene, int count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> pos(0, SceneExtent);
+    std::uniform_real_distribution<double> offset(-60, 60);
+    const std::vector<Triple> arcs = randomArcs(count, seed + 1);
+    for (int i = 0; i < count; ++i) {
+        const Triple& arc = arcs[size_t(i)];
+        const QPointF start(pos(rng), pos(rng));
+        const QPointF end = start + QPointF(offset(rng), offset(rng));
+        const QPointF third = start + QPointF(offset(rng), offset(rng));
+        switch (i % 8) {
+        case 0: {
+            const QPointF pts[3] = {arc.p1, arc.p2, arc.p3};
+            scene.appendMeasurement(MeasureRecord::Arc, pts, 3);
+            break;
+        }
+        case 1: {
+            const QPointF pts[3] = {end, start, third};
+            scene.appendMeasurement(MeasureRecord::Angle, pts, 3);
+            break;
+        }
+        case 2: {
+            const QPointF pts[2] = {third, Geometry::projectOntoLine(start, end, third)};
+            scene.appendMeasurement(MeasureRecord::Distance, pts, 2);
+            break;
+        }
+        default: {
+            const QPointF pts[2] = {start, end};
+            scene.appendMeasurement(MeasureRecord::Line, pts, 2);
+            break;
+        }
+        }
+    }
+}
+
+// Waits for CanvasScene::imageLoaded; false on a load error or after 60 s
+bool waitForImage(CanvasScene& scene, const std::function<void()>& load) {
+    bool loaded = false;
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&scene, &CanvasScene::imageLoaded, &loop, [&]() {
+        loaded = true;
+        loop.quit();
+    });
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    load();
+    if (!loaded) {
+        timeout.start(60000);
+        loop.exec();
+    }
+    return loaded;
+}
+
+// Test images of every supported format, written once per run
+class ImageFiles {
+public:
+    static ImageFiles& instance() {
+        static ImageFiles files;
+        return files;
+    }
+
+    QString path(const char* suffix) const { return dir.filePath(QString("bench.") + suffix); }
+    RawImageFormat rawFormat() const {
+        RawImageFormat format;
+        format.width = ImageSize.width();
+        format.height = ImageSize.height();
+        format.bitsPerPixel = 16;
+        return format;
+    }
+
+private:
+    ImageFiles() {
+        QImage image(ImageSize, QImage::Format_RGB32);
+        std::mt19937 rng(7);
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                const int v = ((x ^ y) & 0xff) / 2 + int(rng() % 64);
+                line[x] = qRgb(v, v, v);
+            }
+        }
+        image.save(path("png"));
+        image.save(path("jpg"), nullptr, 90);
+        image.save(path("bmp"));
+
+        QFile raw(path("raw"));
+        raw.open(QIODevice::WriteOnly);
+        QVector<quint16> row(image.width());
+        for (int y = 0; y < image.height(); ++y) {
+            const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                row[x] = quint16(qGray(line[x]) << 4);
+            }
+            raw.write(reinterpret_cast<const char*>(row.constData()), row.size() * 2);
+        }
+    }
+
+    QTemporaryDir dir;
+};
+
+} // namespace
+
+static void BM_Circumcircle(benchmark::State& state) {
+    const std::vector<Triple> arcs = randomArcs(4096, 1);
+    size_t i = 0;
+    for (auto _ : state) {
+        const Triple& t = arcs[i++ & 4095];
+        QPointF center;
+        double radius;
+        benchmark::DoNotOptimize(Geometry::circumcircle(t.p1, t.p2, t.p3, center, radius));
+        benchmark::DoNotOptimize(radius);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Circumcircle);
+
+// What an arc item does on layout and on a zoom level change
+static void BM_ArcFlatten(benchmark::State& state) {
+    const std::vector<Triple> arcs = randomArcs(4096, 2);
+    const double screenScale = double(state.range(0)) / 100;
+    std::vector<QPointF> points;
+    size_t i = 0;
+    for (auto _ : state) {
+        const Triple& t = arcs[i++ & 4095];
+        QPointF center;
+        double radius, start, span;
+        Geometry::circumcircle(t.p1, t.p2, t.p3, center, radius);
+        Geometry::arcAngles(center, t.p1, t.p2, t.p3, start, span);
+        const int segments = Geometry::arcSegments(radius * screenScale, span, 0.25);
+        points.resize(size_t(segments) + 1);
+        Geometry::flattenArc(center, radius, start, span, segments, points.data());
+        benchmark::DoNotOptimize(points.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// View scale in percent
+BENCHMARK(BM_ArcFlatten)->Arg(5)->Arg(100)->Arg(2000);
+
+// A scale change relabels every measurement
+static void BM_UpdateMeasurements(benchmark::State& state) {
+    CanvasScene scene;
+    scene.setBatchedRendering(state.range(1) != 0);
+    fillScene(scene, int(state.range(0)), 3);
+    double scale = 10;
+    for (auto _ : state) {
+        scale = scale == 10 ? 12.5 : 10;
+        scene.setScaleRatio(scale);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdateMeasurements)
+    ->ArgNames({"items", "batched"})
+    ->ArgsProduct({{1000, 10000, 100000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// The line pick of Distance mode, 5 screen pixels at 100 %
+static void BM_DistancePick(benchmark::State& state) {
+    CanvasScene scene;
+    fillScene(scene, int(state.range(0)), 4);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> pos(0, SceneExtent);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(scene.nearestMeasurement(QPointF(pos(rng), pos(rng)), 5, MeasureRecord::Line));
+    }
+}
+BENCHMARK(BM_DistancePick)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// The same pick through QGraphicsScene's own index, for comparison
+static void BM_SceneItemsAt(benchmark::State& state) {
+    CanvasScene scene;
+    fillScene(scene, int(state.range(0)), 4);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> pos(0, SceneExtent);
+    for (auto _ : state) {
+        const QPointF p(pos(rng), pos(rng));
+        benchmark::DoNotOptimize(scene.items(QRectF(p.x() - 5, p.y() - 5, 10, 10)).size());
+    }
+}
+BENCHMARK(BM_SceneItemsAt)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// One full repaint of a 1280x800 view, zoomed to fit or to 100 %
+static void BM_RenderView(benchmark::State& state) {
+    CanvasScene scene;
+    scene.setBatchedRendering(state.range(1) != 0);
+    fillScene(scene, int(state.range(0)), 6);
+    CanvasView view(&scene);
+    view.resize(1280, 800);
+    view.setSceneRect(0, 0, SceneExtent, SceneExtent);
+    if (state.range(2) != 0) {
+        view.fitInView(view.sceneRect(), Qt::KeepAspectRatio);
+    } else {
+        view.centerOn(SceneExtent / 2, SceneExtent / 2);
+    }
+
+    QImage target(view.size(), QImage::Format_ARGB32_Premultiplied);
+    for (auto _ : state) {
+        QPainter painter(&target);
+        view.render(&painter);
+    }
+}
+BENCHMARK(BM_RenderView)
+    ->ArgNames({"items", "batched", "fit"})
+    ->ArgsProduct({{1000, 100000}, {0, 1}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// Until CanvasScene::imageLoaded; the preview of a JPEG is not waited for
+static void BM_LoadImage(benchmark::State& state, const char* suffix) {
+    ImageFiles& files = ImageFiles::instance();
+    const QString path = files.path(suffix);
+    CanvasScene scene;
+    for (auto _ : state) {
+        const bool loaded = waitForImage(scene, [&]() {
+            if (path.endsWith(".raw")) {
+                scene.loadRawImage(path, files.rawFormat());
+            } else {
+                scene.loadImage(path);
+            }
+        });
+        if (!loaded) {
+            state.SkipWithError("image did not load");
+            break;
+        }
+    }
+}
+BENCHMARK_CAPTURE(BM_LoadImage, png, "png")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_LoadImage, jpg, "jpg")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_LoadImage, bmp, "bmp")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_LoadImage, raw, "raw")->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// One 256 x 256 display tile right after a slider moved: 0 levels and gamma,
+// 1 plus CLAHE, 2 plus the unsharp mask
+static void BM_EnhanceTile(benchmark::State& state) {
+    static const auto source = [] {
+        QImage image(2048, 2048, QImage::Format_RGB32);
+        std::mt19937 rng(11);
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                const int v = 96 + ((x / 64 + y / 64) & 1) * 32 + int(rng() % 16);
+                line[x] = qRgb(v, v, v);
+            }
+        }
+        return std::make_shared<PyramidImageSource>(image, 256);
+    }();
+    EnhanceSettings settings;
+    settings.black = 80;
+    settings.white = 160;
+    settings.gamma = 1.4;
+    if (state.range(0) >= 1) settings.claheClip = 3.0;
+    if (state.range(0) >= 2) settings.sharpenAmount = 1.5;
+    const QRect tile(768, 768, 256, 256);
+    for (auto _ : state) {
+        // A new enhancer per step, as for every new slider position
+        ImageEnhancer enhancer(source, settings);
+        benchmark::DoNotOptimize(enhancer.tile(0, tile));
+    }
+    state.SetItemsProcessed(state.iterations() * tile.width() * tile.height());
+}
+BENCHMARK(BM_EnhanceTile)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char* argv[]) {
+    // No display needed, and the numbers do not depend on a window manager
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "PerfHud.h"
+#include <QElapsedTimer>
+#include <algorithm>
+
+bool PerfHud::enabled = false;
+PerfHud::Samples PerfHud::samples[PerfHud::ChannelCount];
+qint64 PerfHud::gauges[PerfHud::GaugeCount] = {};
+qint64 PerfHud::inputSince = -1;
+
+void PerfHud::setEnabled(bool on) {
+    enabled = on;
+    // Stale samples would skew the first percentiles after switching back on
+    for (Samples& channel : samples) {
+        channel.next = 0;
+        channel.count = 0;
+    }
+    inputSince = -1;
+}
+
+qint64 PerfHud::now() {
+    static const QElapsedTimer clock = [] {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.nsecsElapsed();
+}
+
+void PerfHud::record(Channel channel, qint64 ns) {
+    Samples& s = samples[channel];
+    s.ns[s.next] = ns;
+    s.next = (s.next + 1) % Window;
+    s.count = qMin(s.count + 1, Window);
+}
+
+PerfHud::Percentiles PerfHud::percentiles(Channel channel) {
+    const Samples& s = samples[channel];
+    Percentiles result;
+    result.samples = s.count;
+    if (s.count == 0) return result;
+
+    qint64 sorted[Window];
+    std::copy(s.ns, s.ns + s.count, sorted);
+    std::sort(sorted, sorted + s.count);
+    auto at = [&](double q) { return sorted[qMin(s.count - 1, int(q * s.count))] / 1e6; };
+    result.p50 = at(0.50);
+    result.p95 = at(0.95);
+    result.p99 = at(0.99);
+    return result;
+}
+
+const char* PerfHud::channelName(Channel channel) {
+    static const char* const names[ChannelCount] = {"绘制", "输入延迟", "预览更新", "测量更新", "图片加载"};
+    return names[channel];
+}
+
+void PerfHud::markInput() {
+    if (enabled && inputSince < 0) inputSince = now();
+}
+
+void PerfHud::markPainted() {
+    if (inputSince < 0) return;
+    record(InputLatency, now() - inputSince);
+    inputSince = -1;
+}
@@ -0,0 +1,68 @@
+#ifndef PERFHUD_H
+#define PERFHUD_H
+
+#include <QtGlobal>
+
+// Timings behind the performance overlay of CanvasView. Every channel keeps
+// its last Window samples for rolling percentiles. Nothing is recorded while
+// the overlay is off; a ScopedTimer then costs one branch.
+class PerfHud {
+public:
+    enum Channel { Paint, InputLatency, Preview, Measurements, ImageLoad, ChannelCount };
+    enum Gauge { TileCacheKB, GaugeCount };
+    static constexpr int Window = 256;
+
+    struct Percentiles {
+        double p50 = 0, p95 = 0, p99 = 0; // ms
+        int samples = 0;
+    };
+
+    static bool isEnabled() { return enabled; }
+    static void setEnabled(bool on);
+
+    // Monotonic clock, ns
+    static qint64 now();
+    static void record(Channel channel, qint64 ns);
+    static Percentiles percentiles(Channel channel);
+    static const char* channelName(Channel channel);
+
+    // Gauges are kept up to date whether the overlay is shown or not
+    static void addToGauge(Gauge gauge, qint64 delta) { gauges[gauge] += delta; }
+    static qint64 gauge(Gauge gauge) { return gauges[gauge]; }
+
+    // Input to paint latency: the first input since the last paint starts the
+    // clock, the next paint stops it
+    static void markInput();
+    static void markPainted();
+    static void discardInput() { inputSince = -1; }
+
+private:
+    struct Samples {
+        qint64 ns[Window];
+        int next = 0;
+        int count = 0;
+    };
+
+    static bool enabled;
+    static Samples samples[ChannelCount];
+    static qint64 gauges[GaugeCount];
+    static qint64 inputSince; // -1 while no input waits for a paint
+};
+
+// Records the lifetime of the scope into a channel
+class ScopedTimer {
+public:
+    explicit ScopedTimer(PerfHud::Channel channel)
+        : channel(channel), start(PerfHud::isEnabled() ? PerfHud::now() : -1) {}
+    ~ScopedTimer() {
+        if (start >= 0) PerfHud::record(channel, PerfHud::now() - start);
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    PerfHud::Channel channel;
+    qint64 start;
+};
+
+#endif // PERFHUD_H
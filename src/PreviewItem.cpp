@@ -0,0 +1,108 @@
+#include "PreviewItem.h"
+#include "Geometry.h"
+#include <QPainter>
+
+PreviewItem::PreviewItem(QGraphicsItem* parent)
+    : QGraphicsItem(parent), shape(Shape::None), count(0), arcStart(0), arcSpan(0), handleRadius(0), pen(Qt::DashLine) {
+    setZValue(1000); // above every measurement
+}
+
+void PreviewItem::setBounds(const QRectF& rect) {
+    // Margin for the pen; prepareGeometryChange() repaints the old area, the
+    // scene picks up the new one, nothing outside the two is invalidated
+    const QRectF next = rect.adjusted(-2, -2, 2, 2);
+    if (next != bounds) {
+        prepareGeometryChange();
+        bounds = next;
+    }
+    update();
+}
+
+void PreviewItem::clear() {
+    if (shape == Shape::None) return;
+    shape = Shape::None;
+    count = 0;
+    setBounds(QRectF());
+}
+
+void PreviewItem::setPolyline(const QPointF* pts, int n) {
+    count = qMin(n, int(MaxPoints));
+    qreal left = pts[0].x(), right = left, top = pts[0].y(), bottom = top;
+    for (int i = 0; i < count; ++i) {
+        points[i] = pts[i];
+        left = qMin(left, pts[i].x());
+        right = qMax(right, pts[i].x());
+        top = qMin(top, pts[i].y());
+        bottom = qMax(bottom, pts[i].y());
+    }
+    shape = Shape::Polyline;
+    setBounds(QRectF(left, top, right - left, bottom - top));
+}
+
+void PreviewItem::setArc(const QPointF& p1, const QPointF& p2, const QPointF& p3) {
+    QPointF center;
+    double r;
+    if (!Geometry::circumcircle(p1, p2, p3, center, r)) {
+        const QPointF pts[3] = {p1, p2, p3};
+        setPolyline(pts, 3);
+        return;
+    }
+    double start, span;
+    Geometry::arcAngles(center, p1, p2, p3, start, span);
+
+    points[0] = p1;
+    points[1] = p2;
+    points[2] = p3;
+    count = 3;
+    arcRect = QRectF(center.x() - r, center.y() - r, 2 * r, 2 * r);
+    arcStart = qRound(start * 16);
+    arcSpan = qRound(span * 16);
+    shape = Shape::Arc;
+    setBounds(Geometry::arcBounds(center, r, start, span));
+}
+
+void PreviewItem::setCircle(const QPointF& center, double radius) {
+    count = 0;
+    arcRect = QRectF(center.x() - radius, center.y() - radius, 2 * radius, 2 * radius);
+    shape = Shape::Circle;
+    setBounds(arcRect);
+}
+
+void PreviewItem::setHandles(const QPointF* pts, int n, double radius) {
+    count = qMin(n, int(MaxPoints));
+    QRectF rect;
+    for (int i = 0; i < count; ++i) {
+        points[i] = pts[i];
+        rect |= QRectF(pts[i].x() - radius, pts[i].y() - radius, 2 * radius, 2 * radius);
+    }
+    handleRadius = radius;
+    shape = Shape::Handles;
+    setBounds(rect);
+}
+
+QRectF PreviewItem::boundingRect() const {
+    return bounds;
+}
+
+void PreviewItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+    if (shape == Shape::None) return;
+
+    painter->setPen(pen);
+    painter->setBrush(Qt::NoBrush);
+    if (shape == Shape::Arc) {
+        painter->drawArc(arcRect, arcStart, arcSpan);
+    } else if (shape == Shape::Circle) {
+        painter->drawEllipse(arcRect);
+    } else if (shape == Shape::Handles) {
+        painter->setPen(QPen(Qt::white, 0));
+        painter->setBrush(QColor(0, 120, 215));
+        for (int i = 0; i < count; ++i) {
+            painter->drawRect(QRectF(points[i].x() - handleRadius, points[i].y() - handleRadius,
+                                     2 * handleRadius, 2 * handleRadius));
+        }
+    } else {
+        painter->drawPolyline(points, count);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef PREVIEWITEM_H
+#define PREVIEWITEM_H
+
+#include <QGraphicsItem>
+#include <QPen>
+
+// Rubber-band shown while a measurement is being placed. Geometry lives in
+// fixed storage and is painted directly, so moving the mouse never builds a
+// QPainterPath or allocates.
+class PreviewItem : public QGraphicsItem {
+public:
+    static constexpr int MaxPoints = 3;
+
+    PreviewItem(QGraphicsItem* parent = nullptr);
+
+    void setPolyline(const QPointF* points, int count);
+    // Arc from p1 through p2 to p3, falls back to a polyline when collinear
+    void setArc(const QPointF& p1, const QPointF& p2, const QPointF& p3);
+    void setCircle(const QPointF& center, double radius);
+    // Grab handles on the points of a measurement, squares of half size radius
+    void setHandles(const QPointF* points, int count, double radius);
+    void clear();
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+    enum class Shape { None, Polyline, Arc, Circle, Handles };
+
+    void setBounds(const QRectF& rect);
+
+    Shape shape;
+    QPointF points[MaxPoints];
+    int count;
+    QRectF arcRect; // also the circle
+    int arcStart; // 1/16 degree, as QPainter::drawArc expects
+    int arcSpan;
+    double handleRadius;
+    QRectF bounds;
+    QPen pen;
+};
+
+#endif // PREVIEWITEM_H
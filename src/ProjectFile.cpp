@@ -0,0 +1,316 @@
+#include "ProjectFile.h"
+#include "MeasureRecord.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const char Magic[8] = {'M', 'E', 'A', 'S', 'P', 'R', 'O', 'J'};
+const int HeaderSize = 64;
+const int TypeCount = 5;
+const char* const TypeNames[TypeCount] = {"line", "arc", "distance", "angle", "arc_fit"};
+const quint32 MinPoints[TypeCount] = {2, 3, 2, 3, 3};
+
+qint64 align8(qint64 offset) {
+    return (offset + 7) & ~qint64(7);
+}
+
+// Block offsets, derived from the counts in the header
+struct Layout {
+    qint64 path, types, offsets, xs, ys, parents, end;
+
+    Layout(quint64 count, quint64 points, quint32 pathBytes, quint32 version) {
+        path = HeaderSize;
+        types = align8(path + pathBytes);
+        offsets = align8(types + qint64(count));
+        xs = align8(offsets + 4 * qint64(count + 1));
+        ys = xs + 8 * qint64(points);
+        parents = ys + 8 * qint64(points);
+        end = version >= 2 ? align8(parents + 4 * qint64(count)) : parents;
+    }
+};
+
+void setError(QString* error, const QString& message) {
+    if (error) *error = message;
+}
+
+} // namespace
+
+std::shared_ptr<ProjectFile> ProjectFile::open(const QString& path, QString* error) {
+    std::shared_ptr<ProjectFile> project(new ProjectFile);
+    project->file.setFileName(path);
+    if (!project->file.open(QIODevice::ReadOnly)) {
+        setError(error, project->file.errorString());
+        return nullptr;
+    }
+    const qint64 size = project->file.size();
+    const uchar* bytes = size > 0 ? project->file.map(0, size) : nullptr;
+    if (!bytes) {
+        setError(error, "文件为空或无法映射");
+        return nullptr;
+    }
+    if (!project->parse(bytes, size, error)) {
+        return nullptr;
+    }
+    return project;
+}
+
+std::shared_ptr<ProjectFile> ProjectFile::fromData(const ProjectData& data) {
+    std::shared_ptr<ProjectFile> project(new ProjectFile);
+    project->buffer = serialize(data);
+    project->parse(reinterpret_cast<const uchar*>(project->buffer.constData()), project->buffer.size(), nullptr);
+    return project;
+}
+
+bool ProjectFile::parse(const uchar* bytes, qint64 size, QString* error) {
+    if (size < HeaderSize || std::memcmp(bytes, Magic, sizeof(Magic)) != 0) {
+        setError(error, "不是测量项目文件");
+        return false;
+    }
+    const quint32 version = qFromLittleEndian<quint32>(bytes + 8);
+    if (version > Version) {
+        setError(error, QString("项目文件版本 %1 过新").arg(version));
+        return false;
+    }
+    const quint32 headerSize = qFromLittleEndian<quint32>(bytes + 12);
+    scale = qFromLittleEndian<double>(bytes + 16);
+    measurementCount = qFromLittleEndian<quint64>(bytes + 24);
+    const quint64 points = qFromLittleEndian<quint64>(bytes + 32);
+    raw.width = int(qFromLittleEndian<quint32>(bytes + 40));
+    raw.height = int(qFromLittleEndian<quint32>(bytes + 44));
+    raw.bitsPerPixel = int(qFromLittleEndian<quint32>(bytes + 48));
+    const quint32 pathBytes = qFromLittleEndian<quint32>(bytes + 52);
+    raw.headerBytes = qint64(qFromLittleEndian<quint64>(bytes + 56));
+
+    // Counts come from the file, bound them before any offset arithmetic
+    if (headerSize != HeaderSize || !(scale > 0) || measurementCount > quint64(size)
+        || points > quint64(size) / 8 || pathBytes > quint64(size)) {
+        setError(error, "项目文件头损坏");
+        return false;
+    }
+    const Layout layout(measurementCount, points, pathBytes, version);
+    if (layout.end > size) {
+        setError(error, "项目文件被截断");
+        return false;
+    }
+
+    image = QString::fromUtf8(reinterpret_cast<const char*>(bytes + layout.path), int(pathBytes));
+    types = bytes + layout.types;
+    offsets = bytes + layout.offsets;
+    xs = bytes + layout.xs;
+    ys = bytes + layout.ys;
+    parents = version >= 2 ? bytes + layout.parents : nullptr;
+
+    // Validated once here, every later access trusts types, offsets and coordinates
+    quint32 previous = qFromLittleEndian<quint32>(offsets);
+    if (previous != 0) {
+        setError(error, "测量数据损坏");
+        return false;
+    }
+    for (quint64 i = 0; i < measurementCount; ++i) {
+        const quint32 next = qFromLittleEndian<quint32>(offsets + 4 * (i + 1));
+        if (types[i] >= TypeCount || next < previous + MinPoints[types[i]] || next > points) {
+            setError(error, "测量数据损坏");
+            return false;
+        }
+        previous = next;
+    }
+    if (previous != points) {
+        setError(error, "测量数据损坏");
+        return false;
+    }
+    for (quint64 i = 0; i < points; ++i) {
+        if (!std::isfinite(qFromLittleEndian<double>(xs + 8 * i)) || !std::isfinite(qFromLittleEndian<double>(ys + 8 * i))) {
+            setError(error, "测量坐标无效");
+            return false;
+        }
+    }
+    // Only a distance depends on anything, and only on a line
+    for (quint64 i = 0; parents && i < measurementCount; ++i) {
+        const qint32 p = qFromLittleEndian<qint32>(parents + 4 * i);
+        if (p != -1 && (p < 0 || quint64(p) >= measurementCount || types[i] != MeasureRecord::Distance
+                        || types[p] != MeasureRecord::Line)) {
+            setError(error, "测量依赖关系损坏");
+            return false;
+        }
+    }
+    return true;
+}
+
+int ProjectFile::pointCount(int index) const {
+    return int(qFromLittleEndian<quint32>(offsets + 4 * (index + 1)) - qFromLittleEndian<quint32>(offsets + 4 * index));
+}
+
+QPointF ProjectFile::point(int index, int i) const {
+    const qint64 at = qint64(qFromLittleEndian<quint32>(offsets + 4 * index)) + i;
+    return QPointF(qFromLittleEndian<double>(xs + 8 * at), qFromLittleEndian<double>(ys + 8 * at));
+}
+
+int ProjectFile::parent(int index) const {
+    return parents ? qFromLittleEndian<qint32>(parents + 4 * index) : -1;
+}
+
+QByteArray ProjectFile::serialize(const ProjectData& data) {
+    const QByteArray path = data.imagePath.toUtf8();
+    const quint64 count = quint64(data.types.size());
+    const quint64 points = quint64(data.xs.size());
+    const Layout layout(count, points, quint32(path.size()), Version);
+
+    QByteArray out(layout.end, '\0');
+    uchar* bytes = reinterpret_cast<uchar*>(out.data());
+    std::memcpy(bytes, Magic, sizeof(Magic));
+    qToLittleEndian<quint32>(Version, bytes + 8);
+    qToLittleEndian<quint32>(HeaderSize, bytes + 12);
+    qToLittleEndian<double>(data.scaleRatio, bytes + 16);
+    qToLittleEndian<quint64>(count, bytes + 24);
+    qToLittleEndian<quint64>(points, bytes + 32);
+    qToLittleEndian<quint32>(quint32(data.rawFormat.width), bytes + 40);
+    qToLittleEndian<quint32>(quint32(data.rawFormat.height), bytes + 44);
+    qToLittleEndian<quint32>(quint32(data.rawFormat.bitsPerPixel), bytes + 48);
+    qToLittleEndian<quint32>(quint32(path.size()), bytes + 52);
+    qToLittleEndian<quint64>(quint64(data.rawFormat.headerBytes), bytes + 56);
+
+    std::memcpy(bytes + layout.path, path.constData(), size_t(path.size()));
+    std::memcpy(bytes + layout.types, data.types.constData(), size_t(count));
+    qToLittleEndian<quint32>(data.pointOffsets.constData(), qsizetype(count + 1), bytes + layout.offsets);
+    qToLittleEndian<double>(data.xs.constData(), qsizetype(points), bytes + layout.xs);
+    qToLittleEndian<double>(data.ys.constData(), qsizetype(points), bytes + layout.ys);
+    for (quint64 i = 0; i < count; ++i) {
+        const qint32 parent = data.parents.isEmpty() ? -1 : data.parents[int(i)];
+        qToLittleEndian<qint32>(parent, bytes + layout.parents + 4 * i);
+    }
+    return out;
+}
+
+bool ProjectFile::save(const QString& path, const ProjectData& data, QString* error) {
+    // Written to a temporary file and renamed, a failed save keeps the old project
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        setError(error, out.errorString());
+        return false;
+    }
+    out.write(serialize(data));
+    if (!out.commit()) {
+        setError(error, out.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool ProjectFile::exportJson(const QString& path, const ProjectData& data, QString* error) {
+    QJsonArray measurements;
+    for (int i = 0; i < data.types.size(); ++i) {
+        QJsonArray points;
+        for (quint32 p = data.pointOffsets[i]; p < data.pointOffsets[i + 1]; ++p) {
+            points.append(QJsonArray{data.xs[p], data.ys[p]});
+        }
+        QJsonObject measurement{{"type", TypeNames[data.types[i]]}, {"points", points}};
+        if (!data.parents.isEmpty() && data.parents[i] >= 0) {
+            measurement.insert("parent", data.parents[i]);
+        }
+        measurements.append(measurement);
+    }
+
+    QJsonObject root{{"version", int(Version)},
+                     {"image", data.imagePath},
+                     {"scale", data.scaleRatio},
+                     {"measurements", measurements}};
+    if (data.rawFormat.width > 0) {
+        root.insert("raw", QJsonObject{{"width", data.rawFormat.width},
+                                       {"height", data.rawFormat.height},
+                                       {"bitsPerPixel", data.rawFormat.bitsPerPixel},
+                                       {"headerBytes", double(data.rawFormat.headerBytes)}});
+    }
+
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        setError(error, out.errorString());
+        return false;
+    }
+    out.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    if (!out.commit()) {
+        setError(error, out.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool ProjectFile::importJson(const QString& path, ProjectData& data, QString* error) {
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly)) {
+        setError(error, in.errorString());
+        return false;
+    }
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(in.readAll(), &parseError);
+    if (!doc.isObject()) {
+        setError(error, parseError.errorString());
+        return false;
+    }
+    const QJsonObject root = doc.object();
+    if (root.value("version").toInt() > int(Version)) {
+        setError(error, QString("项目文件版本 %1 过新").arg(root.value("version").toInt()));
+        return false;
+    }
+
+    ProjectData result;
+    result.imagePath = root.value("image").toString();
+    result.scaleRatio = root.value("scale").toDouble(1.0);
+    if (!(result.scaleRatio > 0)) {
+        setError(error, "比例尺无效");
+        return false;
+    }
+    const QJsonObject raw = root.value("raw").toObject();
+    if (!raw.isEmpty()) {
+        result.rawFormat.width = raw.value("width").toInt();
+        result.rawFormat.height = raw.value("height").toInt();
+        result.rawFormat.bitsPerPixel = raw.value("bitsPerPixel").toInt(8);
+        result.rawFormat.headerBytes = qint64(raw.value("headerBytes").toDouble());
+    }
+
+    for (const QJsonValue& value : root.value("measurements").toArray()) {
+        const QJsonObject measurement = value.toObject();
+        const QString typeName = measurement.value("type").toString();
+        int type = 0;
+        while (type < TypeCount && typeName != QLatin1String(TypeNames[type])) ++type;
+        if (type == TypeCount) {
+            setError(error, QString("未知的测量类型: %1").arg(typeName));
+            return false;
+        }
+        const QJsonArray points = measurement.value("points").toArray();
+        if (quint32(points.size()) < MinPoints[type]) {
+            setError(error, QString("%1 测量的点数不足").arg(typeName));
+            return false;
+        }
+        for (const QJsonValue& point : points) {
+            // A point is exactly [x, y] of finite numbers, anything else would
+            // silently become 0 or reach the spatial index as NaN
+            const QJsonArray xy = point.toArray();
+            if (xy.size() != 2 || !xy.at(0).isDouble() || !xy.at(1).isDouble()
+                || !std::isfinite(xy.at(0).toDouble()) || !std::isfinite(xy.at(1).toDouble())) {
+                setError(error, QString("第 %1 个测量的点坐标无效").arg(result.types.size() + 1));
+                return false;
+            }
+            result.xs.append(xy.at(0).toDouble());
+            result.ys.append(xy.at(1).toDouble());
+        }
+        result.types.append(quint8(type));
+        result.pointOffsets.append(quint32(result.xs.size()));
+        result.parents.append(qint32(measurement.value("parent").toInt(-1)));
+    }
+    for (int i = 0; i < result.parents.size(); ++i) {
+        const qint32 p = result.parents[i];
+        if (p != -1 && (p < 0 || p >= result.types.size() || result.types[i] != MeasureRecord::Distance
+                        || result.types[p] != MeasureRecord::Line)) {
+            setError(error, QString("第 %1 个测量的依赖无效").arg(i + 1));
+            return false;
+        }
+    }
+    data = result;
+    return true;
+}
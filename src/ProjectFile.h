@@ -0,0 +1,80 @@
+#ifndef PROJECTFILE_H
+#define PROJECTFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include "MappedImageSource.h"
+
+// Everything a measurement session needs to be reopened. Measurements are
+// kept as structure of arrays: measurement i has type types[i] (a
+// MeasureRecord::Type) and owns points pointOffsets[i] .. pointOffsets[i + 1] - 1
+// of xs / ys. A measurement derived from another one (a distance from its
+// line) has that one's index in parents, every other one -1; parents may be
+// left empty when there are none.
+struct ProjectData {
+    QString imagePath;
+    RawImageFormat rawFormat; // width 0 unless the image is a raw dump
+    double scaleRatio = 1.0;  // pixels / mm
+    QVector<quint8> types;
+    QVector<quint32> pointOffsets{0};
+    QVector<double> xs;
+    QVector<double> ys;
+    QVector<qint32> parents;
+};
+
+// Binary project file (*.mproj), little-endian:
+//   64 byte header: magic "MEASPROJ", version, header size, scale ratio,
+//                   measurement and point counts, raw image format, image path length
+//   image path (UTF-8), types (1 byte each), point offsets (count + 1 x uint32),
+//   x coordinates, y coordinates (double each), since version 2 parents
+//   (count x int32), every block 8-byte aligned
+// A file is mapped and read in place, opening costs one pass over the offsets
+// and one over the coordinates to validate them; nothing is copied.
+class ProjectFile {
+public:
+    static constexpr quint32 Version = 2;
+
+    static std::shared_ptr<ProjectFile> open(const QString& path, QString* error = nullptr);
+    // Same reader over an in-memory copy, e.g. for a project imported from JSON
+    static std::shared_ptr<ProjectFile> fromData(const ProjectData& data);
+
+    static bool save(const QString& path, const ProjectData& data, QString* error = nullptr);
+    // Human-readable form with the same content; coordinates round-trip exactly
+    static bool exportJson(const QString& path, const ProjectData& data, QString* error = nullptr);
+    static bool importJson(const QString& path, ProjectData& data, QString* error = nullptr);
+
+    QString imagePath() const { return image; }
+    RawImageFormat rawFormat() const { return raw; }
+    double scaleRatio() const { return scale; }
+
+    int count() const { return int(measurementCount); }
+    int type(int index) const { return types[index]; }
+    int pointCount(int index) const;
+    QPointF point(int index, int i) const;
+    // Index of the measurement this one depends on, or -1
+    int parent(int index) const;
+
+private:
+    ProjectFile() = default;
+    bool parse(const uchar* bytes, qint64 size, QString* error);
+
+    static QByteArray serialize(const ProjectData& data);
+
+    QFile file;
+    QByteArray buffer;
+    QString image;
+    RawImageFormat raw;
+    double scale = 1.0;
+    quint64 measurementCount = 0;
+    const uchar* types = nullptr;
+    const uchar* offsets = nullptr;
+    const uchar* xs = nullptr;
+    const uchar* ys = nullptr;
+    const uchar* parents = nullptr; // null before version 2
+};
+
+#endif // PROJECTFILE_H
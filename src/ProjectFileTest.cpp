@@ -0,0 +1,132 @@
+// Round trip of a project through every format it can be stored in:
+// save -> open -> export JSON -> import must give back exactly the data that
+// was saved, and malformed points must be rejected by both readers.
+//
+//   ProjectFileTest
+
+#include <QByteArray>
+#include <QFile>
+#include <QTemporaryDir>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "MeasureRecord.h"
+#include "ProjectFile.h"
+
+static ProjectData sample() {
+    ProjectData data;
+    data.imagePath = QString::fromUtf8("/图片/scan 01.raw");
+    data.rawFormat.width = 4096;
+    data.rawFormat.height = 3000;
+    data.rawFormat.bitsPerPixel = 16;
+    data.rawFormat.headerBytes = 512;
+    data.scaleRatio = 12.345678901234567;
+
+    // Some of them only survive with all 17 significant digits
+    const double coords[][2] = {{0.1, 1e-300},   {-12345.678901234567, 2.0 / 3.0},
+                                {100.0, 200.0},  {150.25, 250.125},
+                                {180.0, 190.0},  {1e15 + 0.5, -7.25},
+                                {3.0, 4.0}};
+    const quint8 types[] = {MeasureRecord::Line, MeasureRecord::Arc, MeasureRecord::Distance};
+    const quint32 ends[] = {2, 5, 7};
+    const qint32 parents[] = {-1, -1, 0};
+    for (int i = 0; i < 3; ++i) {
+        data.types.append(types[i]);
+        data.pointOffsets.append(ends[i]);
+        data.parents.append(parents[i]);
+    }
+    for (const auto& xy : coords) {
+        data.xs.append(xy[0]);
+        data.ys.append(xy[1]);
+    }
+    return data;
+}
+
+static ProjectData fromProject(const ProjectFile& project) {
+    ProjectData data;
+    data.imagePath = project.imagePath();
+    data.rawFormat = project.rawFormat();
+    data.scaleRatio = project.scaleRatio();
+    for (int i = 0; i < project.count(); ++i) {
+        for (int p = 0; p < project.pointCount(i); ++p) {
+            const QPointF point = project.point(i, p);
+            data.xs.append(point.x());
+            data.ys.append(point.y());
+        }
+        data.types.append(quint8(project.type(i)));
+        data.pointOffsets.append(quint32(data.xs.size()));
+        data.parents.append(qint32(project.parent(i)));
+    }
+    return data;
+}
+
+// Bitwise for the coordinates, so the last digit counts
+static bool same(const ProjectData& a, const ProjectData& b) {
+    return a.imagePath == b.imagePath && a.rawFormat.width == b.rawFormat.width
+           && a.rawFormat.height == b.rawFormat.height && a.rawFormat.bitsPerPixel == b.rawFormat.bitsPerPixel
+           && a.rawFormat.headerBytes == b.rawFormat.headerBytes && a.scaleRatio == b.scaleRatio
+           && a.types == b.types && a.pointOffsets == b.pointOffsets && a.parents == b.parents
+           && a.xs.size() == b.xs.size() && a.ys.size() == b.ys.size()
+           && std::memcmp(a.xs.constData(), b.xs.constData(), sizeof(double) * size_t(a.xs.size())) == 0
+           && std::memcmp(a.ys.constData(), b.ys.constData(), sizeof(double) * size_t(a.ys.size())) == 0;
+}
+
+static bool check(bool ok, const char* what, const QString& error = QString()) {
+    std::fprintf(stderr, "%-40s %s %s\n", what, ok ? "ok" : "FAILED", qPrintable(error));
+    return ok;
+}
+
+static bool writeFile(const QString& path, const QByteArray& bytes) {
+    QFile out(path);
+    return out.open(QIODevice::WriteOnly) && out.write(bytes) == bytes.size();
+}
+
+int main() {
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        std::fprintf(stderr, "cannot create temporary directory\n");
+        return 1;
+    }
+    bool ok = true;
+    QString error;
+    const ProjectData original = sample();
+
+    const QString binaryPath = dir.filePath("project.mproj");
+    const QString jsonPath = dir.filePath("project.json");
+    ok &= check(ProjectFile::save(binaryPath, original, &error), "save", error);
+    const std::shared_ptr<ProjectFile> opened = ProjectFile::open(binaryPath, &error);
+    ok &= check(opened && same(fromProject(*opened), original), "save -> open", error);
+    if (opened) {
+        ok &= check(ProjectFile::exportJson(jsonPath, fromProject(*opened), &error), "open -> export JSON", error);
+        ProjectData imported;
+        ok &= check(ProjectFile::importJson(jsonPath, imported, &error) && same(imported, original),
+                    "export JSON -> import", error);
+        ok &= check(same(fromProject(*ProjectFile::fromData(imported)), original), "import -> in-memory project");
+    }
+
+    // Malformed points, each one must fail to import instead of becoming 0,0
+    const char* const badPoints[] = {"[1]", "[1, 2, 3]", "[\"1\", 2]", "[1, null]", "{\"x\": 1, \"y\": 2}"};
+    for (const char* point : badPoints) {
+        const QByteArray json = QByteArray("{\"version\": 2, \"scale\": 1, \"measurements\": [{\"type\": \"line\", "
+                                           "\"points\": [[0, 0], ")
+                                + point + "]}]}";
+        ProjectData rejected;
+        error.clear();
+        const bool imported = writeFile(jsonPath, json) && ProjectFile::importJson(jsonPath, rejected, &error);
+        ok &= check(!imported && !error.isEmpty(), qPrintable(QString("import rejects point %1").arg(point)), error);
+    }
+
+    // A binary file with a non-finite coordinate must not open
+    for (const double bad : {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity()}) {
+        ProjectData corrupt = original;
+        corrupt.ys[3] = bad;
+        const QString corruptPath = dir.filePath("corrupt.mproj");
+        error.clear();
+        const bool saved = ProjectFile::save(corruptPath, corrupt, &error);
+        const bool opens = saved && ProjectFile::open(corruptPath, &error);
+        ok &= check(saved && !opens && !error.isEmpty(), std::isnan(bad) ? "open rejects NaN" : "open rejects infinity",
+                    error);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#include "SpatialIndex.h"
+
+SpatialIndex::SpatialIndex(double baseCellSize) : baseCell(baseCellSize) {
+}
+
+void SpatialIndex::insert(int id, const QRectF& bounds) {
+    remove(id);
+
+    const double extent = qMax(bounds.width(), bounds.height());
+    int level = 0;
+    while (cellSize(level) < extent && level < 40) {
+        ++level;
+    }
+    if (levels.size() <= level) {
+        levels.resize(level + 1);
+    }
+
+    const double s = cellSize(level);
+    const QPointF c = bounds.center();
+    const quint64 key = cellKey(qint64(std::floor(c.x() / s)), qint64(std::floor(c.y() / s)));
+    levels[level].cells[key].append(id);
+    levels[level].count++;
+    entries.insert(id, Entry{level, key});
+}
+
+void SpatialIndex::remove(int id) {
+    auto entry = entries.constFind(id);
+    if (entry == entries.constEnd()) return;
+
+    Level& grid = levels[entry->level];
+    auto cell = grid.cells.find(entry->cell);
+    if (cell != grid.cells.end()) {
+        QVector<int>& ids = cell.value();
+        const int pos = ids.indexOf(id);
+        if (pos >= 0) {
+            ids[pos] = ids.last();
+            ids.removeLast();
+            grid.count--;
+        }
+        if (ids.isEmpty()) {
+            grid.cells.erase(cell);
+        }
+    }
+    entries.erase(entry);
+}
+
+void SpatialIndex::clear() {
+    levels.clear();
+    entries.clear();
+}
@@ -0,0 +1,78 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <QHash>
+#include <QRectF>
+#include <QVector>
+#include <cmath>
+
+// Hierarchical loose grid over scene rectangles. Every entry lives in the one
+// level whose cell size is at least its extent, in the cell holding its
+// centre, so a query visits a handful of cells per level and the number of
+// levels grows with log2(largest extent / base cell size).
+class SpatialIndex {
+public:
+    SpatialIndex(double baseCellSize = 32.0);
+
+    void insert(int id, const QRectF& bounds);
+    void remove(int id);
+    void clear();
+    bool isEmpty() const { return entries.isEmpty(); }
+
+    // Calls visit(id) for every entry whose bounds may intersect rect
+    template <typename Visitor>
+    void query(const QRectF& rect, Visitor visit) const;
+
+private:
+    struct Entry {
+        int level;
+        quint64 cell;
+    };
+    struct Level {
+        QHash<quint64, QVector<int>> cells;
+        int count = 0;
+    };
+
+    double cellSize(int level) const { return baseCell * double(1ll << level); }
+    static quint64 cellKey(qint64 cx, qint64 cy) { return (quint64(quint32(cx)) << 32) | quint32(cy); }
+
+    QVector<Level> levels;
+    QHash<int, Entry> entries;
+    double baseCell;
+};
+
+template <typename Visitor>
+void SpatialIndex::query(const QRectF& rect, Visitor visit) const {
+    for (int level = 0; level < levels.size(); ++level) {
+        const Level& grid = levels[level];
+        if (grid.count == 0) continue;
+
+        // Entries may overhang their cell by half a cell on every side
+        const double s = cellSize(level);
+        const QRectF r = rect.adjusted(-s / 2, -s / 2, s / 2, s / 2);
+        const qint64 cx0 = qint64(std::floor(r.left() / s));
+        const qint64 cx1 = qint64(std::floor(r.right() / s));
+        const qint64 cy0 = qint64(std::floor(r.top() / s));
+        const qint64 cy1 = qint64(std::floor(r.bottom() / s));
+
+        if ((cx1 - cx0 + 1) * (cy1 - cy0 + 1) > grid.cells.size()) {
+            // Query covers more cells than are occupied, walk the occupied ones
+            for (auto it = grid.cells.constBegin(); it != grid.cells.constEnd(); ++it) {
+                const qint64 cx = qint32(it.key() >> 32);
+                const qint64 cy = qint32(it.key() & 0xffffffffu);
+                if (cx < cx0 || cx > cx1 || cy < cy0 || cy > cy1) continue;
+                for (int id : it.value()) visit(id);
+            }
+            continue;
+        }
+        for (qint64 cy = cy0; cy <= cy1; ++cy) {
+            for (qint64 cx = cx0; cx <= cx1; ++cx) {
+                auto it = grid.cells.constFind(cellKey(cx, cy));
+                if (it == grid.cells.constEnd()) continue;
+                for (int id : it.value()) visit(id);
+            }
+        }
+    }
+}
+
+#endif // SPATIALINDEX_H
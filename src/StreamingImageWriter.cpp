@@ -0,0 +1,178 @@
+#include "StreamingImageWriter.h"
+#include <QDataStream>
+#include <QFileInfo>
+#include <QVector>
+#include <cmath>
+
+namespace {
+
+// Largest offset either format can address
+const quint64 MaxFileSize = 0xffffffffull;
+// TIFF readers fetch a strip at a time, keep them around 1 MB
+const qsizetype StripBytes = 1 << 20;
+
+const int BmpHeaderSize = 14 + 40;
+
+enum TiffType : quint16 { TiffShort = 3, TiffLong = 4, TiffRational = 5 };
+
+} // namespace
+
+StreamingImageWriter::Format StreamingImageWriter::formatFor(const QString& path) {
+    return QFileInfo(path).suffix().compare("bmp", Qt::CaseInsensitive) == 0 ? Bmp : Tiff;
+}
+
+bool StreamingImageWriter::open(const QString& path, const QSize& size, double pixelsPerMm, QString* error) {
+    abort();
+    format = formatFor(path);
+    imageSize = size;
+    resolution = pixelsPerMm;
+    rowsWritten = 0;
+    // BMP rows are padded to 4 bytes, TIFF rows are not
+    rowBytes = format == Bmp ? (qsizetype(size.width()) * 3 + 3) & ~qsizetype(3) : qsizetype(size.width()) * 3;
+    if (size.isEmpty() || quint64(rowBytes) * quint64(size.height()) + BmpHeaderSize > MaxFileSize) {
+        if (error) *error = size.isEmpty() ? "图像为空" : "图像超过 4 GB, 无法保存为 TIFF/BMP";
+        return false;
+    }
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (error) *error = file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    if (format == Bmp) {
+        const quint32 imageBytes = quint32(rowBytes * size.height());
+        const qint32 pixelsPerMeter = qint32(std::lround(pixelsPerMm * 1000));
+        out.writeRawData("BM", 2);
+        out << quint32(BmpHeaderSize + imageBytes) << quint16(0) << quint16(0) << quint32(BmpHeaderSize);
+        // Negative height: rows run top-down, in the order they are written
+        out << quint32(40) << qint32(size.width()) << qint32(-size.height()) << quint16(1) << quint16(24)
+            << quint32(0) << imageBytes << pixelsPerMeter << pixelsPerMeter << quint32(0) << quint32(0);
+    } else {
+        // The directory offset is filled in by close()
+        out.writeRawData("II", 2);
+        out << quint16(42) << quint32(0);
+    }
+    if (out.status() != QDataStream::Ok) {
+        if (error) *error = file.errorString();
+        abort();
+        return false;
+    }
+    return true;
+}
+
+bool StreamingImageWriter::writeRows(const QImage& rows, QString* error) {
+    Q_ASSERT(rows.format() == pixelFormat() && rows.width() == imageSize.width());
+    if (rowsWritten + rows.height() > imageSize.height()) {
+        if (error) *error = "行数超出图像高度";
+        return false;
+    }
+    bool ok = true;
+    if (rows.bytesPerLine() == rowBytes) {
+        ok = file.write(reinterpret_cast<const char*>(rows.constBits()), rowBytes * rows.height()) == rowBytes * rows.height();
+    } else {
+        // QImage pads its lines to 4 bytes; TIFF wants them packed
+        for (int y = 0; ok && y < rows.height(); ++y) {
+            ok = file.write(reinterpret_cast<const char*>(rows.constScanLine(y)), rowBytes) == rowBytes;
+        }
+    }
+    if (!ok) {
+        if (error) *error = file.errorString();
+        return false;
+    }
+    rowsWritten += rows.height();
+    return true;
+}
+
+void StreamingImageWriter::writeTiffDirectory() {
+    const int rowsPerStrip = int(qBound<qsizetype>(1, StripBytes / rowBytes, imageSize.height()));
+    const int strips = (imageSize.height() + rowsPerStrip - 1) / rowsPerStrip;
+    const quint32 dataStart = 8;
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    // Values that do not fit into an entry go in front of the directory,
+    // which has to start on a word boundary
+    if (file.pos() & 1) out << quint8(0);
+    const quint32 bitsOffset = quint32(file.pos());
+    out << quint16(8) << quint16(8) << quint16(8);
+    const quint32 resolutionOffset = quint32(file.pos());
+    // Pixels per centimetre, as a fraction with three decimals
+    const quint32 perCm = quint32(std::lround(resolution * 10 * 1000));
+    out << perCm << quint32(1000) << perCm << quint32(1000);
+    const quint32 offsetsOffset = quint32(file.pos());
+    if (strips > 1) {
+        for (int i = 0; i < strips; ++i) out << quint32(dataStart + quint64(i) * rowsPerStrip * rowBytes);
+    }
+    const quint32 countsOffset = quint32(file.pos());
+    if (strips > 1) {
+        for (int i = 0; i < strips; ++i) {
+            const int rows = qMin(rowsPerStrip, imageSize.height() - i * rowsPerStrip);
+            out << quint32(rows * rowBytes);
+        }
+    }
+
+    struct Entry {
+        quint16 tag;
+        quint16 type;
+        quint32 count;
+        quint32 value; // the value itself when it fits, else its offset
+    };
+    QVector<Entry> entries = {
+        {256, TiffLong, 1, quint32(imageSize.width())},
+        {257, TiffLong, 1, quint32(imageSize.height())},
+        {258, TiffShort, 3, bitsOffset},
+        {259, TiffShort, 1, 1}, // no compression
+        {262, TiffShort, 1, 2}, // RGB
+        {273, TiffLong, quint32(strips), strips > 1 ? offsetsOffset : dataStart},
+        {277, TiffShort, 1, 3},
+        {278, TiffLong, 1, quint32(rowsPerStrip)},
+        {279, TiffLong, quint32(strips), strips > 1 ? countsOffset : quint32(imageSize.height() * rowBytes)},
+    };
+    if (resolution > 0) {
+        entries.append(Entry{282, TiffRational, 1, resolutionOffset});
+        entries.append(Entry{283, TiffRational, 1, resolutionOffset + 8});
+        entries.append(Entry{296, TiffShort, 1, 3}); // centimetre
+    }
+
+    const quint32 directoryOffset = quint32(file.pos());
+    out << quint16(entries.size());
+    for (const Entry& e : entries) {
+        out << e.tag << e.type << e.count;
+        // A single SHORT sits in the first two bytes of the value field
+        if (e.type == TiffShort && e.count == 1) {
+            out << quint16(e.value) << quint16(0);
+        } else {
+            out << e.value;
+        }
+    }
+    out << quint32(0); // no further directory
+
+    file.seek(4);
+    out << directoryOffset;
+}
+
+bool StreamingImageWriter::close(QString* error) {
+    if (rowsWritten != imageSize.height()) {
+        if (error) *error = "图像数据不完整";
+        abort();
+        return false;
+    }
+    if (format == Tiff) writeTiffDirectory();
+    const bool ok = file.error() == QFileDevice::NoError && file.flush();
+    if (!ok) {
+        if (error) *error = file.errorString();
+        abort();
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+void StreamingImageWriter::abort() {
+    if (!file.isOpen()) return;
+    file.close();
+    file.remove();
+}
@@ -0,0 +1,46 @@
+#ifndef STREAMINGIMAGEWRITER_H
+#define STREAMINGIMAGEWRITER_H
+
+#include <QFile>
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+// Writes an uncompressed 24-bit TIFF or BMP from rows handed over top to
+// bottom, so an image far larger than memory can be produced a band at a
+// time. QImageWriter only accepts whole images.
+//
+// TIFF pixel data is written as it arrives and the directory is appended by
+// close(); BMP rows are stored top-down (negative height), which
+// MappedImageSource reads back without decoding. Both formats use 32-bit
+// offsets, the pixel data must stay below 4 GB.
+class StreamingImageWriter {
+public:
+    enum Format { Tiff, Bmp };
+
+    // By suffix: .bmp is BMP, anything else TIFF
+    static Format formatFor(const QString& path);
+
+    // pixelsPerMm is stored as the image resolution, 0 leaves it unset
+    bool open(const QString& path, const QSize& size, double pixelsPerMm, QString* error);
+    // Layout the rows have to be in, see writeRows()
+    QImage::Format pixelFormat() const { return format == Bmp ? QImage::Format_BGR888 : QImage::Format_RGB888; }
+    // The next rows.height() rows; rows must have pixelFormat() and the full width
+    bool writeRows(const QImage& rows, QString* error);
+    // Finishes the file once every row was written
+    bool close(QString* error);
+    // Closes and deletes an unfinished file
+    void abort();
+
+private:
+    void writeTiffDirectory();
+
+    QFile file;
+    Format format = Tiff;
+    QSize imageSize;
+    double resolution = 0; // pixels per mm
+    int rowsWritten = 0;
+    qsizetype rowBytes = 0; // including the padding of BMP rows
+};
+
+#endif // STREAMINGIMAGEWRITER_H
@@ -0,0 +1,117 @@
+#include "TiledImageItem.h"
+#include "PerfHud.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QtConcurrent>
+#include <cmath>
+
+TiledImageItem::TiledImageItem(std::shared_ptr<ImageSource> source, QGraphicsItem* parent)
+    : QGraphicsItem(parent), source(std::move(source)), tileCache(256 * 1024), reportedKB(0) {
+    // exposedRect is only filled in with this flag set
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+TiledImageItem::~TiledImageItem() {
+    PerfHud::addToGauge(PerfHud::TileCacheKB, -reportedKB);
+}
+
+void TiledImageItem::setCacheLimit(int kilobytes) {
+    tileCache.setMaxCost(kilobytes);
+    reportCacheSize();
+}
+
+void TiledImageItem::reportCacheSize() {
+    PerfHud::addToGauge(PerfHud::TileCacheKB, tileCache.totalCost() - reportedKB);
+    reportedKB = tileCache.totalCost();
+}
+
+void TiledImageItem::setEnhancement(const EnhanceSettings& settings) {
+    if (settings == enhancement) return;
+    enhancement = settings;
+    enhancer = settings.isIdentity() || !source ? nullptr : std::make_shared<ImageEnhancer>(source, settings);
+    update();
+}
+
+QRectF TiledImageItem::boundingRect() const {
+    return source ? QRectF(QPointF(0, 0), QSizeF(source->size())) : QRectF();
+}
+
+int TiledImageItem::levelForScale(double lod) const {
+    // Coarsest level that still has at least one source pixel per device pixel
+    int level = 0;
+    while (level + 1 < source->levelCount() && lod * (1 << (level + 1)) <= 1.0) {
+        ++level;
+    }
+    return level;
+}
+
+TiledImageItem::TileKey TiledImageItem::tileKey(int level, int tx, int ty) const {
+    return TileKey{(quint64(level) << 48) | (quint64(ty) << 24) | quint64(tx), enhancement};
+}
+
+QImage TiledImageItem::tileImage(int level, int tx, int ty) const {
+    QRect rect(tx * TileSize, ty * TileSize, TileSize, TileSize);
+    rect = rect.intersected(QRect(QPoint(0, 0), source->levelSize(level)));
+    return enhancer ? enhancer->tile(level, rect) : source->tile(level, rect);
+}
+
+QPixmap TiledImageItem::insertTile(const TileKey& key, const QImage& image) {
+    QPixmap* pixmap = new QPixmap(QPixmap::fromImage(image));
+    const QPixmap result = *pixmap;
+    tileCache.insert(key, pixmap, qMax(1, int(qint64(pixmap->width()) * pixmap->height() * pixmap->depth() / 8 / 1024)));
+    reportCacheSize();
+    return result;
+}
+
+QPixmap TiledImageItem::tilePixmap(int level, int tx, int ty) {
+    const TileKey key = tileKey(level, tx, ty);
+    if (QPixmap* cached = tileCache.object(key)) {
+        return *cached;
+    }
+    return insertTile(key, tileImage(level, tx, ty));
+}
+
+void TiledImageItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    Q_UNUSED(widget);
+    if (!source || source->levelCount() == 0) return;
+
+    const QRectF exposed = option->exposedRect.intersected(boundingRect());
+    if (exposed.isEmpty()) return;
+
+    const int level = levelForScale(option->levelOfDetailFromTransform(painter->worldTransform()));
+    const QSize fullSize = source->size();
+    const QSize levelSize = source->levelSize(level);
+    // Exact per-axis factors so odd sizes do not drift at the right/bottom edge
+    const double sx = double(fullSize.width()) / levelSize.width();
+    const double sy = double(fullSize.height()) / levelSize.height();
+
+    const int tx0 = qMax(0, int(std::floor(exposed.left() / sx / TileSize)));
+    const int ty0 = qMax(0, int(std::floor(exposed.top() / sy / TileSize)));
+    const int tx1 = qMin((levelSize.width() - 1) / TileSize, int(std::floor(exposed.right() / sx / TileSize)));
+    const int ty1 = qMin((levelSize.height() - 1) / TileSize, int(std::floor(exposed.bottom() / sy / TileSize)));
+
+    // Tiles not cached yet, e.g. all of them right after the enhancement
+    // changed, are made on every core at once; pixmaps only on this thread
+    QVector<QPoint> missing;
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            if (!tileCache.contains(tileKey(level, tx, ty))) missing.append(QPoint(tx, ty));
+        }
+    }
+    if (missing.size() > 1) {
+        const QVector<QImage> images = QtConcurrent::blockingMapped<QVector<QImage>>(
+            missing, [this, level](const QPoint& t) { return tileImage(level, t.x(), t.y()); });
+        for (int i = 0; i < missing.size(); ++i) {
+            insertTile(tileKey(level, missing[i].x(), missing[i].y()), images[i]);
+        }
+    }
+
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            QPixmap pixmap = tilePixmap(level, tx, ty);
+            if (pixmap.isNull()) continue;
+            QRectF target(tx * TileSize * sx, ty * TileSize * sy, pixmap.width() * sx, pixmap.height() * sy);
+            painter->drawPixmap(target, pixmap, QRectF(pixmap.rect()));
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef TILEDIMAGEITEM_H
+#define TILEDIMAGEITEM_H
+
+#include <QGraphicsItem>
+#include <QCache>
+#include <QPixmap>
+#include <memory>
+#include "ImageEnhancer.h"
+#include "ImageSource.h"
+
+// Draws an ImageSource as a grid of tiles, picking the pyramid level that
+// matches the current view scale. Only tiles inside the exposed rect are
+// converted to pixmaps, and those are kept in a bounded cache. With display
+// enhancement on, the tiles are enhanced copies; they are cached under their
+// settings too, so going back to earlier settings needs no work.
+class TiledImageItem : public QGraphicsItem {
+public:
+    static constexpr int TileSize = 256;
+
+    TiledImageItem(std::shared_ptr<ImageSource> source, QGraphicsItem* parent = nullptr);
+    ~TiledImageItem();
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+    std::shared_ptr<ImageSource> imageSource() const { return source; }
+    void setCacheLimit(int kilobytes);
+    // Changes only what is drawn, imageSource() keeps the original pixels
+    void setEnhancement(const EnhanceSettings& settings);
+
+private:
+    struct TileKey {
+        quint64 tile; // level, row and column
+        EnhanceSettings settings;
+        bool operator==(const TileKey& other) const { return tile == other.tile && settings == other.settings; }
+        friend size_t qHash(const TileKey& key, size_t seed = 0) { return qHashMulti(seed, key.tile, key.settings); }
+    };
+
+    int levelForScale(double lod) const;
+    TileKey tileKey(int level, int tx, int ty) const;
+    // Pixels of a tile as they are drawn; safe to call from worker threads
+    QImage tileImage(int level, int tx, int ty) const;
+    QPixmap tilePixmap(int level, int tx, int ty);
+    QPixmap insertTile(const TileKey& key, const QImage& image);
+    // Keeps the PerfHud tile cache gauge in step with tileCache
+    void reportCacheSize();
+
+    std::shared_ptr<ImageSource> source;
+    std::shared_ptr<ImageEnhancer> enhancer; // null while the settings are the identity
+    EnhanceSettings enhancement;
+    QCache<TileKey, QPixmap> tileCache; // cost in KB
+    qint64 reportedKB;
+};
+
+#endif // TILEDIMAGEITEM_H